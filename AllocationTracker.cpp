@@ -0,0 +1,198 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cstdint>
+#include "AllocationTracker.h"
+
+using namespace std;
+
+
+atomic<bool> AllocationTracker::enabled_(false);
+
+// Allocations of all the threads and of the calling thread
+static atomic<uint64_t> total_allocations(0);
+static atomic<uint64_t> total_bytes(0);
+static thread_local uint64_t thread_allocations(0);
+static thread_local uint64_t thread_bytes(0);
+
+// Totals of each stage and region, in order of first appearance, updated under the mutex
+static mutex tracker_mutex;
+static vector<string> row_names;
+static vector<bool> row_is_region;
+static vector<AllocationTracker::Counts> row_totals;
+static vector<uint64_t> row_runs;
+
+
+// Count an allocation
+void AllocationTracker::CountAllocation(size_t size)
+{
+	total_allocations.fetch_add(1, memory_order_relaxed);
+	total_bytes.fetch_add(size, memory_order_relaxed);
+	thread_allocations++;
+	thread_bytes += size;
+}
+
+
+// Get the allocations of all the threads
+AllocationTracker::Counts AllocationTracker::GetTotals()
+{
+	Counts counts = {total_allocations.load(memory_order_relaxed), total_bytes.load(memory_order_relaxed)};
+
+	return counts;
+}
+
+
+// Get the allocations of the calling thread
+AllocationTracker::Counts AllocationTracker::GetThreadTotals()
+{
+	Counts counts = {thread_allocations, thread_bytes};
+
+	return counts;
+}
+
+
+// Add counts to a row of the report
+static void AddRow(const string& name, bool region, const AllocationTracker::Counts& start, const AllocationTracker::Counts& stop)
+{
+	lock_guard<mutex> lock(tracker_mutex);
+	unsigned int row_idx(0);
+
+	while ((row_idx < row_names.size()) and ((row_names[row_idx] != name) or (row_is_region[row_idx] != region))){
+
+		row_idx++;
+
+	}
+
+	if (row_idx == row_names.size()){
+
+		row_names.push_back(name);
+		row_is_region.push_back(region);
+		row_totals.push_back({0, 0});
+		row_runs.push_back(0);
+
+	}
+
+	row_totals[row_idx].allocations += stop.allocations - start.allocations;
+	row_totals[row_idx].bytes += stop.bytes - start.bytes;
+	row_runs[row_idx]++;
+}
+
+
+// Add the allocations since the start of a stage
+void AllocationTracker::AddStage(const string& name, const Counts& start)
+{
+	if (IsEnabled()){
+
+		AddRow(name, false, start, GetTotals());
+
+	}
+}
+
+
+// Add the allocations of the calling thread since the start of a region
+void AllocationTracker::AddRegion(const string& name, const Counts& start)
+{
+	if (IsEnabled()){
+
+		AddRow(name, true, start, GetThreadTotals());
+
+	}
+}
+
+
+// Print the allocations of each stage and region
+void AllocationTracker::Report(ostream& os)
+{
+	if (not IsEnabled()){
+
+		return;
+
+	}
+
+	lock_guard<mutex> lock(tracker_mutex);
+
+	os << "****************************************" << endl;
+	os << left << setw(24) << "Allocations" << right << setw(16) << "count" << setw(16) << "bytes" << setw(16) << "runs" << endl;
+
+	for (unsigned int j(0); j < row_names.size(); j++){
+
+		os << left << setw(24) << (row_is_region[j] ? "  " + row_names[j] : row_names[j]) << right;
+		os << setw(16) << row_totals[j].allocations << setw(16) << row_totals[j].bytes << setw(16) << row_runs[j] << endl;
+
+	}
+}
+
+
+// Replacements of the global allocation functions (the other forms of operator new and delete call these)
+void* operator new(size_t size)
+{
+	if (AllocationTracker::IsEnabled()){
+
+		AllocationTracker::CountAllocation(size);
+
+	}
+
+	void* p = malloc(size > 0 ? size : 1);
+
+	if (p == NULL){
+
+		throw bad_alloc();
+
+	}
+
+	return p;
+}
+
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	try {
+
+		return operator new(size);
+
+	} catch (...) {
+
+		return NULL;
+
+	}
+}
+
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	return operator new(size, nothrow);
+}
+
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
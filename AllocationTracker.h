@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class counts the heap allocations (number and bytes) made through the global operator new, which it replaces.
+ * The counting is disabled by default and only costs a flag test per allocation until it is enabled. The counts are
+ * summed for each stage measured by PerfCounters (StartStage and StopStage) and for named regions of a thread (e.g.
+ * the classification of a seed), and printed at the end of the run.
+ *
+ */
+
+#ifndef ALLOCATIONTRACKER_H
+#define ALLOCATIONTRACKER_H
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+class AllocationTracker {
+
+public:
+
+	/**
+	 * Number and size of allocations.
+	 *
+	 */
+	struct Counts {
+
+		uint64_t allocations;
+		uint64_t bytes;
+
+	};
+
+	/**
+	 * Enables the counting.
+	 *
+	 */
+	static void Enable() { enabled_ = true; };
+
+	static bool IsEnabled() { return enabled_.load(std::memory_order_relaxed); };
+
+	/**
+	 * Returns the allocations of all the threads since the counting was enabled.
+	 *
+	 */
+	static Counts GetTotals();
+
+	/**
+	 * Returns the allocations of the calling thread since the counting was enabled.
+	 *
+	 */
+	static Counts GetThreadTotals();
+
+	/**
+	 * Adds the allocations of all the threads since start (from GetTotals) to the totals of a stage.
+	 *
+	 */
+	static void AddStage(const std::string& name, const Counts& start);
+
+	/**
+	 * Adds the allocations of the calling thread since start (from GetThreadTotals) to the totals of a region, and
+	 * counts one run of the region.
+	 *
+	 */
+	static void AddRegion(const std::string& name, const Counts& start);
+
+	/**
+	 * Prints the allocations of each stage and region.
+	 *
+	 * @param  os The output stream.
+	 */
+	static void Report(std::ostream& os);
+
+	/**
+	 * Counts an allocation (called by the replaced operator new).
+	 *
+	 */
+	static void CountAllocation(size_t size);
+
+private:
+
+	static std::atomic<bool> enabled_;
+
+};
+
+#endif
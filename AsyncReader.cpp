@@ -0,0 +1,453 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#if defined(__linux__) and defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNCREADER_IO_URING
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+#include "AsyncReader.h"
+
+using namespace std;
+
+
+// Open a file and allocate its buffer
+void AsyncReader::OpenFile(File& file)
+{
+	#ifdef _WIN32
+
+		// Read by the thread pool with a stream
+		ifstream i_file(file.filepath, ios::binary | ios::ate);
+		file.failed = not i_file;
+
+		if (not file.failed){
+
+			streamsize size = i_file.tellg();
+			i_file.seekg(0, ios::beg);
+			file.buffer.reset(new vector<char>(size));
+			file.failed = (size != 0) and (not i_file.read(file.buffer->data(), size));
+
+		}
+
+		file.n_pending = 0;
+
+	#else
+
+		struct stat file_stat;
+		file.fd = open(file.filepath.c_str(), O_RDONLY);
+
+		if ((file.fd < 0) or (fstat(file.fd, &file_stat) != 0)){
+
+			file.failed = true;
+			file.n_pending = 0;
+			return;
+
+		}
+
+		file.buffer.reset(new vector<char>(file_stat.st_size));
+		file.n_pending = (file.buffer->size() + chunk_size - 1) / chunk_size;
+
+	#endif
+}
+
+
+// Read a chunk with blocking calls
+bool AsyncReader::ReadChunk(int fd, char* data, size_t offset, size_t size)
+{
+	#ifdef _WIN32
+
+		return false;
+
+	#else
+
+		while (size > 0){
+
+			ssize_t n = pread(fd, data, size, offset);
+
+			if ((n < 0) and (errno == EINTR)){
+
+				continue;
+
+			}
+
+			if (n <= 0){
+
+				return false;
+
+			}
+
+			data += n;
+			offset += n;
+			size -= n;
+
+		}
+
+		return true;
+
+	#endif
+}
+
+
+// Return the next file of the list
+bool AsyncReader::Next(Result& result)
+{
+	if (next_result_ >= files_.size()){
+
+		return false;
+
+	}
+
+	File& file = files_[next_result_];
+
+	if (UsesIoUring()){
+
+		SubmitReads();
+
+		while (not (file.opened and (file.n_pending == 0))){
+
+			ReapCompletions(true);
+			SubmitReads();
+
+		}
+
+		#ifndef _WIN32
+		if (file.fd >= 0) close(file.fd);
+		#endif
+		file.fd = -1;
+
+	} else {
+
+		unique_lock<mutex> lock(mutex_);
+		condition_.wait(lock, [&]{ return file.opened; });
+
+	}
+
+	result.filepath = file.filepath;
+	result.buffer.swap(file.buffer);
+	result.success = not file.failed;
+
+	if (not result.success){
+
+		result.buffer.reset(new vector<char>());
+
+	}
+
+	{
+		lock_guard<mutex> lock(mutex_);
+		next_result_++;
+	}
+	condition_.notify_all();
+
+	return true;
+}
+
+
+// Read the next files with the thread pool
+void AsyncReader::RunThread()
+{
+	while (true){
+
+		size_t file_idx;
+
+		{
+			unique_lock<mutex> lock(mutex_);
+			condition_.wait(lock, [&]{ return stop_ or (next_open_ >= files_.size()) or (next_open_ < next_result_ + depth_); });
+
+			if (stop_ or (next_open_ >= files_.size())){
+
+				return;
+
+			}
+
+			file_idx = next_open_++;
+		}
+
+		File& file = files_[file_idx];
+		OpenFile(file);
+
+		for (size_t chunk(0); (chunk < file.n_pending) and (not file.failed); chunk++){
+
+			size_t offset = chunk * chunk_size;
+			file.failed = not ReadChunk(file.fd, file.buffer->data() + offset, offset, min(chunk_size, file.buffer->size() - offset));
+
+		}
+
+		#ifndef _WIN32
+		if (file.fd >= 0) close(file.fd);
+		#endif
+		file.fd = -1;
+		file.n_pending = 0;
+
+		lock_guard<mutex> lock(mutex_);
+		file.opened = true;
+		condition_.notify_all();
+
+	}
+}
+
+
+#ifdef ASYNCREADER_IO_URING
+
+// Access the shared ring indexes
+static inline unsigned int* RingIndex(void* ring, unsigned int offset)
+{
+	return (unsigned int*) ((char*) ring + offset);
+}
+
+
+// Create the io_uring rings
+bool AsyncReader::SetupRing()
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = (int) syscall(__NR_io_uring_setup, ring_entries, &params);
+
+	if (fd < 0){
+
+		return false;
+
+	}
+
+	sq_entries_ = params.sq_entries;
+	cq_entries_ = params.cq_entries;
+	sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	// With a single mapping, both rings share the larger size
+	bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+
+	if (single_mmap){
+
+		sq_ring_size_ = cq_ring_size_ = max(sq_ring_size_, cq_ring_size_);
+
+	}
+
+	sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	cq_ring_ = single_mmap ? sq_ring_ : mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	sqes_ = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+	if ((sq_ring_ == MAP_FAILED) or (cq_ring_ == MAP_FAILED) or (sqes_ == MAP_FAILED)){
+
+		if (sqes_ != MAP_FAILED) munmap(sqes_, sqes_size_);
+		if ((cq_ring_ != MAP_FAILED) and (cq_ring_ != sq_ring_)) munmap(cq_ring_, cq_ring_size_);
+		if (sq_ring_ != MAP_FAILED) munmap(sq_ring_, sq_ring_size_);
+		sq_ring_ = cq_ring_ = sqes_ = NULL;
+		close(fd);
+		return false;
+
+	}
+
+	sq_head_offset_ = params.sq_off.head;
+	sq_tail_offset_ = params.sq_off.tail;
+	sq_mask_offset_ = params.sq_off.ring_mask;
+	sq_array_offset_ = params.sq_off.array;
+	cq_head_offset_ = params.cq_off.head;
+	cq_tail_offset_ = params.cq_off.tail;
+	cq_mask_offset_ = params.cq_off.ring_mask;
+	cq_cqes_offset_ = params.cq_off.cqes;
+	ring_fd_ = fd;
+
+	return true;
+}
+
+
+// Open the next files and submit their chunks
+void AsyncReader::SubmitReads()
+{
+	while ((next_open_ < files_.size()) and (next_open_ < next_result_ + depth_)){
+
+		File& file = files_[next_open_];
+		OpenFile(file);
+		file.opened = true;
+
+		for (size_t chunk(0); chunk < file.n_pending; chunk++){
+
+			queued_chunks_.push_back({next_open_, chunk});
+
+		}
+
+		next_open_++;
+
+	}
+
+	// Fill the free submission slots (the kernel consumes the entries when they are submitted)
+	unsigned int* sq_tail = RingIndex(sq_ring_, sq_tail_offset_);
+	unsigned int mask = *RingIndex(sq_ring_, sq_mask_offset_);
+	unsigned int* sq_array = RingIndex(sq_ring_, sq_array_offset_);
+	unsigned int tail = __atomic_load_n(sq_tail, __ATOMIC_RELAXED);
+	unsigned int n_submit(0);
+
+	while ((not queued_chunks_.empty()) and (n_in_flight_ < min(sq_entries_, cq_entries_))){
+
+		File& file = files_[queued_chunks_.front().first];
+		size_t offset = queued_chunks_.front().second * chunk_size;
+		unsigned int index = tail & mask;
+		struct io_uring_sqe* sqe = (struct io_uring_sqe*) sqes_ + index;
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = file.fd;
+		sqe->addr = (uint64_t) (uintptr_t) (file.buffer->data() + offset);
+		sqe->len = (uint32_t) min(chunk_size, file.buffer->size() - offset);
+		sqe->off = offset;
+		sqe->user_data = (uint64_t(queued_chunks_.front().first) << 32) | queued_chunks_.front().second;
+		sq_array[index] = index;
+		queued_chunks_.pop_front();
+		tail++;
+		n_submit++;
+		n_in_flight_++;
+
+	}
+
+	if (n_submit > 0){
+
+		__atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+		while ((syscall(__NR_io_uring_enter, ring_fd_, n_submit, 0, 0, NULL, 0) < 0) and (errno == EINTR)){}
+
+	}
+}
+
+
+// Process the completed reads
+void AsyncReader::ReapCompletions(bool wait)
+{
+	unsigned int* cq_head = RingIndex(cq_ring_, cq_head_offset_);
+	unsigned int* cq_tail = RingIndex(cq_ring_, cq_tail_offset_);
+	unsigned int mask = *RingIndex(cq_ring_, cq_mask_offset_);
+	struct io_uring_cqe* cqes = (struct io_uring_cqe*) ((char*) cq_ring_ + cq_cqes_offset_);
+	unsigned int head = __atomic_load_n(cq_head, __ATOMIC_RELAXED);
+
+	if (wait and (n_in_flight_ > 0) and (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))){
+
+		while ((syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) and (errno == EINTR)){}
+
+	}
+
+	unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+	while (head != tail){
+
+		const struct io_uring_cqe& cqe = cqes[head & mask];
+		File& file = files_[cqe.user_data >> 32];
+		size_t offset = (cqe.user_data & 0xFFFFFFFF) * chunk_size;
+		size_t size = min(chunk_size, file.buffer->size() - offset);
+		size_t n_read = (cqe.res > 0) ? cqe.res : 0;
+
+		// Short reads and unsupported operations (kernels older than 5.6) finish with blocking calls
+		if ((n_read < size) and (not ReadChunk(file.fd, file.buffer->data() + offset + n_read, offset + n_read, size - n_read))){
+
+			file.failed = true;
+
+		}
+
+		file.n_pending--;
+		n_in_flight_--;
+		head++;
+
+	}
+
+	__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+#else
+
+bool AsyncReader::SetupRing() {return false;}
+void AsyncReader::SubmitReads() {}
+void AsyncReader::ReapCompletions(bool wait) {}
+
+#endif
+
+
+// Constructor
+AsyncReader::AsyncReader(const vector<string>& filepaths, unsigned int depth, bool use_io_uring)
+{
+	depth_ = max(1u, depth);
+	next_open_ = 0;
+	next_result_ = 0;
+	ring_fd_ = -1;
+	sq_ring_ = cq_ring_ = sqes_ = NULL;
+	n_in_flight_ = 0;
+	stop_ = false;
+
+	for (size_t j(0); j < filepaths.size(); j++){
+
+		File file = {filepaths[j], -1, NULL, 0, false, false};
+		files_.push_back(file);
+
+	}
+
+	if (use_io_uring and SetupRing()){
+
+		SubmitReads();
+
+	} else {
+
+		unsigned int n_threads = (unsigned int) min<size_t>(min(depth_, 4u), files_.size());
+
+		for (unsigned int t(0); t < n_threads; t++){
+
+			threads_.push_back(thread(&AsyncReader::RunThread, this));
+
+		}
+	}
+}
+
+
+// Destructor
+AsyncReader::~AsyncReader()
+{
+	{
+		lock_guard<mutex> lock(mutex_);
+		stop_ = true;
+	}
+	condition_.notify_all();
+
+	for (unsigned int t(0); t < threads_.size(); t++){
+
+		threads_[t].join();
+
+	}
+
+	#ifdef ASYNCREADER_IO_URING
+
+		if (UsesIoUring()){
+
+			// The kernel writes into the buffers until the reads in flight complete
+			while (n_in_flight_ > 0){
+
+				ReapCompletions(true);
+
+			}
+
+			munmap(sqes_, sqes_size_);
+			if (cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+			munmap(sq_ring_, sq_ring_size_);
+			close(ring_fd_);
+
+			for (size_t j(next_result_); j < files_.size(); j++){
+
+				if (files_[j].fd >= 0) close(files_[j].fd);
+
+			}
+		}
+
+	#endif
+}
@@ -0,0 +1,173 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class reads a list of files asynchronously, keeping the next files in flight while the previous ones are
+ * parsed and segmented. Each file is read directly into the buffer which is handed to the caller, in chunks which are
+ * read concurrently. On Linux, the reads are queued to the kernel with io_uring (through the raw system calls, so no
+ * library is needed). When io_uring is not available (older kernel, container restrictions, other platforms), a pool
+ * of threads reads the files with blocking calls instead.
+ *
+ */
+
+#ifndef ASYNCREADER_H
+#define ASYNCREADER_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+class AsyncReader {
+
+public:
+
+	/**
+	 * Contents of a file.
+	 *
+	 */
+	struct Result {
+
+		std::string filepath;
+		std::shared_ptr<std::vector<char>> buffer;
+		bool success;
+
+	};
+
+	/**
+	 * Returns the next file, in the order of the list, waiting until it is read.
+	 *
+	 * @param  result A reference to the Result where the file will be contained.
+	 * @return Returns false when all the files have been returned.
+	 */
+	bool Next(Result& result);
+
+	/**
+	 * Returns true if the files are read with io_uring, false if they are read by the thread pool.
+	 *
+	 */
+	bool UsesIoUring() const {return ring_fd_ >= 0;};
+
+	/**
+	 * Starts reading a list of files.
+	 *
+	 * @param  filepaths The files to read.
+	 * @param  depth The maximum number of files read ahead of the caller.
+	 * @param  use_io_uring If false, the thread pool is used even if io_uring is available.
+	 */
+	AsyncReader(const std::vector<std::string>& filepaths, unsigned int depth, bool use_io_uring = true); // Constructor
+	~AsyncReader(); // Destructor (waits for the reads in flight)
+
+	static const size_t chunk_size = size_t(8) << 20; // Size of the read requests
+	static const unsigned int ring_entries = 64; // Maximum number of read requests in flight with io_uring
+
+private:
+
+	/**
+	 * File of the list and the state of its reads.
+	 *
+	 */
+	struct File {
+
+		std::string filepath;
+		int fd;
+		std::shared_ptr<std::vector<char>> buffer;
+		size_t n_pending; // Number of chunks not read yet
+		bool opened;
+		bool failed;
+
+	};
+
+	std::vector<File> files_;
+	unsigned int depth_;
+	size_t next_open_; // Index of the next file to open
+	size_t next_result_; // Index of the next file to return
+
+	/**
+	 * Opens a file and allocates its buffer (the file is marked as failed if it cannot be opened).
+	 *
+	 */
+	void OpenFile(File& file);
+
+	/**
+	 * Reads a chunk with blocking calls, until it is complete or fails.
+	 *
+	 */
+	static bool ReadChunk(int fd, char* data, size_t offset, size_t size);
+
+	/**
+	 * io_uring: shared rings of the kernel and queue of the chunks (file index and chunk index) waiting for a submission slot.
+	 *
+	 */
+	int ring_fd_;
+	void* sq_ring_;
+	void* cq_ring_;
+	void* sqes_;
+	size_t sq_ring_size_;
+	size_t cq_ring_size_;
+	size_t sqes_size_;
+	unsigned int sq_entries_;
+	unsigned int cq_entries_;
+	unsigned int sq_head_offset_, sq_tail_offset_, sq_mask_offset_, sq_array_offset_;
+	unsigned int cq_head_offset_, cq_tail_offset_, cq_mask_offset_, cq_cqes_offset_;
+	std::deque<std::pair<size_t, size_t>> queued_chunks_;
+	unsigned int n_in_flight_;
+
+	/**
+	 * io_uring: creates the rings.
+	 *
+	 * @return Returns false if io_uring is not available.
+	 */
+	bool SetupRing();
+
+	/**
+	 * io_uring: opens the files up to the read-ahead depth, queues their chunks and submits as many as the ring accepts.
+	 *
+	 */
+	void SubmitReads();
+
+	/**
+	 * io_uring: processes the completed reads, waiting for at least one if wait is true.
+	 *
+	 */
+	void ReapCompletions(bool wait);
+
+	/**
+	 * Thread pool: threads reading whole files, up to the read-ahead depth.
+	 *
+	 */
+	std::vector<std::thread> threads_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	bool stop_;
+
+	/**
+	 * Thread pool: reads the next files until the list is exhausted or the reader is destroyed.
+	 *
+	 */
+	void RunThread();
+
+};
+
+#endif
@@ -0,0 +1,360 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+#ifndef _WIN32
+#include <glob.h>
+#endif
+#include "BatchProcessor.h"
+#include "SegmentationPipeline.h"
+#include "WorkStealingScheduler.h"
+#include "FileIO.h"
+#include "AsyncReader.h"
+#include "PointCollection.h"
+#include "IngestStatistics.h"
+
+using namespace std;
+
+
+// Check if a file is an output of a previous run
+static bool IsOutputFile(const string& filepath)
+{
+	const string suffixes[4] = {"_seg.csv", "_trees.csv", "_seg.csv.gz", "_trees.csv.gz"};
+	
+	for (unsigned int j(0); j < 4; j++){
+		
+		if ((filepath.size() >= suffixes[j].size()) and (filepath.compare(filepath.size() - suffixes[j].size(), suffixes[j].size(), suffixes[j]) == 0)){
+			
+			return true;
+			
+		}
+	}
+	
+	return false;
+}
+
+
+// Expand files, directories and glob patterns into a list of files
+vector<string> BatchProcessor::ExpandSources(const vector<string>& sources)
+{
+	vector<string> filepaths;
+
+	for (unsigned int j(0); j < sources.size(); j++){
+
+		error_code ec;
+
+		if (filesystem::is_directory(sources[j], ec)){
+
+			// Add all the .csv, .csv.gz and .tsp files of the directory
+			vector<string> directory_files;
+
+			for (const filesystem::directory_entry& entry : filesystem::directory_iterator(sources[j], ec)){
+
+				if (entry.is_regular_file(ec) and (FileIO::IsCsvFile(entry.path().string()) or (entry.path().extension() == ".tsp")) and (not IsOutputFile(entry.path().string()))){
+
+					directory_files.push_back(entry.path().string());
+
+				}
+			}
+
+			sort(directory_files.begin(), directory_files.end());
+			filepaths.insert(filepaths.end(), directory_files.begin(), directory_files.end());
+
+		} else if (sources[j].find_first_of("*?[") != string::npos){
+
+			// Expand glob patterns which were not expanded by the shell
+			#ifndef _WIN32
+
+				glob_t glob_result;
+
+				if (glob(sources[j].c_str(), 0, NULL, &glob_result) == 0){
+
+					for (size_t k(0); k < glob_result.gl_pathc; k++){
+
+						if (not IsOutputFile(glob_result.gl_pathv[k])){
+
+							filepaths.push_back(glob_result.gl_pathv[k]);
+
+						}
+					}
+				}
+
+				globfree(&glob_result);
+
+			#else
+
+				filepaths.push_back(sources[j]);
+
+			#endif
+
+		} else {
+
+			filepaths.push_back(sources[j]);
+
+		}
+	}
+
+	return filepaths;
+}
+
+
+// Segment a batch of files
+int BatchProcessor::Run(vector<string> filepaths)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+
+	// Schedule the largest files first to avoid a long tail
+	vector<pair<uintmax_t, string>> sized_filepaths;
+
+	for (unsigned int j(0); j < filepaths.size(); j++){
+
+		error_code ec;
+		uintmax_t size = filesystem::file_size(filepaths[j], ec);
+		sized_filepaths.push_back({ec ? 0 : size, filepaths[j]});
+
+	}
+
+	stable_sort(sized_filepaths.begin(), sized_filepaths.end(), [](const pair<uintmax_t, string>& a, const pair<uintmax_t, string>& b) { return a.first > b.first; });
+
+	cout << "Processing " << filepaths.size() << " file(s) with " << scheduler_.GetWorkerCount() << " worker(s)" << endl;
+
+	// Read the csv files asynchronously, in the order in which they are submitted
+	vector<string> csv_filepaths;
+
+	for (unsigned int j(0); j < sized_filepaths.size(); j++){
+
+		if (FileIO::IsCsvFile(sized_filepaths[j].second)){
+
+			csv_filepaths.push_back(sized_filepaths[j].second);
+
+		}
+	}
+
+	AsyncReader reader(csv_filepaths, read_ahead_);
+
+	// Load the files ahead of the workers
+	for (unsigned int j(0); j < sized_filepaths.size(); j++){
+
+		string filepath = sized_filepaths[j].second;
+
+		{
+			unique_lock<mutex> lock(mutex_);
+			condition_.wait(lock, [this]{ return n_loaded_ < read_ahead_; });
+		}
+
+		SegmentationPipeline::Metrics metrics = {false, "", "", "", 0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+		if ((filepath.size() >= 4) and (filepath.rfind(".tsp") == (filepath.size()-4))){
+
+			// Chunked point files are memory-mapped by the worker, only the region of interest is read
+			{
+				lock_guard<mutex> lock(mutex_);
+				n_loaded_++;
+			}
+
+			scheduler_.Submit([this, filepath](unsigned int worker_idx){
+				SegmentationPipeline::Metrics metrics = pipelines_[worker_idx]->ProcessFile(filepath, parameters_);
+				error_code ec;
+				uintmax_t n_bytes = filesystem::file_size(filepath, ec);
+				FinishJob(metrics, filepath, ec ? 0 : n_bytes, true);
+			});
+			continue;
+
+		}
+
+		if (not FileIO::IsCsvFile(filepath)){
+
+			metrics.message = "unsupported data source format";
+			FinishJob(metrics, filepath, 0, false);
+			continue;
+
+		}
+
+		FileIO file_io(filepath);
+		AsyncReader::Result result;
+		reader.Next(result);
+		shared_ptr<vector<char>> buffer = result.buffer;
+
+		if (not result.success){
+
+			metrics.message = "unable to open input file";
+			FinishJob(metrics, filepath, 0, false);
+			continue;
+
+		}
+
+		if (not file_io.DecompressInputBuffer(*buffer)){
+
+			metrics.message = "invalid gzip data";
+			FinishJob(metrics, filepath, 0, false);
+			continue;
+
+		}
+
+		{
+			lock_guard<mutex> lock(mutex_);
+			n_loaded_++;
+		}
+
+		scheduler_.Submit([this, filepath, buffer](unsigned int worker_idx){ ProcessJob(filepath, buffer, worker_idx); });
+
+	}
+
+	scheduler_.Wait();
+
+	// Print the summary
+	double t_total = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	cout << setprecision(2) << fixed;
+	cout << "****************************************" << endl;
+	cout << "Processed " << filepaths.size() << " file(s) in " << t_total << " s: " << n_succeeded_ << " succeeded, " << failures_.size() << " failed" << endl;
+	cout << "Points: " << n_points_ << " (" << n_points_ / max(t_total, 1e-9) << " points/s)" << endl;
+	cout << "Input: " << n_bytes_ / 1e6 << " MB (" << n_bytes_ / 1e6 / max(t_total, 1e-9) << " MB/s)" << endl;
+	cout << "Trees: " << n_trees_ << endl;
+
+	for (unsigned int j(0); j < failures_.size(); j++){
+
+		cerr << "FAILURE: " << failures_[j] << endl;
+
+	}
+
+	return failures_.empty() ? 0 : 1;
+}
+
+
+// Parse and segment a file loaded in memory
+void BatchProcessor::ProcessJob(const string& filepath, shared_ptr<vector<char>> buffer, unsigned int worker_idx)
+{
+	SegmentationPipeline::Metrics metrics = {false, "", "", "", 0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0};
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	size_t n_bytes = buffer->size();
+
+	FileIO file_io(filepath);
+	PointCollection point_collection;
+	IngestStatistics statistics;
+
+	if (parameters_.use_cache){
+
+		// Warm files skip the parsing altogether, so they are not split
+		pipelines_[worker_idx]->ProcessBuffer(*buffer, file_io, parameters_, metrics);
+		metrics.t_total = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+		FinishJob(metrics, filepath, n_bytes, true);
+		return;
+
+	}
+
+	if ((n_bytes > split_size_) and (scheduler_.GetWorkerCount() > 1)){
+
+		// Large file: parse line aligned chunks on all workers
+		vector<array<size_t, 2>> chunks = FileIO::SplitCsvBuffer(buffer->data(), n_bytes, 4 * scheduler_.GetWorkerCount());
+		vector<PointCollection> chunk_points(chunks.size());
+		vector<IngestStatistics> chunk_statistics(chunks.size());
+		atomic<unsigned int> n_remaining(chunks.size());
+
+		for (unsigned int j(0); j < chunks.size(); j++){
+
+			scheduler_.Submit([&, j](unsigned int){
+				FileIO::ParseCsvBuffer(buffer->data() + chunks[j][0], buffer->data() + chunks[j][1], chunk_points[j], chunk_statistics[j]);
+				n_remaining--;
+			});
+
+		}
+
+		scheduler_.HelpUntilDone(n_remaining, worker_idx);
+
+		// Concatenate the chunks in file order
+		size_t n_points(0);
+		for (unsigned int j(0); j < chunk_points.size(); j++){
+
+			n_points += chunk_points[j].points_.size();
+			statistics.Merge(chunk_statistics[j]);
+
+		}
+
+		point_collection.points_.reserve(n_points);
+
+		for (unsigned int j(0); j < chunk_points.size(); j++){
+
+			point_collection.points_.insert(point_collection.points_.end(), chunk_points[j].points_.begin(), chunk_points[j].points_.end());
+
+		}
+
+	} else {
+
+		// Small file: parse as a whole
+		FileIO::ParseCsvBuffer(buffer->data(), buffer->data() + n_bytes, point_collection, statistics);
+
+	}
+
+	buffer.reset(); // Release the file contents before segmenting
+	metrics.t_read = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	pipelines_[worker_idx]->ProcessPoints(point_collection, &statistics, file_io, parameters_, metrics);
+	metrics.t_total = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	FinishJob(metrics, filepath, n_bytes, true);
+}
+
+
+// Record the outcome of a job
+void BatchProcessor::FinishJob(const SegmentationPipeline::Metrics& metrics, const string& filepath, size_t n_bytes, bool loaded)
+{
+	lock_guard<mutex> lock(mutex_);
+
+	if (metrics.success){
+
+		n_succeeded_++;
+		n_points_ += metrics.n_points;
+		n_trees_ += metrics.n_trees;
+		n_bytes_ += n_bytes;
+
+	} else {
+
+		failures_.push_back(filepath + ": " + metrics.message);
+
+	}
+
+	if (loaded){
+
+		n_loaded_--; // Release the read-ahead slot
+		condition_.notify_all();
+
+	}
+}
+
+
+// Constructor
+BatchProcessor::BatchProcessor(unsigned int n_workers, unsigned int read_ahead, size_t split_size, SegmentationPipeline::Parameters parameters, unsigned int scaling_factor, vector<unsigned int> radius_list) : scheduler_(n_workers)
+{
+	read_ahead_ = max(1u, read_ahead);
+	split_size_ = split_size;
+	parameters_ = parameters;
+	parameters_.verbosity = false;
+
+	// Files are segmented concurrently, so the automatic thread count of a file shares the cores between the workers
+	if (parameters_.max_segmentation_threads == 0){
+
+		parameters_.max_segmentation_threads = max(1u, thread::hardware_concurrency() / max(1u, n_workers));
+
+	}
+	n_loaded_ = 0;
+	n_succeeded_ = 0;
+	n_points_ = 0;
+	n_trees_ = 0;
+	n_bytes_ = 0;
+
+	for (unsigned int j(0); j < scheduler_.GetWorkerCount(); j++){
+
+		pipelines_.push_back(unique_ptr<SegmentationPipeline>(new SegmentationPipeline(scaling_factor, radius_list)));
+
+	}
+
+}
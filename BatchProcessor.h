@@ -0,0 +1,128 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class segments a batch of csv and chunked point files on all cores.
+ *
+ * A reader thread loads the next input files into memory ahead of the workers, so that disk reads overlap
+ * with the segmentation. The files are read asynchronously by an AsyncReader, which keeps as many files in flight
+ * as the read-ahead limit. Each loaded file becomes a job of a WorkStealingScheduler. Small files are parsed
+ * and segmented as a whole by one worker, large files are parsed in line aligned chunks spread over the
+ * workers before being segmented. A summary of the throughput and of the failures is printed at the end.
+ *
+ */
+
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include "SegmentationPipeline.h"
+#include "WorkStealingScheduler.h"
+
+class BatchProcessor {
+
+public:
+
+	/**
+	 * Expands a list of files, directories (all .csv, .csv.gz and .tsp files they contain) and glob patterns into a list of files.
+	 * Outputs of previous runs (_seg.csv and _trees.csv suffixes, compressed or not) found in directories or patterns are skipped.
+	 *
+	 * @param  sources The data sources given on the command line.
+	 * @return Returns the sorted list of files.
+	 */
+	static std::vector<std::string> ExpandSources(const std::vector<std::string>& sources);
+
+	/**
+	 * Segments all the files and prints a summary.
+	 *
+	 * @param  filepaths The list of input files.
+	 * @return Returns 0 if all the files were processed, 1 otherwise.
+	 */
+	int Run(std::vector<std::string> filepaths);
+
+	/**
+	 * Creates a batch processor.
+	 *
+	 * @param  n_workers The number of worker threads.
+	 * @param  read_ahead The maximum number of files loaded in memory and waiting for a worker (and of files being read).
+	 * @param  split_size The file size (in bytes) above which a file is parsed in parallel chunks.
+	 * @param  parameters The Parameters applied to every file.
+	 * @param  scaling_factor The coordinate scaling factor used to create the circular buffers.
+	 * @param  radius_list The radius of the circular buffers.
+	 */
+	BatchProcessor(unsigned int n_workers, unsigned int read_ahead, size_t split_size, SegmentationPipeline::Parameters parameters, unsigned int scaling_factor, std::vector<unsigned int> radius_list); // Constructor
+	~BatchProcessor(){}; // Destructor
+
+private:
+
+	/**
+	 * Parses and segments a file loaded in memory.
+	 *
+	 * @param  filepath The input file path.
+	 * @param  buffer The file contents.
+	 * @param  worker_idx The index of the worker executing the job.
+	 */
+	void ProcessJob(const std::string& filepath, std::shared_ptr<std::vector<char>> buffer, unsigned int worker_idx);
+
+	/**
+	 * Records the outcome of a job.
+	 *
+	 * @param  metrics The Metrics of the job.
+	 * @param  filepath The input file path.
+	 * @param  n_bytes The size of the input file.
+	 * @param  loaded If true, the file was loaded in memory and its read-ahead slot is released.
+	 */
+	void FinishJob(const SegmentationPipeline::Metrics& metrics, const std::string& filepath, size_t n_bytes, bool loaded);
+
+	WorkStealingScheduler scheduler_;
+	unsigned int read_ahead_;
+	size_t split_size_;
+	SegmentationPipeline::Parameters parameters_;
+
+	/**
+	 * One pipeline per worker (circular buffers and segmentation scratch memory).
+	 *
+	 */
+	std::vector<std::unique_ptr<SegmentationPipeline>> pipelines_;
+
+	/**
+	 * Number of files loaded in memory and not yet processed.
+	 *
+	 */
+	unsigned int n_loaded_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+
+	/**
+	 * Batch statistics.
+	 *
+	 */
+	unsigned int n_succeeded_;
+	unsigned long long n_points_;
+	unsigned long long n_trees_;
+	unsigned long long n_bytes_;
+	std::vector<std::string> failures_;
+
+};
+
+#endif
@@ -0,0 +1,476 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <deque>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <zlib.h>
+#include "BlockGzip.h"
+
+using namespace std;
+
+
+// Size of the header (with the "TS" extra field) and of the trailer of an indexed member
+static const size_t header_size = 20;
+static const size_t trailer_size = 8;
+
+
+// Read a little-endian 32 bit integer
+static uint32_t ReadUInt32(const char* p)
+{
+	const unsigned char* u = (const unsigned char*) p;
+	return uint32_t(u[0]) | (uint32_t(u[1]) << 8) | (uint32_t(u[2]) << 16) | (uint32_t(u[3]) << 24);
+}
+
+
+// Write a little-endian 32 bit integer
+static void WriteUInt32(char* p, uint32_t value)
+{
+	for (unsigned int j(0); j < 4; j++){
+
+		p[j] = char((value >> (8*j)) & 0xff);
+
+	}
+}
+
+
+// Check the extension of a file
+bool BlockGzip::IsCompressedFile(const string& filepath)
+{
+	return (filepath.size() >= 3) and (filepath.compare(filepath.size()-3, 3, ".gz") == 0);
+}
+
+
+// Compress a block into an indexed gzip member
+bool BlockGzip::CompressBlock(const vector<char>& block, vector<char>& member)
+{
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+
+	if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+
+		return false;
+
+	}
+
+	uLong bound = deflateBound(&z, block.size());
+	member.resize(header_size + bound + trailer_size);
+	z.next_in = (Bytef*) block.data();
+	z.avail_in = block.size();
+	z.next_out = (Bytef*) member.data() + header_size;
+	z.avail_out = bound;
+
+	int status = deflate(&z, Z_FINISH);
+	size_t n_compressed = z.total_out;
+	deflateEnd(&z);
+
+	if (status != Z_STREAM_END){
+
+		return false;
+
+	}
+
+	// Header: magic, deflate, FEXTRA flag, no time, unknown OS, and the "TS" subfield holding the member size
+	const unsigned char header[16] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 255, 8, 0, 'T', 'S', 4, 0};
+	size_t member_size = header_size + n_compressed + trailer_size;
+	memcpy(member.data(), header, sizeof(header));
+	WriteUInt32(member.data() + 16, member_size);
+
+	// Trailer: CRC-32 and size of the uncompressed data
+	WriteUInt32(member.data() + header_size + n_compressed, crc32(0, (const Bytef*) block.data(), block.size()));
+	WriteUInt32(member.data() + header_size + n_compressed + 4, block.size());
+	member.resize(member_size);
+
+	return true;
+}
+
+
+// Decompress a gzip file, concurrently if its members are indexed
+bool BlockGzip::Decompress(const char* data, size_t size, vector<char>& buffer, unsigned int n_threads)
+{
+	// Locate the members from the sizes in their headers: offset, size and uncompressed size
+	vector<array<size_t, 3>> members;
+	size_t offset(0), n_bytes(0);
+
+	while (offset < size){
+
+		const char* p = data + offset;
+		bool indexed = (size - offset >= header_size + trailer_size) and ((unsigned char) p[0] == 0x1f) and ((unsigned char) p[1] == 0x8b) and (p[2] == 8) and (p[3] == 4);
+		indexed = indexed and (p[10] == 8) and (p[11] == 0) and (p[12] == 'T') and (p[13] == 'S') and (p[14] == 4) and (p[15] == 0);
+		size_t member_size = indexed ? ReadUInt32(p + 16) : 0;
+
+		if ((not indexed) or (member_size < header_size + trailer_size) or (member_size > size - offset)){
+
+			return DecompressSequential(data, size, buffer);
+
+		}
+
+		size_t n_uncompressed = ReadUInt32(p + member_size - 4);
+		members.push_back({offset, member_size, n_bytes});
+		n_bytes += n_uncompressed;
+		offset += member_size;
+
+	}
+
+	buffer.resize(n_bytes);
+
+	// Decompress the members into their place in the buffer
+	atomic<size_t> next_member(0);
+	atomic<bool> success(true);
+
+	auto run = [&](){
+
+		size_t j;
+
+		while (((j = next_member++) < members.size()) and success){
+
+			const char* member = data + members[j][0];
+			size_t n_compressed = members[j][1] - header_size - trailer_size;
+			size_t n_uncompressed = ((j+1 < members.size()) ? members[j+1][2] : n_bytes) - members[j][2];
+			char* output = buffer.data() + members[j][2];
+
+			z_stream z;
+			memset(&z, 0, sizeof(z));
+
+			if (inflateInit2(&z, -15) != Z_OK){
+
+				success = false;
+				return;
+
+			}
+
+			z.next_in = (Bytef*) member + header_size;
+			z.avail_in = n_compressed;
+			z.next_out = (Bytef*) output;
+			z.avail_out = n_uncompressed;
+
+			int status = inflate(&z, Z_FINISH);
+			bool valid = (status == Z_STREAM_END) and (z.total_out == n_uncompressed);
+			inflateEnd(&z);
+
+			if (not (valid and (crc32(0, (const Bytef*) output, n_uncompressed) == ReadUInt32(member + members[j][1] - trailer_size)))){
+
+				success = false;
+
+			}
+		}
+	};
+
+	vector<thread> threads;
+
+	for (unsigned int t(1); t < min<size_t>(max(1u, n_threads), members.size()); t++){
+
+		threads.push_back(thread(run));
+
+	}
+
+	run();
+
+	for (unsigned int t(0); t < threads.size(); t++){
+
+		threads[t].join();
+
+	}
+
+	return success;
+}
+
+
+// Decompress a gzip stream member by member
+bool BlockGzip::DecompressSequential(const char* data, size_t size, vector<char>& buffer)
+{
+	buffer.clear();
+
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+
+	if (inflateInit2(&z, 15 + 16) != Z_OK){
+
+		return false;
+
+	}
+
+	vector<char> chunk(BLOCK_SIZE);
+	size_t offset(0);
+	bool success(true);
+
+	while (true){
+
+		// Feed the input in pieces which fit the 32 bit counters of zlib
+		if ((z.avail_in == 0) and (offset < size)){
+
+			size_t n = min<size_t>(size - offset, UINT_MAX);
+			z.next_in = (Bytef*) data + offset;
+			z.avail_in = n;
+			offset += n;
+
+		}
+
+		z.next_out = (Bytef*) chunk.data();
+		z.avail_out = chunk.size();
+		int status = inflate(&z, Z_NO_FLUSH);
+		buffer.insert(buffer.end(), chunk.data(), chunk.data() + (chunk.size() - z.avail_out));
+
+		if (status == Z_STREAM_END){
+
+			// Continue with the next member, if any
+			if ((z.avail_in == 0) and (offset == size)){
+
+				break;
+
+			}
+
+			inflateReset(&z);
+
+		} else if (status != Z_OK){
+
+			success = (size == 0);
+			break;
+
+		}
+	}
+
+	inflateEnd(&z);
+
+	return success;
+}
+
+
+// Compress the full put area
+BlockGzipBuffer::int_type BlockGzipBuffer::overflow(int_type c)
+{
+	SubmitBlock();
+
+	if (c != traits_type::eof()){
+
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+
+	}
+
+	return traits_type::not_eof(c);
+}
+
+
+// Blocks are only compressed when they are full or when the writing finishes
+int BlockGzipBuffer::sync()
+{
+	return 0;
+}
+
+
+// Queue the current block and write the compressed blocks
+void BlockGzipBuffer::SubmitBlock()
+{
+	size_t n = pptr() - pbase();
+
+	if (n == 0){
+
+		return;
+
+	}
+
+	shared_ptr<Block> block(new Block());
+	block->data.swap(current_);
+	block->data.resize(n);
+	block->done = false;
+	block->success = false;
+	current_.resize(BlockGzip::BLOCK_SIZE);
+	setp(current_.data(), current_.data() + current_.size());
+
+	unique_lock<mutex> lock(mutex_);
+	blocks_.push_back(block);
+	tasks_.push_back(block);
+	task_condition_.notify_one();
+
+	// Wait while too many blocks are in flight
+	WriteBlocks(lock, n_max_blocks_);
+}
+
+
+// Write the compressed blocks at the head of the queue
+void BlockGzipBuffer::WriteBlocks(unique_lock<mutex>& lock, size_t n_max_pending)
+{
+	while (true){
+
+		while ((not blocks_.empty()) and blocks_.front()->done){
+
+			shared_ptr<Block> block = blocks_.front();
+			blocks_.pop_front();
+
+			// Only the producer thread writes, so the lock is released during the write
+			lock.unlock();
+			bool written = block->success and (destination_->sputn(block->member.data(), block->member.size()) == (streamsize) block->member.size());
+			lock.lock();
+
+			success_ = success_ and written;
+
+		}
+
+		if (blocks_.size() <= n_max_pending){
+
+			return;
+
+		}
+
+		done_condition_.wait(lock);
+
+	}
+}
+
+
+// Compress the queued blocks
+void BlockGzipBuffer::Run()
+{
+	unique_lock<mutex> lock(mutex_);
+
+	while (true){
+
+		task_condition_.wait(lock, [&]{ return stop_ or (not tasks_.empty()); });
+
+		if (tasks_.empty()){
+
+			return;
+
+		}
+
+		shared_ptr<Block> block = tasks_.front();
+		tasks_.pop_front();
+
+		lock.unlock();
+		bool success = BlockGzip::CompressBlock(block->data, block->member);
+		lock.lock();
+
+		block->success = success;
+		block->done = true;
+		done_condition_.notify_one();
+
+	}
+}
+
+
+// Compress and write the pending data
+bool BlockGzipBuffer::Finish()
+{
+	if (threads_.empty()){
+
+		return success_;
+
+	}
+
+	SubmitBlock();
+
+	{
+		unique_lock<mutex> lock(mutex_);
+		WriteBlocks(lock, 0);
+		stop_ = true;
+		task_condition_.notify_all();
+	}
+
+	for (unsigned int t(0); t < threads_.size(); t++){
+
+		threads_[t].join();
+
+	}
+
+	threads_.clear();
+
+	return success_;
+}
+
+
+// Constructor
+BlockGzipBuffer::BlockGzipBuffer(streambuf* destination, unsigned int n_threads)
+{
+	destination_ = destination;
+	n_max_blocks_ = 2 * max(1u, n_threads);
+	stop_ = false;
+	success_ = true;
+
+	current_.resize(BlockGzip::BLOCK_SIZE);
+	setp(current_.data(), current_.data() + current_.size());
+
+	for (unsigned int t(0); t < max(1u, n_threads); t++){
+
+		threads_.push_back(thread(&BlockGzipBuffer::Run, this));
+
+	}
+}
+
+
+// Destructor
+BlockGzipBuffer::~BlockGzipBuffer()
+{
+	Finish();
+}
+
+
+// Create the output file
+bool OutputStream::Open(const string& filepath, unsigned int compression_threads)
+{
+	if (file_buffer_.open(filepath, ios::out | ios::binary | ios::trunc) == NULL){
+
+		setstate(ios::failbit);
+		return false;
+
+	}
+
+	if (compression_threads > 0){
+
+		gzip_buffer_.reset(new BlockGzipBuffer(&file_buffer_, compression_threads));
+		rdbuf(gzip_buffer_.get());
+
+	} else {
+
+		rdbuf(&file_buffer_);
+
+	}
+
+	return true;
+}
+
+
+// Write the pending data and close the file
+bool OutputStream::Close()
+{
+	bool success = good();
+	flush();
+
+	if (gzip_buffer_){
+
+		success = gzip_buffer_->Finish() and success;
+		gzip_buffer_.reset();
+
+	}
+
+	success = (file_buffer_.close() != NULL) and success;
+	rdbuf(NULL);
+
+	return success;
+}
+
+
+// Constructor
+OutputStream::OutputStream() : ostream(NULL)
+{
+}
+
+
+// Destructor
+OutputStream::~OutputStream()
+{
+	if (file_buffer_.is_open()){
+
+		Close();
+
+	}
+}
@@ -0,0 +1,206 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * These classes write and read block-compressed gzip files (zlib).
+ *
+ * The output is cut into blocks of fixed size, each compressed by a pool of threads into an independent gzip member.
+ * The members are written in order, so the file is a standard multi-member gzip file which gzip, zcat or any zlib
+ * based reader can decompress. The header of each member carries its compressed size in an extra field ("TS"
+ * subfield, as in BGZF), which forms an index of the blocks: a reader can locate all the members without
+ * decompressing them, and decompress them concurrently. Files without this index (e.g. written by gzip) are
+ * decompressed sequentially.
+ *
+ */
+
+#ifndef BLOCKGZIP_H
+#define BLOCKGZIP_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class BlockGzip {
+
+public:
+
+	/**
+	 * Decompresses a gzip file loaded in memory. Indexed members are decompressed concurrently.
+	 *
+	 * @param  data The compressed contents.
+	 * @param  size The size of the compressed contents.
+	 * @param  buffer A reference to the buffer where the decompressed contents will be contained.
+	 * @param  n_threads The number of threads decompressing the members.
+	 * @return Returns false if the contents are not valid gzip data.
+	 */
+	static bool Decompress(const char* data, size_t size, std::vector<char>& buffer, unsigned int n_threads);
+
+	/**
+	 * Checks if a file path has the .gz extension.
+	 *
+	 */
+	static bool IsCompressedFile(const std::string& filepath);
+
+	/**
+	 * Size of the uncompressed blocks.
+	 *
+	 */
+	static const size_t BLOCK_SIZE = 1 << 20;
+
+private:
+
+	/**
+	 * Compresses a block into an indexed gzip member.
+	 *
+	 * @return Returns false if zlib failed.
+	 */
+	static bool CompressBlock(const std::vector<char>& block, std::vector<char>& member);
+
+	/**
+	 * Decompresses a gzip stream of one or more members sequentially.
+	 *
+	 */
+	static bool DecompressSequential(const char* data, size_t size, std::vector<char>& buffer);
+
+	friend class BlockGzipBuffer;
+
+};
+
+
+/**
+ * Stream buffer compressing its contents in blocks and writing them to another stream buffer.
+ *
+ */
+class BlockGzipBuffer : public std::streambuf {
+
+public:
+
+	/**
+	 * Compresses and writes the pending data and waits for the compression threads.
+	 *
+	 * @return Returns false if a block could not be compressed or written.
+	 */
+	bool Finish();
+
+	/**
+	 * Creates a compressing stream buffer.
+	 *
+	 * @param  destination The stream buffer where the gzip members are written.
+	 * @param  n_threads The number of compression threads.
+	 */
+	BlockGzipBuffer(std::streambuf* destination, unsigned int n_threads); // Constructor
+	~BlockGzipBuffer(); // Destructor (finishes the writing)
+
+protected:
+
+	int_type overflow(int_type c);
+	int sync();
+
+private:
+
+	/**
+	 * Block being compressed or waiting to be written.
+	 *
+	 */
+	struct Block {
+
+		std::vector<char> data;
+		std::vector<char> member;
+		bool done;
+		bool success;
+
+	};
+
+	/**
+	 * Queues the current block for compression and writes the blocks compressed so far.
+	 *
+	 */
+	void SubmitBlock();
+
+	/**
+	 * Writes the compressed blocks at the head of the queue, in order.
+	 *
+	 * @param  lock The lock of the queue mutex.
+	 * @param  n_max_pending The number of blocks which may remain in the queue.
+	 */
+	void WriteBlocks(std::unique_lock<std::mutex>& lock, size_t n_max_pending);
+
+	/**
+	 * Compresses the queued blocks (compression threads).
+	 *
+	 */
+	void Run();
+
+	std::streambuf* destination_;
+	std::vector<char> current_;
+	std::deque<std::shared_ptr<Block>> blocks_; // Blocks in output order
+	std::deque<std::shared_ptr<Block>> tasks_; // Blocks waiting for a compression thread
+	std::vector<std::thread> threads_;
+	std::mutex mutex_;
+	std::condition_variable task_condition_;
+	std::condition_variable done_condition_;
+	size_t n_max_blocks_;
+	bool stop_;
+	bool success_;
+
+};
+
+
+/**
+ * Output file stream, written as is or compressed in gzip blocks.
+ *
+ */
+class OutputStream : public std::ostream {
+
+public:
+
+	/**
+	 * Creates the output file.
+	 *
+	 * @param  filepath The output file path.
+	 * @param  compression_threads The number of compression threads (0 = uncompressed output).
+	 * @return Returns false if the file could not be created.
+	 */
+	bool Open(const std::string& filepath, unsigned int compression_threads);
+
+	/**
+	 * Writes the pending data and closes the file.
+	 *
+	 * @return Returns false if the file could not be written.
+	 */
+	bool Close();
+
+	OutputStream(); // Constructor
+	~OutputStream(); // Destructor (closes the file)
+
+private:
+
+	std::filebuf file_buffer_;
+	std::unique_ptr<BlockGzipBuffer> gzip_buffer_;
+
+};
+
+#endif
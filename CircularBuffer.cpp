@@ -1,9 +1,11 @@
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include "CircularBuffer.h"
 
 using namespace std;
 
-unsigned int CircularBuffer::GetRadius()
+double CircularBuffer::GetRadius()
 {
 	return radius_;
 }
@@ -15,12 +17,13 @@ unsigned int CircularBuffer::GetSize()
 }
 
 
-CircularBuffer::CircularBuffer(unsigned int radius, unsigned int scaling_factor)
+CircularBuffer::CircularBuffer(double radius, unsigned int scaling_factor)
 {
-	radius_ = radius;
 	scaling_factor_ = scaling_factor;
 	
-	unsigned int scaled_radius = scaling_factor*radius; 
+	unsigned int scaled_radius = (unsigned int) lround(max(radius, 0.0) * scaling_factor);
+	scaled_radius_ = scaled_radius;
+	radius_ = double(scaled_radius) / scaling_factor;
 	unsigned int kernel_size = (2*scaled_radius)+1;
 	int squared_radius = scaled_radius*scaled_radius;
 	
@@ -44,6 +47,20 @@ CircularBuffer::CircularBuffer(unsigned int radius, unsigned int scaling_factor)
 	}
 	
 	size_ = coordinate_offsets_.size();
+	
+	// Keep the rectangle of each half-width which is higher than the rectangle of the next half-width
+	for (int xx = 0; xx <= int(scaled_radius); xx++){
+		
+		int half_height = (int) floor(sqrt(double(squared_radius - xx*xx)));
+		int next_half_height = (xx < int(scaled_radius)) ? (int) floor(sqrt(double(squared_radius - (xx+1)*(xx+1)))) : -1;
+		
+		if (half_height > next_half_height){
+			
+			rectangles_.push_back({xx, half_height});
+			
+		}
+		
+	}
 
 }
 
@@ -25,6 +25,7 @@
 #ifndef CIRCULARBUFFER_H
 #define CIRCULARBUFFER_H
 
+#include <vector>
 #include <array>
 
 class CircularBuffer {
@@ -36,15 +37,15 @@ friend class SegmenterSNC;
 public:
 
 	unsigned int GetSize();
-	unsigned int GetRadius();
+	double GetRadius();
 	
 	/**
 	 * Creates a circular buffer.
 	 *
-	 * @param  radius The radius of the circular buffer.
+	 * @param  radius The radius of the circular buffer, rounded to the nearest multiple of the grid cell size.
 	 * @param  scaling_factor The coordinate scaling factor (1 metric, 10 = decimetric). Defaults to 1, if different values than 1 or 10 are given.
 	 */
-	CircularBuffer(unsigned int radius, unsigned int scaling_factor); // Constructor
+	CircularBuffer(double radius, unsigned int scaling_factor); // Constructor
 	~CircularBuffer(){}; // Destructor
 	
 private:
@@ -54,7 +55,15 @@ private:
 	 *
 	 */
 	std::vector<std::array<int,2>> coordinate_offsets_;
-	unsigned int radius_;
+	
+	/**
+	 * Half-width (in columns) and half-height (in rows) of the largest rectangles centered on the cell which fit in the
+	 * circular buffer area, in increasing half-width order. The union of these rectangles is the circular buffer area.
+	 *
+	 */
+	std::vector<std::array<int,2>> rectangles_;
+	double radius_;
+	unsigned int scaled_radius_; // Radius in grid cells
 	unsigned int size_;
 	unsigned int scaling_factor_;
 	
@@ -1,4 +1,9 @@
 #include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
 #include "PointCollection.h"
 #include "CircularBuffer.h"
 #include "CircularBufferCollection.h"
@@ -6,6 +11,51 @@
 using namespace std;
 
 
+// Default radius model (steps of the original algorithm)
+CircularBufferCollection::RadiusModel CircularBufferCollection::DefaultRadiusModel()
+{
+	RadiusModel radius_model;
+	radius_model.type = RadiusModel::STEP;
+	radius_model.heights = {8, 15};
+	radius_model.radii = {4, 9, 14};
+	radius_model.a = 0.0;
+	radius_model.b = 0.0;
+	radius_model.min_radius = 0.0;
+	radius_model.max_radius = 0.0;
+	
+	return radius_model;
+}
+
+
+// Check the consistency of a radius model
+bool CircularBufferCollection::IsValidRadiusModel(const RadiusModel& radius_model)
+{
+	for (unsigned int j(1); j < radius_model.heights.size(); j++){
+		
+		if (radius_model.heights[j] <= radius_model.heights[j-1]){
+			
+			return false;
+			
+		}
+	}
+	
+	switch (radius_model.type){
+		
+		case RadiusModel::STEP:
+			return radius_model.radii.size() == radius_model.heights.size() + 1;
+			
+		case RadiusModel::PIECEWISE_LINEAR:
+			return (radius_model.radii.size() == radius_model.heights.size()) and (radius_model.radii.size() > 0);
+			
+		case RadiusModel::ALLOMETRIC:
+			return (radius_model.a > 0.0) and (radius_model.min_radius > 0.0) and (radius_model.max_radius >= radius_model.min_radius);
+			
+	}
+	
+	return false;
+}
+
+
 CircularBuffer& CircularBufferCollection::GetCircularBuffer(unsigned int k)
 {
 	return circular_buffers_[k];
@@ -13,9 +63,156 @@ CircularBuffer& CircularBufferCollection::GetCircularBuffer(unsigned int k)
 }
 
 
+// Set the radius model of the seed buffers
+void CircularBufferCollection::SetRadiusModel(const RadiusModel& radius_model)
+{
+	radius_model_ = radius_model;
+}
+
+
+// Evaluate the radius model at the height of a seed
+double CircularBufferCollection::GetSeedRadius(double z)
+{
+	return EvaluateRadiusModel(radius_model_, z);
+}
+
+
+// Evaluate a radius model
+double CircularBufferCollection::EvaluateRadiusModel(const RadiusModel& radius_model, double z)
+{
+	const vector<double>& heights = radius_model.heights;
+	const vector<double>& radii = radius_model.radii;
+	
+	if (radius_model.type == RadiusModel::STEP){
+		
+		unsigned int j(0);
+		
+		while ((j < heights.size()) and (z > heights[j])){
+			
+			j++;
+			
+		}
+		
+		return radii[j];
+		
+	} else if (radius_model.type == RadiusModel::PIECEWISE_LINEAR){
+		
+		if (z <= heights.front()){
+			
+			return radii.front();
+			
+		}
+		
+		for (unsigned int j(1); j < heights.size(); j++){
+			
+			if (z <= heights[j]){
+				
+				double t = (z - heights[j-1]) / (heights[j] - heights[j-1]);
+				return radii[j-1] + t * (radii[j] - radii[j-1]);
+				
+			}
+		}
+		
+		return radii.back();
+		
+	} else {
+		
+		double radius = radius_model.a * pow(max(z, 0.0), radius_model.b);
+		return min(max(radius, radius_model.min_radius), radius_model.max_radius);
+		
+	}
+}
+
+
+// Largest radius of the radius model
+double CircularBufferCollection::GetMaxSeedRadius()
+{
+	return GetMaxRadius(radius_model_);
+}
+
+
+// Largest radius of a radius model
+double CircularBufferCollection::GetMaxRadius(const RadiusModel& radius_model)
+{
+	if (radius_model.type == RadiusModel::ALLOMETRIC){
+		
+		return radius_model.max_radius;
+		
+	}
+	
+	return *max_element(radius_model.radii.begin(), radius_model.radii.end());
+}
+
+
+// Get (or create) the circular buffer of a seed
+CircularBuffer& CircularBufferCollection::GetSeedBuffer(double z)
+{
+	return GetBuffer(GetSeedRadius(z));
+}
+
+
+// Set the radius model of the local maxima search
+void CircularBufferCollection::SetLocalMaximaModel(bool variable, const RadiusModel& radius_model)
+{
+	variable_local_maxima_ = variable;
+	local_maxima_model_ = radius_model;
+}
+
+
+// Get (or create) the circular buffer of the local maxima search around a point
+CircularBuffer& CircularBufferCollection::GetLocalMaximaBuffer(double z)
+{
+	return GetBuffer(EvaluateRadiusModel(local_maxima_model_, z));
+}
+
+
+// Get (or create) the circular buffer of a radius
+CircularBuffer& CircularBufferCollection::GetBuffer(double radius)
+{
+	// Round the radius to the grid cell size, with a radius of at least one cell
+	unsigned int scaled_radius = max(1u, (unsigned int) lround(max(radius, 0.0) * scaling_factor_));
+	
+	lock_guard<mutex> lock(seed_buffers_mutex_);
+	unique_ptr<CircularBuffer>& buffer = seed_buffers_[scaled_radius];
+	
+	if (not buffer){
+		
+		buffer.reset(new CircularBuffer(double(scaled_radius) / scaling_factor_, scaling_factor_));
+		
+	}
+	
+	return *buffer;
+}
+
+
+// Create the seed buffers of the occupied heights
+void CircularBufferCollection::PrepareSeedBuffers(const vector<uint64_t>& height_histogram)
+{
+	// The radius may change several times within a bin, so each bin is sampled at a tenth of its height
+	for (unsigned int k(0); k < height_histogram.size(); k++){
+		
+		if (height_histogram[k] == 0){
+			
+			continue;
+			
+		}
+		
+		for (unsigned int j(0); j <= 10; j++){
+			
+			GetSeedBuffer(k + 0.1 * j);
+			
+		}
+	}
+}
+
+
 //CircularBufferCollection::CircularBufferCollection(vector<unsigned int> radius_list, PointCollection point_collection)
 CircularBufferCollection::CircularBufferCollection(vector<unsigned int> radius_list, unsigned int scaling_factor)
 {
+	scaling_factor_ = scaling_factor;
+	radius_model_ = DefaultRadiusModel();
+	local_maxima_model_ = DefaultRadiusModel();
+	variable_local_maxima_ = false;
 	
 	for (unsigned int j = 0; j < radius_list.size(); j++){
 		
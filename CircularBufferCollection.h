@@ -19,6 +19,10 @@
  * @section DESCRIPTION
  *
  * This class represents a collection of circular buffers.
+ *
+ * Besides the buffers of a fixed list of radius, the collection holds a model of the radius of the buffer centered
+ * on a seed as a function of the seed height. The buffer of each distinct radius (rounded to the grid cell size) is
+ * created on first use and kept for the following seeds. The cache can be used concurrently by several threads.
  * 
  */
  
@@ -26,6 +30,10 @@
 #define CIRCULARBUFFERCOLLECTION_H
 
 #include <vector>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
 #include "CircularBuffer.h"
 #include "PointCollection.h"
 
@@ -35,7 +43,101 @@ friend class SegmenterSNC;
 
 public:
 	
+	/**
+	 * Model of the radius of the buffer centered on a seed as a function of the seed height.
+	 *
+	 */
+	struct RadiusModel {
+		
+		enum Type {STEP, PIECEWISE_LINEAR, ALLOMETRIC};
+		
+		Type type;
+		std::vector<double> heights; // Increasing breaks (STEP) or knots (PIECEWISE_LINEAR)
+		std::vector<double> radii; // STEP: radius up to the first break, up to each following break and above the last one (heights.size()+1 values). PIECEWISE_LINEAR: radius at each knot, constant beyond the first and last knots
+		double a; // ALLOMETRIC: radius = a * height^b, bounded by min_radius and max_radius
+		double b;
+		double min_radius;
+		double max_radius;
+		
+	};
+	
+	/**
+	 * Returns the default RadiusModel: 4, 9 and 14 units up to 8, up to 15 and above 15 units high.
+	 *
+	 */
+	static RadiusModel DefaultRadiusModel();
+	
+	/**
+	 * Checks the number of values and the ordering of the heights of a RadiusModel.
+	 *
+	 */
+	static bool IsValidRadiusModel(const RadiusModel& radius_model);
+	
+	/**
+	 * Returns the radius of a RadiusModel at the specified height.
+	 *
+	 */
+	static double EvaluateRadiusModel(const RadiusModel& radius_model, double z);
+	
+	/**
+	 * Returns the largest radius of a RadiusModel.
+	 *
+	 */
+	static double GetMaxRadius(const RadiusModel& radius_model);
+	
 	CircularBuffer& GetCircularBuffer(unsigned int k);
+	
+	/**
+	 * Sets the RadiusModel used by GetSeedBuffer. Must not be called while seeds are segmented.
+	 *
+	 */
+	void SetRadiusModel(const RadiusModel& radius_model);
+	
+	/**
+	 * Returns the radius of the buffer centered on a seed of the specified height.
+	 *
+	 */
+	double GetSeedRadius(double z);
+	
+	/**
+	 * Returns the largest radius returned by GetSeedRadius.
+	 *
+	 */
+	double GetMaxSeedRadius();
+	
+	/**
+	 * Returns the CircularBuffer centered on a seed of the specified height, created on first use. Thread-safe.
+	 *
+	 */
+	CircularBuffer& GetSeedBuffer(double z);
+	
+	/**
+	 * Creates the seed buffers of the heights occupied by a point cloud ahead of the segmentation.
+	 *
+	 * @param  height_histogram The number of points in each one unit height bin (see IngestStatistics).
+	 */
+	void PrepareSeedBuffers(const std::vector<uint64_t>& height_histogram);
+	
+	/**
+	 * Sets the RadiusModel of the local maxima search (see PointCollection::FindLocalMaxima). Without a model, the local
+	 * maxima are searched within the first CircularBuffer of the collection.
+	 *
+	 * @param  variable If true, the radius of the search depends on the height of the Point.
+	 * @param  radius_model The radius of the search as a function of the height of the Point.
+	 */
+	void SetLocalMaximaModel(bool variable, const RadiusModel& radius_model);
+	
+	/**
+	 * Returns true if the radius of the local maxima search depends on the height of the Point.
+	 *
+	 */
+	bool HasLocalMaximaModel() const {return variable_local_maxima_;};
+	
+	/**
+	 * Returns the CircularBuffer of the local maxima search centered on a Point of the specified height, created on first use. Thread-safe.
+	 *
+	 */
+	CircularBuffer& GetLocalMaximaBuffer(double z);
 		
 	/**
 	 * Creates a collection of circular buffers.
@@ -51,6 +153,22 @@ private:
 
 	std::vector<CircularBuffer> circular_buffers_;
 	unsigned int scaling_factor_;
+	RadiusModel radius_model_;
+	RadiusModel local_maxima_model_;
+	bool variable_local_maxima_;
+	
+	/**
+	 * Buffers of the seeds and of the local maxima search by radius (in grid cells). The map nodes are never moved, so references remain valid.
+	 *
+	 */
+	std::map<unsigned int, std::unique_ptr<CircularBuffer>> seed_buffers_;
+	std::mutex seed_buffers_mutex_;
+	
+	/**
+	 * Returns the buffer of a radius (rounded to the grid cell size, at least one cell), created on first use. Thread-safe.
+	 *
+	 */
+	CircularBuffer& GetBuffer(double radius);
 	
 };
 
@@ -5,15 +5,34 @@
 #include <vector>
 #include <algorithm> 
 #include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <array>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <thread>
 #include "FileIO.h"
+#include "BlockGzip.h"
+#include "AsyncReader.h"
+#include "NpyWriter.h"
+#include "IngestStatistics.h"
 #include "PointCollection.h"
 #include "TreeCollection.h"
 
 using namespace std;
 
 
-FileIO::FileParts FileIO::GetFileParts(const string& s)
+FileIO::FileParts FileIO::GetFileParts(const string& filepath)
 {
+	// The parts of a compressed file are those of the file it contains
+	string s = BlockGzip::IsCompressedFile(filepath) ? filepath.substr(0, filepath.size()-3) : filepath;
+	
 	FileIO::FileParts file;
 	string path, name, extension;
 	
@@ -55,69 +74,254 @@ string FileIO::GetTreeOutputFilepath()
 }			
 
 
-// Read a point cloud from a .csv file into a vector of Points
-PointCollection FileIO::ReadCsvPoints()
+string FileIO::GetStateFilepath()
+{
+	FileParts current_file_parts = GetFileParts(i_filepath_);
+	return current_file_parts.path + current_file_parts.name  + "_state.bin";
+}
+
+
+string FileIO::GetTreeIndexFilepath()
+{
+	FileParts current_file_parts = GetFileParts(i_filepath_);
+	return current_file_parts.path + current_file_parts.name  + "_tree_index.bin";
+}
+
+
+string FileIO::GetOctreeDirectory()
 {
-	ifstream i_file(i_filepath_);
+	FileParts current_file_parts = GetFileParts(i_filepath_);
+	return current_file_parts.path + current_file_parts.name  + "_octree";
+}
+
+
+string FileIO::GetCacheFilepath()
+{
+	FileParts current_file_parts = GetFileParts(i_filepath_);
+	return current_file_parts.path + current_file_parts.name  + "_cache.bin";
+}
+
+
+// Hash a buffer (64 bit FNV-1a applied to 8 byte words)
+uint64_t FileIO::HashBuffer(const char* data, size_t size, uint64_t seed)
+{
+	const uint64_t prime = 1099511628211ULL;
+	uint64_t hash = seed ^ 14695981039346656037ULL;
+	uint64_t word;
+	size_t j(0);
 	
-	if(i_file){
+	for (; j + 8 <= size; j += 8){
+		
+		memcpy(&word, data + j, 8);
+		hash = (hash ^ word) * prime;
+		
+	}
 	
-		cout << "Reading " << i_filepath_ << "...";
+	for (; j < size; j++){
+		
+		hash = (hash ^ (unsigned char) data[j]) * prime;
+		
+	}
 	
-		// Read line by line to determine the number of lines in the input file
-		string line;
-		unsigned int counter = 0;
-	    while ( getline(i_file, line) ) { 
-	        counter++;
-	    }
+	return (hash ^ size) * prime;
+}
+
 
-		// Return to the beginning of the file
-		i_file.clear();
-		i_file.seekg(0, ios::beg);
+// Write a prepared PointCollection to a memory-mappable cache file
+bool FileIO::WritePointCache(PointCollection& point_collection, uint64_t key, uint64_t n_input_points)
+{
+	string o_filepath = GetCacheFilepath();
+	ofstream o_file(o_filepath, ios::binary);
+	
+	if (not o_file){
 		
-		PointCollection point_collection;
-		PointCollection::Point initial_val = {0.0, 0.0, 0.0, 0, 0, 0, 0, 0, 2, false, {0,0,0}};
-		point_collection.points_.resize(counter, initial_val);
+		cerr << "Warning: unable to write cache file " << o_filepath << endl;
+		return false;
 		
-		unsigned int k = 0;
-		string field;
-		PointCollection::Point point;
+	}
+	
+	const vector<PointCollection::Point>& points = point_collection.points_;
+	
+	CacheHeader header;
+	memcpy(header.magic, "TSCACHE4", 8);
+	header.key = key;
+	header.n_points = points.size();
+	header.n_blocks = point_collection.grid_.block_keys_.size();
+	header.n_input_points = n_input_points;
+	header.n_cols = point_collection.n_cols_;
+	header.n_rows = point_collection.n_rows_;
+	header.coordinate_scaling = point_collection.coordinate_scaling_;
+	header.padding = 0;
+	header.x_origin = point_collection.x_origin_;
+	header.y_origin = point_collection.y_origin_;
+	header.x_min = point_collection.bounding_box_.x_min;
+	header.x_max = point_collection.bounding_box_.x_max;
+	header.y_min = point_collection.bounding_box_.y_min;
+	header.y_max = point_collection.bounding_box_.y_max;
+	o_file.write((const char*) &header, sizeof(header));
+	
+	// Point records (in height order, whatever the storage order of the points)
+	vector<CachePoint> records(points.size());
+	
+	for (unsigned int j(0); j < points.size(); j++){
+		
+		const PointCollection::Point& point = points[point_collection.GetHeightOrderIndex(j)];
+		records[j] = {point.x, point.y, point.z, point.row, point.col, point.classification, point.local_maxima_status};
+		
+	}
+	
+	o_file.write((const char*) records.data(), records.size() * sizeof(CachePoint));
+	
+	// Occupied blocks and their cells in compressed sparse row layout (point indexes in height order)
+	const SparseGrid& grid = point_collection.grid_;
+	vector<uint32_t> cell_indexes(grid.indexes_.size());
+	
+	for (size_t j(0); j < grid.indexes_.size(); j++){
 		
-		while(!i_file.eof()){
+		cell_indexes[j] = point_collection.GetHeightRank(grid.indexes_[j]);
 		
-			getline(i_file, field,',');
-			//point.x = stod(field);
-			stringstream str1(field);
-			str1 >> point.x;
+	}
+	
+	o_file.write((const char*) grid.block_keys_.data(), grid.block_keys_.size() * sizeof(uint64_t));
+	o_file.write((const char*) grid.cell_offsets_.data(), grid.cell_offsets_.size() * sizeof(uint32_t));
+	o_file.write((const char*) cell_indexes.data(), cell_indexes.size() * sizeof(uint32_t));
+	
+	return bool(o_file);
+}
+
 
-			getline(i_file, field, ',');
-			//point.y = stod(field);
-			stringstream str2(field);
-			str2 >> point.y;
+// Read a prepared PointCollection from a memory-mapped cache file
+bool FileIO::ReadPointCache(PointCollection& point_collection, uint64_t key, uint64_t& n_input_points)
+{
+	#ifdef _WIN32
+	
+		return false;
+	
+	#else
+	
+		string i_filepath = GetCacheFilepath();
+		int fd = open(i_filepath.c_str(), O_RDONLY);
+		
+		if (fd < 0){
 			
-			getline(i_file, field, ',');
-			//point.z = stod(field);
-			stringstream str3(field);
-			str3 >> point.z;
+			return false; // No cache yet
 			
-			getline(i_file, field);
-			//point.classification = stoi(field);
-			stringstream str4(field);
-			str4 >> point.classification;
+		}
+		
+		struct stat file_stat;
+		if ((fstat(fd, &file_stat) != 0) or ((size_t) file_stat.st_size < sizeof(CacheHeader))){
 			
-			// Set additional attribute values
-			point.tree_idx = 0;
-			point.segmentation_status = false;
-			point.local_maxima_status = 2;
+			close(fd);
+			return false;
 			
-			// Add Point to PointCollection
-			point_collection.points_.push_back(point);
+		}
+		
+		size_t size = file_stat.st_size;
+		void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		
+		if (data == MAP_FAILED){
 			
-			k++;
+			return false;
 			
-			i_file >> ws;
 		}
-		i_file.close();
+		
+		// Check the signature, the key and the file size
+		const CacheHeader* header = (const CacheHeader*) data;
+		bool valid = (memcmp(header->magic, "TSCACHE4", 8) == 0) and (header->key == key);
+		uint64_t n_cells = header->n_blocks * SparseGrid::block_cells;
+		
+		if (valid){
+			
+			size_t expected_size = sizeof(CacheHeader) + header->n_points * (sizeof(CachePoint) + sizeof(uint32_t)) + header->n_blocks * sizeof(uint64_t) + (n_cells + 1) * sizeof(uint32_t);
+			valid = (size == expected_size) and (header->n_points > 0);
+			
+		}
+		
+		const CachePoint* records = (const CachePoint*) ((const char*) data + sizeof(CacheHeader));
+		const uint64_t* block_keys = (const uint64_t*) (records + header->n_points);
+		const uint32_t* cell_offsets = (const uint32_t*) (block_keys + header->n_blocks);
+		const uint32_t* cell_indexes = cell_offsets + n_cells + 1;
+		
+		// Check the consistency of the grid
+		if (valid){
+			
+			valid = (cell_offsets[0] == 0) and (cell_offsets[n_cells] == header->n_points);
+			
+			for (uint64_t j(0); valid and (j < n_cells); j++){
+				
+				valid = (cell_offsets[j] <= cell_offsets[j+1]);
+				
+			}
+			
+			for (uint64_t j(0); valid and (j < header->n_points); j++){
+				
+				valid = (cell_indexes[j] < header->n_points);
+				
+			}
+		}
+		
+		if (not valid){
+			
+			munmap(data, size);
+			return false;
+			
+		}
+		
+		// Points
+		point_collection.points_.resize(header->n_points);
+		
+		for (uint64_t j(0); j < header->n_points; j++){
+			
+			PointCollection::Point& point = point_collection.points_[j];
+			point.x = records[j].x;
+			point.y = records[j].y;
+			point.z = records[j].z;
+			point.row = records[j].row;
+			point.col = records[j].col;
+			point.classification = records[j].classification;
+			point.point_idx = j;
+			point.tree_idx = 0;
+			point.local_maxima_status = records[j].local_maxima_status;
+			point.segmentation_status = false;
+			point.rgb_color = {0, 0, 0};
+			
+		}
+		
+		// Grid
+		SparseGrid& grid = point_collection.grid_;
+		grid.block_keys_.assign(block_keys, block_keys + header->n_blocks);
+		grid.cell_offsets_.assign(cell_offsets, cell_offsets + n_cells + 1);
+		grid.indexes_.assign(cell_indexes, cell_indexes + header->n_points);
+		grid.BuildTable(header->n_blocks);
+		
+		point_collection.n_cols_ = header->n_cols;
+		point_collection.n_rows_ = header->n_rows;
+		point_collection.coordinate_scaling_ = header->coordinate_scaling;
+		point_collection.x_origin_ = header->x_origin;
+		point_collection.y_origin_ = header->y_origin;
+		point_collection.SetBoundingBox(header->x_min, header->x_max, header->y_min, header->y_max);
+		n_input_points = header->n_input_points;
+		
+		munmap(data, size);
+		
+		return true;
+	
+	#endif
+}
+
+
+// Read a point cloud from a .csv file into a vector of Points
+PointCollection FileIO::ReadCsvPoints()
+{
+	vector<char> buffer;
+	
+	if (ReadInputBuffer(buffer)){
+	
+		cout << "Reading " << i_filepath_ << "...";
+		
+		PointCollection point_collection;
+		ParseCsvBuffer(buffer.data(), buffer.data() + buffer.size(), point_collection);
 		
 		cout << "Done!" << endl;	
 		
@@ -132,35 +336,555 @@ PointCollection FileIO::ReadCsvPoints()
 }
 
 
-// Write a vector of segmented Points to .csv file
-void FileIO::WritePointsToCSV(PointCollection& point_collection, unsigned int precision)
+// Check the extension of a csv file
+bool FileIO::IsCsvFile(const string& filepath)
 {
+	string s = BlockGzip::IsCompressedFile(filepath) ? filepath.substr(0, filepath.size()-3) : filepath;
 	
-	// Create output file name
-	FileParts current_file_parts = GetFileParts(i_filepath_);
+	return (s.size() >= 4) and (s.compare(s.size()-4, 4, ".csv") == 0);
+}
+
+
+// Read the whole input file into memory
+bool FileIO::ReadInputBuffer(vector<char>& buffer)
+{
+	AsyncReader reader(vector<string>(1, i_filepath_), 1);
+	AsyncReader::Result result;
+	
+	if (not (reader.Next(result) and result.success)){
+		
+		return false;
+		
+	}
+	
+	buffer.swap(*result.buffer);
+	
+	return DecompressInputBuffer(buffer);
+}
+
+
+// Decompress the input file contents
+bool FileIO::DecompressInputBuffer(vector<char>& buffer)
+{
+	// Decompress gzip files, with one thread per core for block-compressed files
+	if (BlockGzip::IsCompressedFile(i_filepath_)){
+		
+		vector<char> compressed;
+		compressed.swap(buffer);
+		
+		if (not BlockGzip::Decompress(compressed.data(), compressed.size(), buffer, max(1u, thread::hardware_concurrency()))){
+			
+			cerr << "FAILURE: invalid gzip data in " << i_filepath_ << endl;
+			return false;
+			
+		}
+	}
+	
+	return true;
+}
+
+
+// Parse csv lines (x, y, z, classification) into a vector of Points
+void FileIO::ParseCsvBuffer(const char* begin, const char* end, PointCollection& point_collection)
+{
+	ParseCsvLines(begin, end, point_collection, NULL);
+}
+
+
+// Parse csv lines into a vector of Points and collect their statistics
+void FileIO::ParseCsvBuffer(const char* begin, const char* end, PointCollection& point_collection, IngestStatistics& statistics)
+{
+	ParseCsvLines(begin, end, point_collection, &statistics);
+}
+
+
+// Parse csv lines, with or without statistics
+void FileIO::ParseCsvLines(const char* begin, const char* end, PointCollection& point_collection, IngestStatistics* statistics)
+{
+	// Reserve memory based on a typical line length
+	point_collection.points_.reserve(point_collection.points_.size() + (end - begin) / 24);
+	
+	PointCollection::Point point = {0.0, 0.0, 0.0, 0, 0, 0, 0, 0, 2, false, {0,0,0}};
+	const char* p = begin;
+	char* next;
+	
+	while (p < end){
+		
+		// Find the end of the current line
+		const char* eol = (const char*) memchr(p, '\n', end - p);
+		if (eol == NULL){
+			eol = end;
+		}
+		
+		// Copy the line to a null terminated string so that strtod cannot read past it
+		char line[256];
+		size_t length = min((size_t) (eol - p), sizeof(line) - 1);
+		memcpy(line, p, length);
+		line[length] = '\0';
+		p = eol + 1;
+		
+		// Skip blank lines
+		char* field = line;
+		while (isspace((unsigned char) *field)){
+			field++;
+		}
+		if (*field == '\0'){
+			continue;
+		}
+		
+		point.x = strtod(field, &next);
+		field = (*next == ',') ? next + 1 : next;
+		
+		point.y = strtod(field, &next);
+		field = (*next == ',') ? next + 1 : next;
+		
+		point.z = strtod(field, &next);
+		field = (*next == ',') ? next + 1 : next;
+		
+		point.classification = (unsigned int) strtoul(field, &next, 10);
+		
+		if (statistics != NULL){
+			
+			statistics->AddPoint(point.x, point.y, point.z, point.classification);
+			
+		}
+		
+		// Add Point to PointCollection
+		point_collection.points_.push_back(point);
+	
+	}
+}
+
+
+// Split a csv buffer into line aligned chunks of similar size
+vector<array<size_t, 2>> FileIO::SplitCsvBuffer(const char* data, size_t size, unsigned int n_chunks)
+{
+	vector<array<size_t, 2>> chunks;
+	size_t begin(0);
+	
+	for (unsigned int j(1); (j <= n_chunks) and (begin < size); j++){
+		
+		size_t end = (j == n_chunks) ? size : max(begin, (size * j) / n_chunks);
+		
+		// Move the chunk end after the next line break
+		const char* eol = (const char*) memchr(data + end, '\n', size - end);
+		end = (eol == NULL) ? size : (eol - data) + 1;
+		
+		chunks.push_back({begin, end});
+		begin = end;
+		
+	}
+	
+	return chunks;
+}
+
+
+// Read a point cloud from a POSIX shared memory object into a vector of Points
+bool FileIO::ReadSharedMemoryPoints(const string& shm_name, PointCollection& point_collection)
+{
+	#ifdef _WIN32
+	
+		cerr << "FAILURE: shared memory input is not supported on this platform" << endl;
+		return false;
+	
+	#else
+	
+		int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+		
+		if (fd < 0){
+			
+			cerr << "FAILURE: unable to open shared memory object " << shm_name << endl;
+			return false;
+			
+		}
+		
+		struct stat shm_stat;
+		if ((fstat(fd, &shm_stat) != 0) or ((size_t) shm_stat.st_size < sizeof(uint64_t))){
+			
+			cerr << "FAILURE: invalid shared memory object " << shm_name << endl;
+			close(fd);
+			return false;
+			
+		}
+		
+		void* data = mmap(NULL, shm_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		
+		if (data == MAP_FAILED){
+			
+			cerr << "FAILURE: unable to map shared memory object " << shm_name << endl;
+			return false;
+			
+		}
+		
+		// Check that the object is large enough for the announced number of points
+		uint64_t n_points = *((uint64_t*) data);
+		if (n_points > (shm_stat.st_size - sizeof(uint64_t)) / sizeof(SharedMemoryPoint)){
+			
+			cerr << "FAILURE: truncated shared memory object " << shm_name << endl;
+			munmap(data, shm_stat.st_size);
+			return false;
+			
+		}
+		
+		const SharedMemoryPoint* records = (const SharedMemoryPoint*) ((const char*) data + sizeof(uint64_t));
+		
+		point_collection.points_.clear();
+		point_collection.points_.reserve(n_points);
+		
+		PointCollection::Point point = {0.0, 0.0, 0.0, 0, 0, 0, 0, 0, 2, false, {0,0,0}};
+		
+		for (uint64_t j(0); j < n_points; j++){
+			
+			point.x = records[j].x;
+			point.y = records[j].y;
+			point.z = records[j].z;
+			point.classification = records[j].classification;
+			point_collection.points_.push_back(point);
+			
+		}
+		
+		munmap(data, shm_stat.st_size);
+		
+		return true;
+	
+	#endif
+}
+
+
+// Interleave the bits of two 16 bit values (Morton code)
+static uint32_t MortonCode(uint32_t x, uint32_t y)
+{
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	
+	y = (y | (y << 8)) & 0x00FF00FF;
+	y = (y | (y << 4)) & 0x0F0F0F0F;
+	y = (y | (y << 2)) & 0x33333333;
+	y = (y | (y << 1)) & 0x55555555;
+	
+	return x | (y << 1);
+}
+
+
+// Check if a point lies within a polygon (crossing number)
+static bool IsInPolygon(const vector<array<double, 2>>& polygon, double x, double y)
+{
+	bool inside(false);
+	
+	for (size_t j(0), k(polygon.size() - 1); j < polygon.size(); k = j++){
+		
+		if (((polygon[j][1] > y) != (polygon[k][1] > y)) and (x < (polygon[k][0] - polygon[j][0]) * (y - polygon[j][1]) / (polygon[k][1] - polygon[j][1]) + polygon[j][0])){
+			
+			inside = not inside;
+			
+		}
+	}
+	
+	return inside;
+}
+
+
+// Write a vector of Points to a spatially chunked binary file
+bool FileIO::WriteChunkedPoints(PointCollection& point_collection, const string& o_filepath, unsigned int chunk_size)
+{
+	ofstream o_file(o_filepath, ios::binary);
+	
+	if (not o_file){
+		
+		cerr << "FAILURE: unable to open output file " << o_filepath << endl;
+		return false;
+		
+	}
+	
+	const vector<PointCollection::Point>& points = point_collection.points_;
+	chunk_size = max(1u, chunk_size);
+	
+	// Sort the points along a Morton curve over the extent of the point cloud
+	double x_min(0.0), x_max(0.0), y_min(0.0), y_max(0.0);
+	
+	for (size_t j(0); j < points.size(); j++){
+		
+		x_min = (j == 0) ? points[j].x : min(x_min, points[j].x);
+		x_max = (j == 0) ? points[j].x : max(x_max, points[j].x);
+		y_min = (j == 0) ? points[j].y : min(y_min, points[j].y);
+		y_max = (j == 0) ? points[j].y : max(y_max, points[j].y);
+		
+	}
+	
+	double x_scale = 65535.0 / max(x_max - x_min, 1e-9);
+	double y_scale = 65535.0 / max(y_max - y_min, 1e-9);
+	vector<pair<uint32_t, size_t>> order(points.size());
+	
+	for (size_t j(0); j < points.size(); j++){
+		
+		order[j] = {MortonCode((uint32_t) ((points[j].x - x_min) * x_scale), (uint32_t) ((points[j].y - y_min) * y_scale)), j};
+		
+	}
+	
+	sort(order.begin(), order.end());
+	
+	// Chunks
+	vector<ChunkHeader> index;
+	vector<ChunkPoint> records;
+	
+	for (size_t begin(0); begin < points.size(); begin += chunk_size){
+		
+		size_t end = min(points.size(), begin + chunk_size);
+		const PointCollection::Point& first = points[order[begin].second];
+		
+		ChunkHeader header;
+		memset(&header, 0, sizeof(header));
+		header.n_points = end - begin;
+		header.x_min = header.x_max = first.x;
+		header.y_min = header.y_max = first.y;
+		header.z_min = header.z_max = first.z;
+		records.resize(end - begin);
+		
+		for (size_t j(begin); j < end; j++){
+			
+			const PointCollection::Point& point = points[order[j].second];
+			header.x_min = min(header.x_min, point.x);
+			header.x_max = max(header.x_max, point.x);
+			header.y_min = min(header.y_min, point.y);
+			header.y_max = max(header.y_max, point.y);
+			header.z_min = min(header.z_min, point.z);
+			header.z_max = max(header.z_max, point.z);
+			header.class_histogram[min(point.classification, 255u)]++;
+			records[j - begin] = {point.x, point.y, point.z, point.classification, 0};
+			
+		}
+		
+		header.offset = (uint64_t) o_file.tellp() + sizeof(ChunkHeader);
+		o_file.write((const char*) &header, sizeof(header));
+		o_file.write((const char*) records.data(), records.size() * sizeof(ChunkPoint));
+		index.push_back(header);
+		
+	}
 	
-	o_filepath_points_ = current_file_parts.path + current_file_parts.name  + "_seg.csv";	
-	ofstream o_file(o_filepath_points_);
+	// Chunk index and footer
+	ChunkedFileFooter footer;
+	footer.index_offset = o_file.tellp();
+	footer.n_chunks = index.size();
+	footer.n_points = points.size();
+	memcpy(footer.magic, "TSPOINT1", 8);
+	o_file.write((const char*) index.data(), index.size() * sizeof(ChunkHeader));
+	o_file.write((const char*) &footer, sizeof(footer));
+	
+	return bool(o_file);
+}
+
+
+// Read the points of a chunked binary file located within a region of interest
+bool FileIO::ReadChunkedPoints(const RegionOfInterest& region_of_interest, PointCollection& point_collection, bool verbosity)
+{
+	#ifdef _WIN32
+	
+		cerr << "FAILURE: chunked point files are not supported on this platform" << endl;
+		return false;
+	
+	#else
+	
+		int fd = open(i_filepath_.c_str(), O_RDONLY);
+		
+		if (fd < 0){
+			
+			cerr << "FAILURE: unable to open input file " << i_filepath_ << endl;
+			return false;
 			
-	if(o_file){
+		}
 		
-		// Set decimal precision
-		o_file << fixed << setprecision(precision);
+		struct stat file_stat;
+		if ((fstat(fd, &file_stat) != 0) or ((size_t) file_stat.st_size < sizeof(ChunkedFileFooter))){
+			
+			cerr << "FAILURE: invalid chunked point file " << i_filepath_ << endl;
+			close(fd);
+			return false;
+			
+		}
 		
-		cout << "Writing points to " << o_filepath_points_ << endl;
+		size_t size = file_stat.st_size;
+		void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
 		
-		// Print header
-		o_file << "X, Y, H, ID, R, G, B" << endl;
+		if (data == MAP_FAILED){
+			
+			cerr << "FAILURE: unable to map input file " << i_filepath_ << endl;
+			return false;
+			
+		}
 		
-		// Print content
-		for(unsigned int j(0); j < point_collection.points_.size(); j++){
+		// Only the selected chunks are paged in
+		madvise(data, size, MADV_RANDOM);
+		
+		// Check the footer and the index
+		const ChunkedFileFooter* footer = (const ChunkedFileFooter*) ((const char*) data + size - sizeof(ChunkedFileFooter));
+		bool valid = (memcmp(footer->magic, "TSPOINT1", 8) == 0) and (footer->index_offset <= size - sizeof(ChunkedFileFooter));
+		valid = valid and (footer->n_chunks == (size - sizeof(ChunkedFileFooter) - footer->index_offset) / sizeof(ChunkHeader));
+		
+		const ChunkHeader* index = (const ChunkHeader*) ((const char*) data + (valid ? footer->index_offset : 0));
+		
+		for (uint64_t j(0); valid and (j < footer->n_chunks); j++){
+			
+			valid = (index[j].offset <= footer->index_offset) and (index[j].n_points <= (footer->index_offset - index[j].offset) / sizeof(ChunkPoint));
 			
-			o_file << point_collection.points_[j].x << ", " << point_collection.points_[j].y << ", " << point_collection.points_[j].z << ", " << point_collection.points_[j].tree_idx << ", " << point_collection.points_[j].rgb_color[0] << ", " << point_collection.points_[j].rgb_color[1] << ", " << point_collection.points_[j].rgb_color[2] <<  endl;
 		}
 		
-	} else{
+		if (not valid){
+			
+			cerr << "FAILURE: invalid chunked point file " << i_filepath_ << endl;
+			munmap(data, size);
+			return false;
+			
+		}
+		
+		// Bounding box of the region of interest
+		double x_min(region_of_interest.x_min), x_max(region_of_interest.x_max), y_min(region_of_interest.y_min), y_max(region_of_interest.y_max);
+		bool has_bbox = region_of_interest.has_bbox;
+		const vector<array<double, 2>>& polygon = region_of_interest.polygon;
+		
+		if (polygon.size() > 0){
+			
+			// Extent of the polygon, intersected with the bounding box
+			double px_min(polygon[0][0]), px_max(px_min), py_min(polygon[0][1]), py_max(py_min);
+			
+			for (size_t j(1); j < polygon.size(); j++){
+				
+				px_min = min(px_min, polygon[j][0]);
+				px_max = max(px_max, polygon[j][0]);
+				py_min = min(py_min, polygon[j][1]);
+				py_max = max(py_max, polygon[j][1]);
+				
+			}
+			
+			x_min = has_bbox ? max(x_min, px_min) : px_min;
+			x_max = has_bbox ? min(x_max, px_max) : px_max;
+			y_min = has_bbox ? max(y_min, py_min) : py_min;
+			y_max = has_bbox ? min(y_max, py_max) : py_max;
+			has_bbox = true;
+			
+		}
+		
+		// Class filter as a histogram mask
+		vector<bool> class_mask(256, region_of_interest.classes.empty());
+		
+		for (size_t j(0); j < region_of_interest.classes.size(); j++){
+			
+			class_mask[min(region_of_interest.classes[j], 255u)] = true;
+			
+		}
+		
+		// Select the chunks
+		vector<uint64_t> selected;
+		size_t n_selected_points(0);
+		uint64_t page_mask = ~(uint64_t) (sysconf(_SC_PAGESIZE) - 1);
+		
+		for (uint64_t j(0); j < footer->n_chunks; j++){
+			
+			const ChunkHeader& header = index[j];
+			bool intersects = (not has_bbox) or ((header.x_max >= x_min) and (header.x_min <= x_max) and (header.y_max >= y_min) and (header.y_min <= y_max));
+			bool has_class(false);
+			
+			for (unsigned int k(0); intersects and (not has_class) and (k < 256); k++){
+				
+				has_class = class_mask[k] and (header.class_histogram[k] > 0);
+				
+			}
+			
+			if (intersects and has_class){
+				
+				selected.push_back(j);
+				n_selected_points += header.n_points;
+				
+				// Prefetch the chunk records
+				uint64_t page_offset = header.offset & page_mask;
+				madvise((char*) data + page_offset, header.offset - page_offset + header.n_points * sizeof(ChunkPoint), MADV_WILLNEED);
+				
+			}
+		}
+		
+		// Read the points of the selected chunks
+		point_collection.points_.clear();
+		point_collection.points_.reserve(n_selected_points);
+		
+		PointCollection::Point point = {0.0, 0.0, 0.0, 0, 0, 0, 0, 0, 2, false, {0,0,0}};
+		
+		for (size_t j(0); j < selected.size(); j++){
+			
+			const ChunkHeader& header = index[selected[j]];
+			const ChunkPoint* records = (const ChunkPoint*) ((const char*) data + header.offset);
+			
+			// Chunks entirely within the bounding box only need the polygon and class tests
+			bool contained = (not has_bbox) or ((header.x_min >= x_min) and (header.x_max <= x_max) and (header.y_min >= y_min) and (header.y_max <= y_max));
+			
+			for (uint32_t k(0); k < header.n_points; k++){
+				
+				const ChunkPoint& record = records[k];
+				
+				if (not (contained or ((record.x >= x_min) and (record.x <= x_max) and (record.y >= y_min) and (record.y <= y_max)))){
+					
+					continue;
+					
+				}
+				
+				if ((not region_of_interest.classes.empty()) and (find(region_of_interest.classes.begin(), region_of_interest.classes.end(), record.classification) == region_of_interest.classes.end())){
+					
+					continue;
+					
+				}
+				
+				if ((polygon.size() >= 3) and (not IsInPolygon(polygon, record.x, record.y))){
+					
+					continue;
+					
+				}
+				
+				point.x = record.x;
+				point.y = record.y;
+				point.z = record.z;
+				point.classification = record.classification;
+				point_collection.points_.push_back(point);
+				
+			}
+		}
+		
+		if (verbosity){
+			
+			cout << "Reading " << i_filepath_ << " (" << selected.size() << " of " << footer->n_chunks << " chunks)...Done!" << endl;
+			
+		}
+		
+		munmap(data, size);
+		
+		return true;
+	
+	#endif
+}
+
+
+// Write a vector of segmented Points to .csv file
+void FileIO::WritePointsToCSV(PointCollection& point_collection, unsigned int precision)
+{
+	OutputStream o_file;
+	
+	if (not OpenPointOutput(o_file, precision)){
 		
-		cerr << "FAILURE: unable to open output file ";
+		exit(1);
+		
+	}
+	
+	// Print content
+	for(unsigned int j(0); j < point_collection.points_.size(); j++){
+		
+		WritePointRow(o_file, point_collection.points_[j]);
+		
+	}
+	
+	if (not o_file.Close()){
+		
+		cerr << "FAILURE: unable to write output file " << o_filepath_points_ << endl;
 		exit(1);
 		
 	}
@@ -171,52 +895,181 @@ void FileIO::WritePointsToCSV(PointCollection& point_collection, unsigned int pr
 // Write a TreeCollection to .csv file
 void FileIO::WriteTreesToCSV(TreeCollection& tree_collection, unsigned int precision)
 {
+	OutputStream o_file;
 	
-	// Create output file name
+	if (not OpenTreeOutput(o_file, precision)){
+		
+		exit(1);
+		
+	}
+	
+	// Print content
+	for(unsigned int j(0); j < tree_collection.trees_.size(); j++){
+		
+		WriteTreeRow(o_file, tree_collection.trees_[j]);
+	
+	}
+	
+	if (not o_file.Close()){
+		
+		cerr << "FAILURE: unable to write output file " << o_filepath_trees_ << endl;
+		exit(1);
+		
+	}
+
+}
+
+
+// Get the path of an array output
+string FileIO::GetArrayOutputPath(const string& suffix, ArrayOutput array_output)
+{
 	FileParts current_file_parts = GetFileParts(i_filepath_);
+	return current_file_parts.path + current_file_parts.name + suffix + ((array_output == NPZ_ARRAYS) ? ".npz" : "_npy");
+}
+
+
+// Write the columns of a PointCollection as NumPy arrays
+bool FileIO::WritePointsToNpy(const PointCollection& point_collection, ArrayOutput array_output)
+{
+	const vector<PointCollection::Point>& points = point_collection.points_;
+	size_t n = points.size();
+	NpyWriter writer;
 	
-	o_filepath_trees_ = current_file_parts.path + current_file_parts.name  + "_trees.csv";	
-	ofstream o_file(o_filepath_trees_);
-			
-	if(o_file){
+	if (not writer.Open(GetArrayOutputPath("_seg", array_output), array_output == NPZ_ARRAYS)){
 		
-		// Set decimal precision
-		o_file << fixed << setprecision(precision);
+		return false;
 		
-		cout << "Writing trees to " << o_filepath_trees_ << endl;
+	}
+	
+	bool success = writer.WriteArray<double>("x", n, 1, [&](size_t j, unsigned int){ return points[j].x; })
+		and writer.WriteArray<double>("y", n, 1, [&](size_t j, unsigned int){ return points[j].y; })
+		and writer.WriteArray<double>("z", n, 1, [&](size_t j, unsigned int){ return points[j].z; })
+		and writer.WriteArray<uint32_t>("tree_idx", n, 1, [&](size_t j, unsigned int){ return (uint32_t) points[j].tree_idx; })
+		and writer.WriteArray<uint16_t>("rgb", n, 3, [&](size_t j, unsigned int c){ return (uint16_t) points[j].rgb_color[c]; });
+	
+	return writer.Close() and success;
+}
+
+
+// Write the attributes of a TreeCollection as NumPy arrays
+bool FileIO::WriteTreesToNpy(const TreeCollection& tree_collection, ArrayOutput array_output)
+{
+	const vector<TreeCollection::Tree>& trees = tree_collection.trees_;
+	size_t n = trees.size();
+	NpyWriter writer;
+	
+	if (not writer.Open(GetArrayOutputPath("_trees", array_output), array_output == NPZ_ARRAYS)){
 		
-		// Print header
-		o_file << "ID, X_TOP, Y_TOP, H_TOP, X_BARYCENTER, Y_BARYCENTER, H_BARYCENTER, H_REL_BARYCENTER, N_POINTS" << endl;
+		return false;
 		
-		// Print content
-		for(unsigned int j(0); j < tree_collection.trees_.size(); j++){
+	}
+	
+	bool success = writer.WriteArray<uint32_t>("tree_idx", n, 1, [&](size_t j, unsigned int){ return (uint32_t) trees[j].tree_idx; })
+		and writer.WriteArray<double>("x_top", n, 1, [&](size_t j, unsigned int){ return trees[j].x_top; })
+		and writer.WriteArray<double>("y_top", n, 1, [&](size_t j, unsigned int){ return trees[j].y_top; })
+		and writer.WriteArray<double>("h_top", n, 1, [&](size_t j, unsigned int){ return trees[j].h_top; })
+		and writer.WriteArray<double>("x_barycenter", n, 1, [&](size_t j, unsigned int){ return trees[j].x_barycenter; })
+		and writer.WriteArray<double>("y_barycenter", n, 1, [&](size_t j, unsigned int){ return trees[j].y_barycenter; })
+		and writer.WriteArray<double>("h_barycenter", n, 1, [&](size_t j, unsigned int){ return trees[j].h_barycenter; })
+		and writer.WriteArray<double>("rel_h_barycenter", n, 1, [&](size_t j, unsigned int){ return trees[j].rel_h_barycenter; })
+		and writer.WriteArray<uint32_t>("n_points", n, 1, [&](size_t j, unsigned int){ return (uint32_t) trees[j].n_points; });
+	
+	return writer.Close() and success;
+}
+
+
+// Set the compression of the output files
+void FileIO::SetOutputCompression(unsigned int compression_threads)
+{
+	compression_threads_ = compression_threads;
+}
+
+
+// Create the point output file and print its header
+bool FileIO::OpenPointOutput(OutputStream& o_file, unsigned int precision)
+{
+	
+	// Create output file name
+	FileParts current_file_parts = GetFileParts(i_filepath_);
+	
+	o_filepath_points_ = current_file_parts.path + current_file_parts.name  + "_seg.csv" + ((compression_threads_ > 0) ? ".gz" : "");	
 			
-			o_file 
-			<< tree_collection.trees_[j].tree_idx << ", " 
-			<< tree_collection.trees_[j].x_top << ", " 
-			<< tree_collection.trees_[j].y_top << ", " 
-			<< tree_collection.trees_[j].h_top << ", " 
-			<< tree_collection.trees_[j].x_barycenter << ", " 
-			<< tree_collection.trees_[j].y_barycenter << ", " 
-			<< tree_collection.trees_[j].h_barycenter << ", " 
-			<< tree_collection.trees_[j].rel_h_barycenter << ", " 
-			<< tree_collection.trees_[j].n_points
-			<< endl;
+	if (not o_file.Open(o_filepath_points_, compression_threads_)){
 		
-		}
+		cerr << "FAILURE: unable to open output file " << o_filepath_points_ << endl;
+		return false;
 		
-	} else{
+	}
+	
+	// Set decimal precision
+	o_file << fixed << setprecision(precision);
+	
+	cout << "Writing points to " << o_filepath_points_ << endl;
+	
+	// Print header
+	o_file << "X, Y, H, ID, R, G, B" << endl;
+	
+	return true;
+
+}
+
+
+// Create the tree output file and print its header
+bool FileIO::OpenTreeOutput(OutputStream& o_file, unsigned int precision)
+{
+	
+	// Create output file name
+	FileParts current_file_parts = GetFileParts(i_filepath_);
+	
+	o_filepath_trees_ = current_file_parts.path + current_file_parts.name  + "_trees.csv" + ((compression_threads_ > 0) ? ".gz" : "");	
+			
+	if (not o_file.Open(o_filepath_trees_, compression_threads_)){
 		
-		cerr << "FAILURE: unable to open output file ";
-		exit(1);
+		cerr << "FAILURE: unable to open output file " << o_filepath_trees_ << endl;
+		return false;
 		
 	}
+	
+	// Set decimal precision
+	o_file << fixed << setprecision(precision);
+	
+	cout << "Writing trees to " << o_filepath_trees_ << endl;
+	
+	// Print header
+	o_file << "ID, X_TOP, Y_TOP, H_TOP, X_BARYCENTER, Y_BARYCENTER, H_BARYCENTER, H_REL_BARYCENTER, N_POINTS" << endl;
+	
+	return true;
+
+}
 
+
+// Print a row of the point output file
+void FileIO::WritePointRow(ostream& o_file, const PointCollection::Point& point)
+{
+	o_file << point.x << ", " << point.y << ", " << point.z << ", " << point.tree_idx << ", " << point.rgb_color[0] << ", " << point.rgb_color[1] << ", " << point.rgb_color[2] << "\n";
+}
+
+
+// Print a row of the tree output file
+void FileIO::WriteTreeRow(ostream& o_file, const TreeCollection::Tree& tree)
+{
+	o_file 
+	<< tree.tree_idx << ", " 
+	<< tree.x_top << ", " 
+	<< tree.y_top << ", " 
+	<< tree.h_top << ", " 
+	<< tree.x_barycenter << ", " 
+	<< tree.y_barycenter << ", " 
+	<< tree.h_barycenter << ", " 
+	<< tree.rel_h_barycenter << ", " 
+	<< tree.n_points
+	<< "\n";
 }
 
 // Constructor
 FileIO::FileIO(std::string i_filepath)
 {
 	i_filepath_ = i_filepath;
+	compression_threads_ = 0;
 	
 }
@@ -20,6 +20,8 @@
  *
  * This class provides an input/output interface for the following formats:
  * -csv (comma separated value)
+ * -tsp (spatially chunked binary points)
+ * -npy and npz (NumPy arrays, output only)
  * 
  */
 
@@ -32,8 +34,12 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <array>
+#include <cstdint>
 #include "PointCollection.h"
 #include "TreeCollection.h"
+#include "BlockGzip.h"
+#include "IngestStatistics.h"
 
 class FileIO {
 
@@ -58,6 +64,74 @@ public:
 	PointCollection ReadCsvPoints();
 	
 	
+	/**
+	 * Checks if a file path has the .csv or .csv.gz extension.
+	 *
+	 */
+	static bool IsCsvFile(const std::string& filepath);
+	
+	/**
+	 * Reads the whole input file into memory (in chunks read concurrently, see AsyncReader). Gzip files (.gz extension) are decompressed.
+	 *
+	 * @param  buffer A reference to the buffer where the file contents will be contained.
+	 * @return Returns true if the file could be read.
+	 */
+	bool ReadInputBuffer(std::vector<char>& buffer);
+	
+	/**
+	 * Decompresses the contents of the input file in place if it is a gzip file (.gz extension).
+	 *
+	 * @param  buffer A reference to the buffer containing the file contents.
+	 * @return Returns false if the gzip data is invalid.
+	 */
+	bool DecompressInputBuffer(std::vector<char>& buffer);
+	
+	
+	/**
+	 * Parses csv lines (x, y, z, classification) and appends the corresponding Points to a PointCollection.
+	 *
+	 * @param  begin Pointer to the first character of the first line.
+	 * @param  end Pointer past the last character.
+	 * @param  point_collection A reference to the PointCollection where the points will be appended.
+	 */
+	static void ParseCsvBuffer(const char* begin, const char* end, PointCollection& point_collection);
+	
+	
+	/**
+	 * Parses csv lines and appends the corresponding Points to a PointCollection, while adding them to IngestStatistics.
+	 *
+	 * @param  begin Pointer to the first character of the first line.
+	 * @param  end Pointer past the last character.
+	 * @param  point_collection A reference to the PointCollection where the points will be appended.
+	 * @param  statistics A reference to the IngestStatistics updated with the parsed points.
+	 */
+	static void ParseCsvBuffer(const char* begin, const char* end, PointCollection& point_collection, IngestStatistics& statistics);
+	
+	
+	/**
+	 * Splits a csv buffer into line aligned chunks which can be parsed independently.
+	 *
+	 * @param  data Pointer to the buffer.
+	 * @param  size The size of the buffer.
+	 * @param  n_chunks The requested number of chunks.
+	 * @return Returns the (begin, end) offsets of each chunk.
+	 */
+	static std::vector<std::array<size_t, 2>> SplitCsvBuffer(const char* data, size_t size, unsigned int n_chunks);
+	
+	
+	/**
+	 * Reads the contents of a POSIX shared memory object to a PointCollection object.
+	 *
+	 * The shared memory object starts with the number of points (uint64) followed by one SharedMemoryPoint record per point.
+	 * The output files are named after the filepath given to the FileIO constructor.
+	 * 
+	 * @param  shm_name The name of the shared memory object (e.g. /tile_001).
+	 * @param  point_collection A reference to the PointCollection where the points will be contained.
+	 * @return Returns true if the shared memory object could be read.
+	 */
+	bool ReadSharedMemoryPoints(const std::string& shm_name, PointCollection& point_collection);
+	
+	
 	/**
 	 * Writes the contents of a PointCollection to a csv file. The output file is created in the same folder as the input file and has a "_seg" suffix appended.
 	 * 
@@ -87,14 +161,207 @@ public:
 	 */
 	void WriteTreesToCSV(TreeCollection& tree_collection, unsigned int precision);
 	
+	/**
+	 * Output of the points and trees as NumPy arrays, in addition to the csv files.
+	 *
+	 */
+	enum ArrayOutput {NO_ARRAYS, NPY_ARRAYS, NPZ_ARRAYS};
+	
+	/**
+	 * Writes the columns of a PointCollection as NumPy arrays: x, y, z (float64), tree_idx (uint32) and rgb (n x 3 uint16).
+	 * The arrays are written in a directory with a "_seg_npy" suffix (NPY_ARRAYS), or bundled in a file with a "_seg.npz"
+	 * suffix (NPZ_ARRAYS), in the same folder as the input file.
+	 *
+	 * @param  point_collection Reference to the PointCollection to be written.
+	 * @param  array_output The format of the arrays.
+	 * @return Returns false if the arrays could not be written.
+	 */
+	bool WritePointsToNpy(const PointCollection& point_collection, ArrayOutput array_output);
+	
+	/**
+	 * Writes the attributes of a TreeCollection as NumPy arrays, named after the columns of the tree csv file: tree_idx and
+	 * n_points (uint32), x_top, y_top, h_top, x_barycenter, y_barycenter, h_barycenter and rel_h_barycenter (float64).
+	 * The arrays are written in a directory with a "_trees_npy" suffix, or bundled in a file with a "_trees.npz" suffix.
+	 *
+	 * @param  tree_collection Reference to the TreeCollection to be written.
+	 * @param  array_output The format of the arrays.
+	 * @return Returns false if the arrays could not be written.
+	 */
+	bool WriteTreesToNpy(const TreeCollection& tree_collection, ArrayOutput array_output);
+	
+	/**
+	 * Returns the path of the array output (directory or .npz file) of the points ("_seg" suffix) or of the trees ("_trees" suffix).
+	 *
+	 */
+	std::string GetArrayOutputPath(const std::string& suffix, ArrayOutput array_output);
+	
+	/**
+	 * Sets the compression of the output files. Compressed output files are written in gzip blocks compressed
+	 * concurrently (see BlockGzip), and have a .gz extension appended.
+	 *
+	 * @param  compression_threads The number of compression threads (0 = uncompressed output).
+	 */
+	void SetOutputCompression(unsigned int compression_threads);
+	
+	/**
+	 * Creates the point output file of WritePointsToCSV and writes its header.
+	 *
+	 * @param  o_file A reference to the output stream to open.
+	 * @param  precision The decimal precision used for double values in the output file.
+	 * @return Returns false if the file could not be created.
+	 */
+	bool OpenPointOutput(OutputStream& o_file, unsigned int precision);
+	
+	/**
+	 * Creates the tree output file of WriteTreesToCSV and writes its header.
+	 *
+	 * @param  o_file A reference to the output stream to open.
+	 * @param  precision The decimal precision used for double values in the output file.
+	 * @return Returns false if the file could not be created.
+	 */
+	bool OpenTreeOutput(OutputStream& o_file, unsigned int precision);
+	
+	/**
+	 * Writes a row of the point and tree output files.
+	 *
+	 */
+	static void WritePointRow(std::ostream& o_file, const PointCollection::Point& point);
+	static void WriteTreeRow(std::ostream& o_file, const TreeCollection::Tree& tree);
+	
 	std::string GetInputFilepath();
 	std::string GetPointOutputFilepath();
 	std::string GetTreeOutputFilepath();
+	
+	/**
+	 * Returns the path of the segmentation state file, created in the same folder as the input file with a "_state.bin" suffix.
+	 *
+	 */
+	std::string GetStateFilepath();
+	
+	/**
+	 * Returns the path of the tree index file (see TreeIndex), next to the input file with a "_tree_index.bin" suffix.
+	 *
+	 */
+	std::string GetTreeIndexFilepath();
+	
+	/**
+	 * Returns the path of the octree directory (see OctreeExporter), next to the input file with an "_octree" suffix.
+	 *
+	 */
+	std::string GetOctreeDirectory();
+	
+	/**
+	 * Returns the path of the derived structure cache file, created in the same folder as the input file with a "_cache.bin" suffix.
+	 *
+	 */
+	std::string GetCacheFilepath();
+	
+	
+	/**
+	 * Computes a 64 bit hash of a buffer.
+	 *
+	 * @param  data Pointer to the buffer.
+	 * @param  size The size of the buffer.
+	 * @param  seed The initial hash value (e.g. the hash of the preceding data).
+	 * @return Returns the hash value.
+	 */
+	static uint64_t HashBuffer(const char* data, size_t size, uint64_t seed);
+	
+	
+	/**
+	 * Writes a prepared PointCollection (filtered, sorted by height, gridded and with local maxima) to the cache file.
+	 *
+	 * The cache file is memory-mappable: a fixed size header is followed by the point records, the grid cell
+	 * offsets and the point indexes of each grid cell.
+	 * 
+	 * @param  point_collection Reference to the prepared PointCollection.
+	 * @param  key The hash of the input contents and of the parameters used in the preparation.
+	 * @param  n_input_points The number of points in the input file (before filtering).
+	 * @return Returns true if the cache file could be written.
+	 */
+	bool WritePointCache(PointCollection& point_collection, uint64_t key, uint64_t n_input_points);
+	
+	
+	/**
+	 * Reads a prepared PointCollection from the cache file, if it exists and was created with the same key.
+	 *
+	 * @param  point_collection Reference to the PointCollection where the prepared points will be contained.
+	 * @param  key The hash of the input contents and of the parameters used in the preparation.
+	 * @param  n_input_points A reference to the number of points in the input file (before filtering).
+	 * @return Returns true if a valid cache file was read.
+	 */
+	bool ReadPointCache(PointCollection& point_collection, uint64_t key, uint64_t& n_input_points);
+
+	/**
+	 * Region of interest and class filter applied when reading a chunked point file.
+	 *
+	 */
+	struct RegionOfInterest {
+		
+		bool has_bbox; // If true, only the points within the bounding box are read
+		double x_min;
+		double x_max;
+		double y_min;
+		double y_max;
+		std::vector<std::array<double, 2>> polygon; // Vertices (x, y) of a polygon the points must lie in, empty for none
+		std::vector<unsigned int> classes; // Classes which are read, empty for all
+		
+	};
+	
+	
+	/**
+	 * Writes the contents of a PointCollection to a spatially chunked binary point file (.tsp).
+	 *
+	 * The points are sorted along a Morton (Z-order) curve and split into chunks of a fixed number of points. Each chunk starts
+	 * with a ChunkHeader (bounding box, z range and class histogram of its points) followed by its ChunkPoint records. The file
+	 * ends with an index made of a copy of all the ChunkHeaders and a ChunkedFileFooter, so that a reader can select the chunks
+	 * it needs without touching the others.
+	 * 
+	 * @param  point_collection Reference to the PointCollection to be written (all classes).
+	 * @param  o_filepath The output file path.
+	 * @param  chunk_size The number of points per chunk.
+	 * @return Returns true if the file could be written.
+	 */
+	static bool WriteChunkedPoints(PointCollection& point_collection, const std::string& o_filepath, unsigned int chunk_size);
+	
+	
+	/**
+	 * Reads the points of a chunked binary point file (.tsp) located within a region of interest to a PointCollection object.
+	 *
+	 * The file is memory-mapped and only the chunks whose header intersects the region of interest and contains at least one
+	 * of the requested classes are accessed.
+	 * 
+	 * @param  region_of_interest The RegionOfInterest and class filter.
+	 * @param  point_collection A reference to the PointCollection where the points will be contained.
+	 * @param  verbosity If true, prints the number of chunks read.
+	 * @return Returns true if the file could be read.
+	 */
+	bool ReadChunkedPoints(const RegionOfInterest& region_of_interest, PointCollection& point_collection, bool verbosity);
 
 	FileIO(std::string i_filepath); // Constructor
 	~FileIO(){} ; // Destructor
 	
+	/**
+	 * Point record used in shared memory objects.
+	 *
+	 */
+	struct SharedMemoryPoint {
+		
+		double x;
+		double y;
+		double z;
+		unsigned int classification;
+		unsigned int padding;
+	
+	};
+	
 private:
+	
+	/**
+	 * Parses csv lines, optionally adding the points to IngestStatistics (NULL to skip the statistics).
+	 *
+	 */
+	static void ParseCsvLines(const char* begin, const char* end, PointCollection& point_collection, IngestStatistics* statistics);
 
 
 	struct FileParts {
@@ -113,6 +380,92 @@ private:
 	 */
 	FileParts GetFileParts(const std::string& s);
 	
+	/**
+	 * Header of the derived structure cache file.
+	 *
+	 */
+	struct CacheHeader {
+		
+		char magic[8];
+		uint64_t key;
+		uint64_t n_points;
+		uint64_t n_blocks; // Number of occupied blocks of the SparseGrid
+		uint64_t n_input_points;
+		uint32_t n_cols;
+		uint32_t n_rows;
+		uint32_t coordinate_scaling;
+		uint32_t padding;
+		double x_origin;
+		double y_origin;
+		double x_min; // Bounding box
+		double x_max;
+		double y_min;
+		double y_max;
+		
+	};
+	
+	/**
+	 * Point record of the derived structure cache file.
+	 *
+	 */
+	struct CachePoint {
+		
+		double x;
+		double y;
+		double z;
+		int32_t row;
+		int32_t col;
+		uint32_t classification;
+		uint32_t local_maxima_status;
+		
+	};
+	
+	/**
+	 * Header of a chunk of a chunked binary point file. Classes above 255 are counted in the last histogram bin.
+	 *
+	 */
+	struct ChunkHeader {
+		
+		uint64_t offset; // Offset of the first ChunkPoint record
+		uint32_t n_points;
+		uint32_t padding;
+		double x_min;
+		double x_max;
+		double y_min;
+		double y_max;
+		double z_min;
+		double z_max;
+		uint32_t class_histogram[256];
+		
+	};
+	
+	/**
+	 * Point record of a chunked binary point file.
+	 *
+	 */
+	struct ChunkPoint {
+		
+		double x;
+		double y;
+		double z;
+		uint32_t classification;
+		uint32_t padding;
+		
+	};
+	
+	/**
+	 * Footer of a chunked binary point file, located after the chunk index.
+	 *
+	 */
+	struct ChunkedFileFooter {
+		
+		uint64_t index_offset;
+		uint64_t n_chunks;
+		uint64_t n_points;
+		char magic[8];
+		
+	};
+	
 	/**
 	 * Input absolute filepath.
 	 *
@@ -131,6 +484,7 @@ private:
 	 *
 	 */
 	std::string o_filepath_trees_;
+	unsigned int compression_threads_;
 
 };
 
@@ -0,0 +1,173 @@
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <algorithm>
+#include "IngestStatistics.h"
+
+using namespace std;
+
+
+// Add the Points of a PointCollection
+void IngestStatistics::AddPoints(const PointCollection& point_collection)
+{
+	for (unsigned int j(0); j < point_collection.points_.size(); j++){
+		
+		const PointCollection::Point& point = point_collection.points_[j];
+		AddPoint(point.x, point.y, point.z, point.classification);
+		
+	}
+}
+
+
+// Add the statistics of another part of the point cloud
+void IngestStatistics::Merge(const IngestStatistics& statistics)
+{
+	for (unsigned int k(0); k <= N_CLASSES; k++){
+		
+		const ClassStatistics& other = statistics.classes_[k];
+		ClassStatistics& current = classes_[k];
+		
+		if (other.n_points == 0){
+			
+			continue;
+			
+		}
+		
+		if (current.n_points == 0){
+			
+			current.extent = other.extent;
+			
+		} else {
+			
+			current.extent.x_min = min(current.extent.x_min, other.extent.x_min);
+			current.extent.x_max = max(current.extent.x_max, other.extent.x_max);
+			current.extent.y_min = min(current.extent.y_min, other.extent.y_min);
+			current.extent.y_max = max(current.extent.y_max, other.extent.y_max);
+			current.extent.z_min = min(current.extent.z_min, other.extent.z_min);
+			current.extent.z_max = max(current.extent.z_max, other.extent.z_max);
+			
+		}
+		
+		current.n_points += other.n_points;
+		
+	}
+	
+	for (unsigned int k(0); k < N_HEIGHT_BINS; k++){
+		
+		height_histogram_[k] += statistics.height_histogram_[k];
+		
+	}
+	
+	for (auto it = statistics.density_cells_.begin(); it != statistics.density_cells_.end(); ++it){
+		
+		density_cells_[it->first] += it->second;
+		
+	}
+}
+
+
+// Get the total number of points
+uint64_t IngestStatistics::GetNumberOfPoints() const
+{
+	uint64_t n_points(0);
+	
+	for (unsigned int k(0); k <= N_CLASSES; k++){
+		
+		n_points += classes_[k].n_points;
+		
+	}
+	
+	return n_points;
+}
+
+
+// Get the number of points of the specified classifications
+uint64_t IngestStatistics::GetNumberOfPoints(const vector<unsigned int>& classes) const
+{
+	uint64_t n_points(0);
+	
+	for (unsigned int k(0); k < classes.size(); k++){
+		
+		if (classes[k] < N_CLASSES){
+			
+			n_points += classes_[classes[k]].n_points;
+			
+		}
+	}
+	
+	return n_points;
+}
+
+
+// Get the extent of the points of the specified classifications
+bool IngestStatistics::GetExtent(const vector<unsigned int>& classes, Extent& extent) const
+{
+	bool found(false);
+	
+	for (unsigned int k(0); k < classes.size(); k++){
+		
+		if (classes[k] >= N_CLASSES){
+			
+			return false;
+			
+		}
+		
+		const ClassStatistics& statistics = classes_[classes[k]];
+		
+		if (statistics.n_points == 0){
+			
+			continue;
+			
+		}
+		
+		if (not found){
+			
+			extent = statistics.extent;
+			found = true;
+			
+		} else {
+			
+			extent.x_min = min(extent.x_min, statistics.extent.x_min);
+			extent.x_max = max(extent.x_max, statistics.extent.x_max);
+			extent.y_min = min(extent.y_min, statistics.extent.y_min);
+			extent.y_max = max(extent.y_max, statistics.extent.y_max);
+			extent.z_min = min(extent.z_min, statistics.extent.z_min);
+			extent.z_max = max(extent.z_max, statistics.extent.z_max);
+			
+		}
+	}
+	
+	return found;
+}
+
+
+// Get the height histogram
+const vector<uint64_t>& IngestStatistics::GetHeightHistogram() const
+{
+	return height_histogram_;
+}
+
+
+// Get the density of the densest cell
+double IngestStatistics::GetPeakDensity() const
+{
+	uint32_t n_max(0);
+	
+	for (auto it = density_cells_.begin(); it != density_cells_.end(); ++it){
+		
+		n_max = max(n_max, it->second);
+		
+	}
+	
+	return double(n_max) / double(DENSITY_CELL_SIZE * DENSITY_CELL_SIZE);
+}
+
+
+// Constructor
+IngestStatistics::IngestStatistics()
+{
+	classes_.resize(N_CLASSES + 1, {0, {0.0, 0.0, 0.0, 0.0, 0.0, 0.0}});
+	height_histogram_.assign(N_HEIGHT_BINS, 0);
+	last_cell_key_ = 0;
+	last_cell_ = NULL;
+}
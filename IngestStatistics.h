@@ -0,0 +1,195 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class summarizes a point cloud while it is parsed: the number of points, the extent of each classification,
+ * a histogram of the heights and a coarse raster of the point density. The statistics of separately parsed chunks
+ * are merged, so that the preparation stages can size the grid, the reservations and the thread count of a run
+ * without another pass over the points.
+ *
+ */
+
+#ifndef INGESTSTATISTICS_H
+#define INGESTSTATISTICS_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "PointCollection.h"
+
+class IngestStatistics {
+
+public:
+	
+	/**
+	 * Extent of the points of one or more classifications.
+	 *
+	 */
+	struct Extent {
+		
+		double x_min;
+		double x_max;
+		double y_min;
+		double y_max;
+		double z_min;
+		double z_max;
+		
+	};
+	
+	/**
+	 * Number of classifications tracked separately. Larger classifications share a single entry.
+	 *
+	 */
+	static const unsigned int N_CLASSES = 256;
+	
+	/**
+	 * Number of height bins (one unit each, the last one also counts the points above it).
+	 *
+	 */
+	static const unsigned int N_HEIGHT_BINS = 128;
+	
+	/**
+	 * Side of the cells of the density raster (in coordinate units).
+	 *
+	 */
+	static const unsigned int DENSITY_CELL_SIZE = 10;
+	
+	/**
+	 * Adds a point to the statistics.
+	 *
+	 */
+	inline void AddPoint(double x, double y, double z, unsigned int classification)
+	{
+		ClassStatistics& statistics = classes_[std::min(classification, N_CLASSES)];
+		
+		if (statistics.n_points == 0){
+			
+			statistics.extent = {x, x, y, y, z, z};
+			
+		} else {
+			
+			statistics.extent.x_min = std::min(statistics.extent.x_min, x);
+			statistics.extent.x_max = std::max(statistics.extent.x_max, x);
+			statistics.extent.y_min = std::min(statistics.extent.y_min, y);
+			statistics.extent.y_max = std::max(statistics.extent.y_max, y);
+			statistics.extent.z_min = std::min(statistics.extent.z_min, z);
+			statistics.extent.z_max = std::max(statistics.extent.z_max, z);
+			
+		}
+		
+		statistics.n_points++;
+		height_histogram_[(z <= 0.0) ? 0 : std::min((unsigned int) z, N_HEIGHT_BINS - 1)]++;
+		
+		// Consecutive points usually fall in the same density cell
+		uint64_t key = DensityCellKey(x, y);
+		
+		if ((last_cell_ == NULL) or (key != last_cell_key_)){
+			
+			last_cell_ = &density_cells_[key];
+			last_cell_key_ = key;
+			
+		}
+		
+		(*last_cell_)++;
+	}
+	
+	/**
+	 * Adds all the Points of a PointCollection to the statistics.
+	 *
+	 */
+	void AddPoints(const PointCollection& point_collection);
+	
+	/**
+	 * Adds the statistics of another part of the same point cloud.
+	 *
+	 */
+	void Merge(const IngestStatistics& statistics);
+	
+	/**
+	 * Returns the total number of points.
+	 *
+	 */
+	uint64_t GetNumberOfPoints() const;
+	
+	/**
+	 * Returns the number of points of the specified classifications.
+	 *
+	 */
+	uint64_t GetNumberOfPoints(const std::vector<unsigned int>& classes) const;
+	
+	/**
+	 * Computes the Extent of the points of the specified classifications.
+	 *
+	 * @return Returns false if there is no such point, or if a classification is not tracked separately.
+	 */
+	bool GetExtent(const std::vector<unsigned int>& classes, Extent& extent) const;
+	
+	/**
+	 * Returns the number of points in each height bin.
+	 *
+	 */
+	const std::vector<uint64_t>& GetHeightHistogram() const;
+	
+	/**
+	 * Returns the density (in points per square unit) of the densest cell of the density raster.
+	 *
+	 */
+	double GetPeakDensity() const;
+	
+	IngestStatistics(); // Constructor
+	IngestStatistics(const IngestStatistics&) = delete; // The cached density cell is not copied
+	IngestStatistics& operator=(const IngestStatistics&) = delete;
+	~IngestStatistics(){}; // Destructor
+	
+private:
+	
+	/**
+	 * Statistics of a single classification.
+	 *
+	 */
+	struct ClassStatistics {
+		
+		uint64_t n_points;
+		Extent extent;
+		
+	};
+	
+	/**
+	 * Returns the key of the density cell containing a location.
+	 *
+	 */
+	static inline uint64_t DensityCellKey(double x, double y)
+	{
+		int64_t col = (int64_t) std::floor(x / DENSITY_CELL_SIZE);
+		int64_t row = (int64_t) std::floor(y / DENSITY_CELL_SIZE);
+		
+		return (uint64_t(uint32_t(col)) << 32) | uint64_t(uint32_t(row));
+	}
+	
+	std::vector<ClassStatistics> classes_; // N_CLASSES + 1 entries
+	std::vector<uint64_t> height_histogram_;
+	std::unordered_map<uint64_t, uint32_t> density_cells_; // Number of points in each non-empty density cell
+	uint64_t last_cell_key_;
+	uint32_t* last_cell_;
+	
+};
+
+#endif
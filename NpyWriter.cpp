@@ -0,0 +1,263 @@
+#include <fstream>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <cstdint>
+#include <zlib.h>
+#include "NpyWriter.h"
+
+using namespace std;
+
+
+// Append little endian values to a record
+static void Put16(string& record, uint16_t value)
+{
+	record.push_back(char(value & 0xFF));
+	record.push_back(char(value >> 8));
+}
+
+
+static void Put32(string& record, uint32_t value)
+{
+	Put16(record, uint16_t(value & 0xFFFF));
+	Put16(record, uint16_t(value >> 16));
+}
+
+
+static void Put64(string& record, uint64_t value)
+{
+	Put32(record, uint32_t(value & 0xFFFFFFFF));
+	Put32(record, uint32_t(value >> 32));
+}
+
+
+// Open the output directory or archive
+bool NpyWriter::Open(const string& path, bool archive)
+{
+	path_ = path;
+	archive_ = archive;
+	members_.clear();
+
+	if (archive_){
+
+		file_.open(path_, ios::binary | ios::trunc);
+		return file_.is_open();
+
+	}
+
+	error_code ec;
+	filesystem::create_directories(path_, ec);
+
+	return filesystem::is_directory(path_, ec);
+}
+
+
+// Build the header of an array
+string NpyWriter::Header(const string& descriptor, size_t n_rows, unsigned int n_cols)
+{
+	string shape = (n_cols == 1) ? "(" + to_string(n_rows) + ",)" : "(" + to_string(n_rows) + ", " + to_string(n_cols) + ")";
+	string dictionary = "{'descr': '" + descriptor + "', 'fortran_order': False, 'shape': " + shape + ", }";
+
+	// Magic string, version and header length take 10 bytes, the dictionary ends with a newline
+	size_t length = 10 + dictionary.size() + 1;
+	dictionary.append((length + 63) / 64 * 64 - length, ' ');
+	dictionary.push_back('\n');
+
+	string header("\x93NUMPY\x01\x00", 8);
+	Put16(header, uint16_t(dictionary.size()));
+
+	return header + dictionary;
+}
+
+
+// Start a file or an archive member
+bool NpyWriter::BeginArray(const string& name, uint64_t size)
+{
+	if (not archive_){
+
+		file_.open(path_ + "/" + name, ios::binary | ios::trunc);
+		return file_.is_open();
+
+	}
+
+	Member member = {name, (uint64_t) file_.tellp(), size, 0};
+	bool zip64 = (size >= 0xFFFFFFFF);
+	crc_ = crc32(0L, Z_NULL, 0);
+
+	// Local header, with the sizes in a ZIP64 extra field if they do not fit in 32 bits
+	string record;
+	Put32(record, 0x04034b50);
+	Put16(record, zip64 ? 45 : 20); // Version needed to extract
+	Put16(record, 0); // Flags
+	Put16(record, 0); // Stored
+	Put16(record, 0); // Time
+	Put16(record, 0x21); // Date (1980-01-01)
+	Put32(record, 0); // CRC-32, written by EndArray
+	Put32(record, zip64 ? 0xFFFFFFFF : uint32_t(size));
+	Put32(record, zip64 ? 0xFFFFFFFF : uint32_t(size));
+
+	string extra;
+
+	if (zip64){
+
+		Put16(extra, 0x0001);
+		Put16(extra, 16);
+		Put64(extra, size);
+		Put64(extra, size);
+
+	}
+
+	// Padding extra field so that the data starts on 64 bytes
+	size_t data_offset = member.offset + 30 + name.size() + extra.size() + 4;
+	size_t padding = (64 - data_offset % 64) % 64;
+	Put16(extra, 0xD935);
+	Put16(extra, uint16_t(padding));
+	extra.append(padding, '\0');
+
+	Put16(record, uint16_t(name.size()));
+	Put16(record, uint16_t(extra.size()));
+	record += name + extra;
+	file_.write(record.data(), record.size());
+	members_.push_back(member);
+
+	return file_.good();
+}
+
+
+// Write data to the current file or archive member
+void NpyWriter::WriteData(const char* data, size_t size)
+{
+	file_.write(data, size);
+
+	if (archive_){
+
+		for (size_t offset(0); offset < size; offset += 1 << 30){
+
+			crc_ = crc32(crc_, (const Bytef*) data + offset, (uInt) min<size_t>(size - offset, 1 << 30));
+
+		}
+	}
+}
+
+
+// Finish the current file or archive member
+bool NpyWriter::EndArray()
+{
+	if (not archive_){
+
+		file_.close();
+		return not file_.fail();
+
+	}
+
+	Member& member = members_.back();
+	member.crc = crc_;
+
+	string crc;
+	Put32(crc, member.crc);
+	streampos end = file_.tellp();
+	file_.seekp(member.offset + 14);
+	file_.write(crc.data(), crc.size());
+	file_.seekp(end);
+
+	return file_.good();
+}
+
+
+// Write the central directory of the archive
+bool NpyWriter::Close()
+{
+	if (not archive_){
+
+		return true;
+
+	}
+
+	uint64_t directory_offset = file_.tellp();
+	string directory;
+
+	for (size_t j(0); j < members_.size(); j++){
+
+		const Member& member = members_[j];
+		bool zip64_size = (member.size >= 0xFFFFFFFF);
+		bool zip64_offset = (member.offset >= 0xFFFFFFFF);
+		string extra;
+
+		if (zip64_size or zip64_offset){
+
+			Put16(extra, 0x0001);
+			Put16(extra, uint16_t((zip64_size ? 16 : 0) + (zip64_offset ? 8 : 0)));
+
+			if (zip64_size){
+
+				Put64(extra, member.size);
+				Put64(extra, member.size);
+
+			}
+
+			if (zip64_offset){
+
+				Put64(extra, member.offset);
+
+			}
+		}
+
+		Put32(directory, 0x02014b50);
+		Put16(directory, 45); // Version made by
+		Put16(directory, zip64_size ? 45 : 20); // Version needed to extract (as in the local header)
+		Put16(directory, 0);
+		Put16(directory, 0);
+		Put16(directory, 0);
+		Put16(directory, 0x21);
+		Put32(directory, member.crc);
+		Put32(directory, zip64_size ? 0xFFFFFFFF : uint32_t(member.size));
+		Put32(directory, zip64_size ? 0xFFFFFFFF : uint32_t(member.size));
+		Put16(directory, uint16_t(member.name.size()));
+		Put16(directory, uint16_t(extra.size()));
+		Put16(directory, 0); // Comment length
+		Put16(directory, 0); // Disk number
+		Put16(directory, 0); // Internal attributes
+		Put32(directory, 0); // External attributes
+		Put32(directory, zip64_offset ? 0xFFFFFFFF : uint32_t(member.offset));
+		directory += member.name + extra;
+
+	}
+
+	// End of central directory, preceded by the ZIP64 records if the directory is located above 4 GB
+	uint64_t end_offset = directory_offset + directory.size();
+	bool zip64 = (end_offset >= 0xFFFFFFFF) or (members_.size() >= 0xFFFF);
+
+	if (zip64){
+
+		Put32(directory, 0x06064b50);
+		Put64(directory, 44);
+		Put16(directory, 45);
+		Put16(directory, 45);
+		Put32(directory, 0);
+		Put32(directory, 0);
+		Put64(directory, members_.size());
+		Put64(directory, members_.size());
+		Put64(directory, end_offset - directory_offset);
+		Put64(directory, directory_offset);
+
+		Put32(directory, 0x07064b50);
+		Put32(directory, 0);
+		Put64(directory, end_offset);
+		Put32(directory, 1);
+
+	}
+
+	Put32(directory, 0x06054b50);
+	Put16(directory, 0);
+	Put16(directory, 0);
+	Put16(directory, zip64 ? 0xFFFF : uint16_t(members_.size()));
+	Put16(directory, zip64 ? 0xFFFF : uint16_t(members_.size()));
+	Put32(directory, zip64 ? 0xFFFFFFFF : uint32_t(end_offset - directory_offset));
+	Put32(directory, zip64 ? 0xFFFFFFFF : uint32_t(directory_offset));
+	Put16(directory, 0);
+
+	file_.write(directory.data(), directory.size());
+	file_.close();
+
+	return not file_.fail();
+}
@@ -0,0 +1,170 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class writes arrays in the NumPy .npy format (version 1.0, little endian, C order), either as separate files
+ * in a directory or bundled in an uncompressed .npz archive (a zip file with one stored .npy member per array, with
+ * ZIP64 records for members or offsets above 4 GB). The data of each array is aligned on 64 bytes in its file, so that
+ * it can be memory-mapped (numpy.load with mmap_mode for the .npy files). The values are gathered in a column buffer
+ * of fixed size which is written in bulk when it is full.
+ *
+ */
+
+#ifndef NPYWRITER_H
+#define NPYWRITER_H
+
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+class NpyWriter {
+
+public:
+
+	/**
+	 * Creates the output directory or archive.
+	 *
+	 * @param  path The directory (created if necessary) or the .npz file path.
+	 * @param  archive If true, the arrays are bundled in a .npz archive.
+	 * @return Returns false if the output could not be created.
+	 */
+	bool Open(const std::string& path, bool archive);
+
+	/**
+	 * Writes an array of n_rows x n_cols values (a one dimensional array if n_cols is 1).
+	 *
+	 * @param  name The name of the array (of the file or of the archive member, without the .npy extension).
+	 * @param  n_rows The number of rows.
+	 * @param  n_cols The number of columns.
+	 * @param  get A function returning the value at (row, col), of one of the supported types (double, uint32_t, uint16_t).
+	 * @return Returns false if the array could not be written.
+	 */
+	template <typename T, typename Getter>
+	bool WriteArray(const std::string& name, size_t n_rows, unsigned int n_cols, Getter get);
+
+	/**
+	 * Writes the directory of the archive and closes it.
+	 *
+	 * @return Returns false if the output could not be written.
+	 */
+	bool Close();
+
+	NpyWriter(){archive_ = false; crc_ = 0;}; // Constructor
+	~NpyWriter(){}; // Destructor
+
+	static const size_t block_size = 1 << 16; // Number of values of the column buffer
+
+private:
+
+	/**
+	 * Archive member (offset of its local header, size and CRC-32 of its data).
+	 *
+	 */
+	struct Member {
+
+		std::string name;
+		uint64_t offset;
+		uint64_t size;
+		uint32_t crc;
+
+	};
+
+	std::string path_;
+	bool archive_;
+	std::ofstream file_;
+	std::vector<Member> members_;
+	uint32_t crc_; // CRC-32 of the current archive member
+
+	/**
+	 * Returns the type descriptor of a value type.
+	 *
+	 */
+	static std::string Descriptor(double) {return "<f8";};
+	static std::string Descriptor(uint32_t) {return "<u4";};
+	static std::string Descriptor(uint16_t) {return "<u2";};
+
+	/**
+	 * Returns the .npy header of an array, padded so that the data starts on 64 bytes.
+	 *
+	 */
+	static std::string Header(const std::string& descriptor, size_t n_rows, unsigned int n_cols);
+
+	/**
+	 * Starts a .npy file, or an archive member with the specified data size.
+	 *
+	 */
+	bool BeginArray(const std::string& name, uint64_t size);
+
+	/**
+	 * Writes data to the current .npy file or archive member.
+	 *
+	 */
+	void WriteData(const char* data, size_t size);
+
+	/**
+	 * Finishes the current .npy file, or the current archive member (writes its CRC-32 in its local header).
+	 *
+	 */
+	bool EndArray();
+
+};
+
+
+// Write an array
+template <typename T, typename Getter>
+bool NpyWriter::WriteArray(const std::string& name, size_t n_rows, unsigned int n_cols, Getter get)
+{
+	std::string header = Header(Descriptor(T()), n_rows, n_cols);
+
+	if (not BeginArray(name + ".npy", header.size() + uint64_t(n_rows) * n_cols * sizeof(T))){
+
+		return false;
+
+	}
+
+	WriteData(header.data(), header.size());
+
+	std::vector<T> block;
+	block.reserve(std::min<size_t>(block_size, n_rows * n_cols));
+
+	for (size_t row(0); row < n_rows; row++){
+
+		for (unsigned int col(0); col < n_cols; col++){
+
+			block.push_back(get(row, col));
+
+		}
+
+		if (block.size() + n_cols > block_size){
+
+			WriteData((const char*) block.data(), block.size() * sizeof(T));
+			block.clear();
+
+		}
+	}
+
+	WriteData((const char*) block.data(), block.size() * sizeof(T));
+
+	return EndArray();
+}
+
+#endif
@@ -0,0 +1,335 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <deque>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "OctreeExporter.h"
+#include "PointCollection.h"
+
+using namespace std;
+
+
+// Keep the sampled points of a node and distribute the other points to its children
+void OctreeExporter::SplitNode(const vector<PointCollection::Point>& points, Node& node, vector<uint64_t>& occupied)
+{
+	if ((node.indexes.size() <= max_node_points) or (node.level >= max_level)){
+
+		return;
+
+	}
+
+	vector<uint32_t> kept;
+	vector<uint32_t> child_indexes[8];
+	double cell_scale = grid_size / node.size;
+	array<double, 3> center = {node.min[0] + node.size / 2, node.min[1] + node.size / 2, node.min[2] + node.size / 2};
+
+	// Cell of a point in the sampling grid of the node
+	auto cell = [&](const PointCollection::Point& point){
+
+		unsigned int c[3];
+		double coordinates[3] = {point.x, point.y, point.z};
+
+		for (unsigned int d(0); d < 3; d++){
+
+			double u = floor((coordinates[d] - node.min[d]) * cell_scale);
+			c[d] = (u < 0) ? 0 : ((u >= grid_size) ? grid_size - 1 : (unsigned int) u);
+
+		}
+
+		return (size_t(c[0]) * grid_size + c[1]) * grid_size + c[2];
+	};
+
+	// The first point of each cell stays in the node (the points are in height order, so the highest one)
+	for (unsigned int j(0); j < node.indexes.size(); j++){
+
+		const PointCollection::Point& point = points[node.indexes[j]];
+		size_t key = cell(point);
+
+		if (not ((occupied[key >> 6] >> (key & 63)) & 1)){
+
+			occupied[key >> 6] |= uint64_t(1) << (key & 63);
+			kept.push_back(node.indexes[j]);
+
+		} else {
+
+			unsigned int child = ((point.x >= center[0]) << 2) | ((point.y >= center[1]) << 1) | (point.z >= center[2]);
+			child_indexes[child].push_back(node.indexes[j]);
+
+		}
+	}
+
+	for (unsigned int j(0); j < kept.size(); j++){
+
+		size_t key = cell(points[kept[j]]);
+		occupied[key >> 6] = 0;
+
+	}
+
+	node.indexes.swap(kept);
+
+	for (unsigned int child(0); child < 8; child++){
+
+		if (not child_indexes[child].empty()){
+
+			node.children[child].reset(new Node());
+			Node& child_node = *node.children[child];
+			child_node.level = node.level + 1;
+			child_node.size = node.size / 2;
+			child_node.min = {(child & 4) ? center[0] : node.min[0], (child & 2) ? center[1] : node.min[1], (child & 1) ? center[2] : node.min[2]};
+			child_node.indexes.swap(child_indexes[child]);
+
+		}
+	}
+}
+
+
+// Build the subtree of a node
+void OctreeExporter::BuildSubtree(const vector<PointCollection::Point>& points, Node& node, vector<uint64_t>& occupied)
+{
+	SplitNode(points, node, occupied);
+
+	for (unsigned int child(0); child < 8; child++){
+
+		if (node.children[child]){
+
+			BuildSubtree(points, *node.children[child], occupied);
+
+		}
+	}
+}
+
+
+// Copy a value to a little endian record
+template <typename T>
+static char* Put(char* record, T value)
+{
+	memcpy(record, &value, sizeof(T));
+	return record + sizeof(T);
+}
+
+
+// Write the octree of a segmented PointCollection
+bool OctreeExporter::Write(const PointCollection& point_collection, const vector<array<unsigned int, 3>>& colormap, const string& directory, unsigned int n_threads)
+{
+	const vector<PointCollection::Point>& points = point_collection.points_;
+	const double scale = 0.001;
+	n_threads = max(1u, n_threads);
+
+	// Bounding box of the points, and bounding cube of the root
+	array<double, 3> box_min = {0.0, 0.0, 0.0}, box_max = {0.0, 0.0, 0.0};
+
+	for (size_t j(0); j < points.size(); j++){
+
+		array<double, 3> coordinates = {points[j].x, points[j].y, points[j].z};
+
+		for (unsigned int d(0); d < 3; d++){
+
+			box_min[d] = (j == 0) ? coordinates[d] : min(box_min[d], coordinates[d]);
+			box_max[d] = (j == 0) ? coordinates[d] : max(box_max[d], coordinates[d]);
+
+		}
+	}
+
+	Node root;
+	root.level = 0;
+	root.min = box_min;
+	root.size = max(max(box_max[0] - box_min[0], box_max[1] - box_min[1]), box_max[2] - box_min[2]);
+	root.size = (root.size > 0) ? root.size : 1.0;
+	root.indexes.resize(points.size());
+
+	for (uint32_t j(0); j < root.indexes.size(); j++){
+
+		root.indexes[j] = j;
+
+	}
+
+	// Split the first levels until there are enough subtrees for the threads
+	vector<uint64_t> occupied(size_t(grid_size) * grid_size * grid_size / 64, 0);
+	deque<Node*> subtrees(1, &root);
+
+	while ((not subtrees.empty()) and (subtrees.size() < 4 * n_threads)){
+
+		Node& node = *subtrees.front();
+		subtrees.pop_front();
+		SplitNode(points, node, occupied);
+
+		for (unsigned int child(0); child < 8; child++){
+
+			if (node.children[child]){
+
+				subtrees.push_back(node.children[child].get());
+
+			}
+		}
+	}
+
+	// Build the subtrees concurrently, the largest first
+	vector<Node*> tasks(subtrees.begin(), subtrees.end());
+	sort(tasks.begin(), tasks.end(), [](const Node* a, const Node* b){ return a->indexes.size() > b->indexes.size(); });
+	atomic<unsigned int> next_task(0);
+
+	auto run = [&](vector<uint64_t>& thread_occupied){
+
+		unsigned int task_idx;
+
+		while ((task_idx = next_task++) < tasks.size()){
+
+			BuildSubtree(points, *tasks[task_idx], thread_occupied);
+
+		}
+	};
+
+	n_threads = min(n_threads, max(1u, (unsigned int) tasks.size()));
+	vector<thread> threads;
+
+	for (unsigned int t(1); t < n_threads; t++){
+
+		threads.push_back(thread([&](){
+
+			vector<uint64_t> thread_occupied(occupied.size(), 0);
+			run(thread_occupied);
+
+		}));
+
+	}
+
+	run(occupied);
+
+	for (unsigned int t(0); t < threads.size(); t++){
+
+		threads[t].join();
+
+	}
+
+	// Nodes in breadth-first order, the children of a node in increasing child index
+	vector<const Node*> nodes(1, &root);
+	unsigned int depth(0);
+
+	for (size_t j(0); j < nodes.size(); j++){
+
+		depth = max(depth, nodes[j]->level);
+
+		for (unsigned int child(0); child < 8; child++){
+
+			if (nodes[j]->children[child]){
+
+				nodes.push_back(nodes[j]->children[child].get());
+
+			}
+		}
+	}
+
+	error_code ec;
+	filesystem::create_directories(directory, ec);
+
+	// Points of the nodes
+	ofstream octree_file(directory + "/octree.bin", ios::binary);
+	ofstream hierarchy_file(directory + "/hierarchy.bin", ios::binary);
+
+	if (not (octree_file and hierarchy_file)){
+
+		return false;
+
+	}
+
+	vector<char> buffer;
+	array<unsigned int, 3> rgb_min = {65535, 65535, 65535}, rgb_max = {0, 0, 0};
+	uint32_t tree_idx_min(UINT32_MAX), tree_idx_max(0);
+	int64_t byte_offset(0);
+
+	for (size_t j(0); j < nodes.size(); j++){
+
+		const Node& node = *nodes[j];
+		buffer.resize(node.indexes.size() * bytes_per_point);
+		char* record = buffer.data();
+
+		for (size_t k(0); k < node.indexes.size(); k++){
+
+			const PointCollection::Point& point = points[node.indexes[k]];
+			array<unsigned int, 3> rgb_color = (point.tree_idx == PointCollection::unassigned_tree) ? array<unsigned int, 3>{0, 0, 0} : colormap[point.tree_idx % colormap.size()];
+			record = Put<int32_t>(record, (int32_t) llround((point.x - box_min[0]) / scale));
+			record = Put<int32_t>(record, (int32_t) llround((point.y - box_min[1]) / scale));
+			record = Put<int32_t>(record, (int32_t) llround((point.z - box_min[2]) / scale));
+
+			for (unsigned int c(0); c < 3; c++){
+
+				record = Put<uint16_t>(record, (uint16_t) rgb_color[c]);
+				rgb_min[c] = min(rgb_min[c], rgb_color[c]);
+				rgb_max[c] = max(rgb_max[c], rgb_color[c]);
+
+			}
+
+			record = Put<uint32_t>(record, point.tree_idx);
+			tree_idx_min = min(tree_idx_min, point.tree_idx);
+			tree_idx_max = max(tree_idx_max, point.tree_idx);
+
+		}
+
+		octree_file.write(buffer.data(), buffer.size());
+
+		// Node record: type (0 = inner node, 1 = leaf), child mask, number of points, byte offset and byte size
+		uint8_t child_mask(0);
+
+		for (unsigned int child(0); child < 8; child++){
+
+			child_mask |= (node.children[child] ? 1 : 0) << child;
+
+		}
+
+		char node_record[22];
+		char* field = Put<uint8_t>(node_record, (child_mask == 0) ? 1 : 0);
+		field = Put<uint8_t>(field, child_mask);
+		field = Put<uint32_t>(field, (uint32_t) node.indexes.size());
+		field = Put<int64_t>(field, byte_offset);
+		Put<int64_t>(field, (int64_t) buffer.size());
+		hierarchy_file.write(node_record, sizeof(node_record));
+		byte_offset += buffer.size();
+
+	}
+
+	octree_file.close();
+	hierarchy_file.close();
+
+	if (points.empty()){
+
+		rgb_min = {0, 0, 0};
+		tree_idx_min = 0;
+
+	}
+
+	// Description of the octree
+	ofstream metadata_file(directory + "/metadata.json");
+	string name = filesystem::path(directory).filename().string();
+	metadata_file << setprecision(15);
+	metadata_file << "{" << endl;
+	metadata_file << "\t\"version\": \"2.0\"," << endl;
+	metadata_file << "\t\"name\": \"" << name << "\"," << endl;
+	metadata_file << "\t\"description\": \"\"," << endl;
+	metadata_file << "\t\"points\": " << points.size() << "," << endl;
+	metadata_file << "\t\"projection\": \"\"," << endl;
+	metadata_file << "\t\"hierarchy\": {\"firstChunkSize\": " << nodes.size() * 22 << ", \"stepSize\": 4, \"depth\": " << depth << "}," << endl;
+	metadata_file << "\t\"offset\": [" << box_min[0] << ", " << box_min[1] << ", " << box_min[2] << "]," << endl;
+	metadata_file << "\t\"scale\": [" << scale << ", " << scale << ", " << scale << "]," << endl;
+	metadata_file << "\t\"spacing\": " << root.size / grid_size << "," << endl;
+	metadata_file << "\t\"boundingBox\": {\"min\": [" << box_min[0] << ", " << box_min[1] << ", " << box_min[2] << "], \"max\": [" << box_min[0] + root.size << ", " << box_min[1] + root.size << ", " << box_min[2] + root.size << "]}," << endl;
+	metadata_file << "\t\"encoding\": \"DEFAULT\"," << endl;
+	metadata_file << "\t\"attributes\": [" << endl;
+	metadata_file << "\t\t{\"name\": \"position\", \"description\": \"\", \"size\": 12, \"numElements\": 3, \"elementSize\": 4, \"type\": \"int32\", \"min\": [" << box_min[0] << ", " << box_min[1] << ", " << box_min[2] << "], \"max\": [" << box_max[0] << ", " << box_max[1] << ", " << box_max[2] << "]}," << endl;
+	metadata_file << "\t\t{\"name\": \"rgb\", \"description\": \"\", \"size\": 6, \"numElements\": 3, \"elementSize\": 2, \"type\": \"uint16\", \"min\": [" << rgb_min[0] << ", " << rgb_min[1] << ", " << rgb_min[2] << "], \"max\": [" << rgb_max[0] << ", " << rgb_max[1] << ", " << rgb_max[2] << "]}," << endl;
+	metadata_file << "\t\t{\"name\": \"tree_idx\", \"description\": \"Tree identifier\", \"size\": 4, \"numElements\": 1, \"elementSize\": 4, \"type\": \"uint32\", \"min\": [" << tree_idx_min << "], \"max\": [" << tree_idx_max << "]}" << endl;
+	metadata_file << "\t]" << endl;
+	metadata_file << "}" << endl;
+	metadata_file.close();
+
+	return not (octree_file.fail() or hierarchy_file.fail() or metadata_file.fail());
+}
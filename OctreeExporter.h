@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class writes a segmented PointCollection as a level of detail octree in the Potree 2.0 format, so that viewers
+ * only load the nodes of the visible region at the required density. Each point is stored in a single node: an inner
+ * node keeps the first point (i.e. the highest) of each cell of a 128 x 128 x 128 grid over its cube, and passes the
+ * other points to its children. The points of the nodes are stored in breadth-first order in "octree.bin" (position as
+ * scaled integers, RGB color and tree identifier), the nodes in "hierarchy.bin" and the description of the attributes
+ * and of the bounding cube in "metadata.json". The subtrees below the first levels are built concurrently.
+ *
+ */
+
+#ifndef OCTREEEXPORTER_H
+#define OCTREEEXPORTER_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "PointCollection.h"
+
+class OctreeExporter {
+
+public:
+
+	/**
+	 * Writes the octree of a segmented PointCollection.
+	 *
+	 * @param  point_collection A reference to the segmented PointCollection.
+	 * @param  colormap The colormap of the trees (the color of a point is the color of its tree_idx modulo the size of the colormap).
+	 * @param  directory The output directory, created if necessary.
+	 * @param  n_threads The number of threads building the subtrees.
+	 * @return Returns true if the files could be written.
+	 */
+	static bool Write(const PointCollection& point_collection, const std::vector<std::array<unsigned int, 3>>& colormap, const std::string& directory, unsigned int n_threads);
+
+	static const unsigned int grid_size = 128; // Number of cells along the side of the sampling grid of a node
+	static const unsigned int max_node_points = 20000; // Number of points above which a node is subdivided
+	static const unsigned int max_level = 24; // Level below which nodes are not subdivided (e.g. for duplicate points)
+	static const unsigned int bytes_per_point = 22; // Size of a point record in octree.bin
+
+private:
+
+	/**
+	 * Node of the octree, with the indexes of the Points it stores.
+	 *
+	 */
+	struct Node {
+
+		unsigned int level;
+		std::array<double, 3> min; // Corner of the cube of the node
+		double size; // Side of the cube of the node
+		std::vector<uint32_t> indexes;
+		std::unique_ptr<Node> children[8]; // Child i covers the upper half along x if (i & 4), along y if (i & 2), along z if (i & 1)
+
+	};
+
+	/**
+	 * Keeps the sampled Points of a node (or all of them if it is not subdivided) and distributes the other Points to its
+	 * children.
+	 *
+	 * @param  points The Points of the PointCollection.
+	 * @param  node A reference to the Node, whose indexes are replaced by the indexes of the Points it stores.
+	 * @param  occupied A reference to a bitmap of the cells of the sampling grid, all cleared (and left cleared).
+	 */
+	static void SplitNode(const std::vector<PointCollection::Point>& points, Node& node, std::vector<uint64_t>& occupied);
+
+	/**
+	 * Builds the subtree of a node recursively.
+	 *
+	 */
+	static void BuildSubtree(const std::vector<PointCollection::Point>& points, Node& node, std::vector<uint64_t>& occupied);
+
+};
+
+#endif
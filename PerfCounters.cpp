@@ -0,0 +1,400 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "PerfCounters.h"
+
+using namespace std;
+
+
+atomic<bool> PerfCounters::enabled_(false);
+
+// Global statistics, updated under the mutex
+static mutex perf_mutex;
+static vector<PerfCounters::Counts> function_totals(PerfCounters::N_FUNCTIONS, PerfCounters::Counts());
+static vector<uint64_t> function_calls(PerfCounters::N_FUNCTIONS, 0);
+static vector<uint64_t> function_measured(PerfCounters::N_FUNCTIONS, 0);
+
+// Measure one call in a period (the functions called most often have the longest period)
+static const uint64_t sampling_periods[PerfCounters::N_FUNCTIONS] = {16, 1, 256};
+static const char* function_names[PerfCounters::N_FUNCTIONS] = {"ExtractPointsInBuffer", "ClassifySample", "FindMinDistance"};
+static const char* event_names[PerfCounters::N_EVENTS] = {"cycles", "instructions", "LLC misses", "branch misses"};
+
+
+// Totals of each stage, in order of first appearance
+static vector<string> stage_names;
+static vector<PerfCounters::Counts> stage_totals;
+static vector<unsigned int> stage_runs;
+
+
+// Enable the collection
+bool PerfCounters::Enable()
+{
+	enabled_ = true;
+
+	if (not GetThreadCounters().available){
+
+		enabled_ = false;
+		cerr << "Warning: hardware performance counters are not available. Skipping collection." << endl;
+
+	}
+
+	return enabled_;
+}
+
+
+// Open the counters of the calling thread on first use
+PerfCounters::ThreadCounters& PerfCounters::GetThreadCounters()
+{
+	thread_local ThreadCounters thread_counters;
+
+	if (not thread_counters.opened){
+
+		thread_counters.opened = true;
+		thread_counters.available = false;
+
+		#ifdef __linux__
+
+			const uint32_t types[N_EVENTS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+			const uint64_t configs[N_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+			bool available(true);
+
+			for (unsigned int j(0); available and (j < N_EVENTS); j++){
+
+				// Count the calling thread only, in user space
+				struct perf_event_attr attr;
+				memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = types[j];
+				attr.config = configs[j];
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+
+				thread_counters.fds[j] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+				available = (thread_counters.fds[j] >= 0);
+
+			}
+
+			thread_counters.available = available;
+
+		#endif
+
+	}
+
+	return thread_counters;
+}
+
+
+// Read the counters of a thread
+bool PerfCounters::ReadCounters(ThreadCounters& thread_counters, Counts& counts)
+{
+	if (not thread_counters.available){
+
+		return false;
+
+	}
+
+	#ifdef __linux__
+
+		for (unsigned int j(0); j < N_EVENTS; j++){
+
+			if (read(thread_counters.fds[j], &counts.values[j], sizeof(uint64_t)) != sizeof(uint64_t)){
+
+				return false;
+
+			}
+		}
+
+		return true;
+
+	#else
+
+		return false;
+
+	#endif
+}
+
+
+// Read the counters of a child thread when it starts
+void PerfCounters::StartChildThread(Counts& start)
+{
+	memset(&start, 0, sizeof(start));
+
+	if (enabled_){
+
+		ReadCounters(GetThreadCounters(), start);
+
+	}
+}
+
+
+// Add the counts of a child thread to the counts of its parent
+void PerfCounters::StopChildThread(ThreadCounters& parent, const Counts& start)
+{
+	ThreadCounters& thread_counters = GetThreadCounters();
+	Counts stop;
+
+	if (enabled_ and ReadCounters(thread_counters, stop)){
+
+		for (unsigned int j(0); j < N_EVENTS; j++){
+
+			parent.child_values[j] += stop.values[j] - start.values[j];
+
+		}
+	}
+
+	MergeFunctions(thread_counters);
+}
+
+
+// Read the counters at the start of a stage
+void PerfCounters::StartStage(Counts& start)
+{
+	memset(&start, 0, sizeof(start));
+
+	if (AllocationTracker::IsEnabled()){
+
+		start.allocations = AllocationTracker::GetTotals();
+
+	}
+
+	if (enabled_){
+
+		ThreadCounters& thread_counters = GetThreadCounters();
+
+		if (ReadCounters(thread_counters, start)){
+
+			for (unsigned int j(0); j < N_EVENTS; j++){
+
+				start.values[j] += thread_counters.child_values[j];
+
+			}
+		}
+	}
+}
+
+
+// Add the counts since the start of a stage to the totals of the stage
+void PerfCounters::StopStage(const string& name, const Counts& start)
+{
+	AllocationTracker::AddStage(name, start.allocations);
+
+	if (not enabled_){
+
+		return;
+
+	}
+
+	ThreadCounters& thread_counters = GetThreadCounters();
+	Counts stop;
+
+	if (not ReadCounters(thread_counters, stop)){
+
+		return;
+
+	}
+
+	for (unsigned int j(0); j < N_EVENTS; j++){
+
+		stop.values[j] += thread_counters.child_values[j];
+
+	}
+
+	MergeFunctions(thread_counters);
+
+	lock_guard<mutex> lock(perf_mutex);
+	unsigned int stage_idx(0);
+
+	while ((stage_idx < stage_names.size()) and (stage_names[stage_idx] != name)){
+
+		stage_idx++;
+
+	}
+
+	if (stage_idx == stage_names.size()){
+
+		stage_names.push_back(name);
+		stage_totals.push_back(Counts());
+		stage_runs.push_back(0);
+
+	}
+
+	for (unsigned int j(0); j < N_EVENTS; j++){
+
+		stage_totals[stage_idx].values[j] += stop.values[j] - start.values[j];
+
+	}
+
+	stage_runs[stage_idx]++;
+}
+
+
+// Count a call of a function and start its measurement if it is sampled
+bool PerfCounters::SampleFunction(Function function, Counts& start)
+{
+	ThreadCounters& thread_counters = GetThreadCounters();
+
+	if ((thread_counters.n_calls[function]++ % sampling_periods[function]) != 0){
+
+		return false;
+
+	}
+
+	return ReadCounters(thread_counters, start);
+}
+
+
+// Add the counts of a measured call to the totals of the function
+void PerfCounters::StopFunction(Function function, const Counts& start)
+{
+	ThreadCounters& thread_counters = GetThreadCounters();
+	Counts stop;
+
+	if (ReadCounters(thread_counters, stop)){
+
+		for (unsigned int j(0); j < N_EVENTS; j++){
+
+			thread_counters.function_totals[function].values[j] += stop.values[j] - start.values[j];
+
+		}
+
+		thread_counters.n_measured[function]++;
+
+	}
+}
+
+
+// Add the function statistics of a thread to the global statistics
+void PerfCounters::MergeFunctions(ThreadCounters& thread_counters)
+{
+	lock_guard<mutex> lock(perf_mutex);
+
+	for (unsigned int f(0); f < N_FUNCTIONS; f++){
+
+		for (unsigned int j(0); j < N_EVENTS; j++){
+
+			function_totals[f].values[j] += thread_counters.function_totals[f].values[j];
+
+		}
+
+		function_calls[f] += thread_counters.n_calls[f];
+		function_measured[f] += thread_counters.n_measured[f];
+
+	}
+
+	memset(thread_counters.function_totals, 0, sizeof(thread_counters.function_totals));
+	memset(thread_counters.n_calls, 0, sizeof(thread_counters.n_calls));
+	memset(thread_counters.n_measured, 0, sizeof(thread_counters.n_measured));
+}
+
+
+// Print a row of counters
+static void PrintCounts(ostream& os, const string& name, const PerfCounters::Counts& counts, double scaling)
+{
+	os << left << setw(24) << name << right;
+
+	for (unsigned int j(0); j < PerfCounters::N_EVENTS; j++){
+
+		os << setw(16) << (uint64_t) (counts.values[j] * scaling);
+
+	}
+
+	double ipc = (counts.values[PerfCounters::CYCLES] > 0) ? double(counts.values[PerfCounters::INSTRUCTIONS]) / counts.values[PerfCounters::CYCLES] : 0.0;
+	os << setw(8) << fixed << setprecision(2) << ipc << endl;
+}
+
+
+// Print the counters of each stage and function
+void PerfCounters::Report(ostream& os)
+{
+	if (not enabled_){
+
+		return;
+
+	}
+
+	MergeFunctions(GetThreadCounters());
+
+	lock_guard<mutex> lock(perf_mutex);
+
+	os << "****************************************" << endl;
+	os << left << setw(24) << "Stage" << right;
+
+	for (unsigned int j(0); j < N_EVENTS; j++){
+
+		os << setw(16) << event_names[j];
+
+	}
+
+	os << setw(8) << "IPC" << endl;
+
+	for (unsigned int j(0); j < stage_names.size(); j++){
+
+		PrintCounts(os, stage_names[j], stage_totals[j], 1.0);
+
+	}
+
+	os << "Functions (one call in a period is measured, totals are extrapolated):" << endl;
+
+	for (unsigned int f(0); f < N_FUNCTIONS; f++){
+
+		if (function_measured[f] > 0){
+
+			PrintCounts(os, function_names[f], function_totals[f], double(function_calls[f]) / function_measured[f]);
+
+		}
+	}
+}
+
+
+// Constructor
+PerfCounters::ThreadCounters::ThreadCounters()
+{
+	opened = false;
+	available = false;
+	memset(fds, -1, sizeof(fds));
+
+	for (unsigned int j(0); j < N_EVENTS; j++){
+
+		child_values[j] = 0;
+
+	}
+
+	memset(function_totals, 0, sizeof(function_totals));
+	memset(n_calls, 0, sizeof(n_calls));
+	memset(n_measured, 0, sizeof(n_measured));
+
+}
+
+
+// Destructor
+PerfCounters::ThreadCounters::~ThreadCounters()
+{
+	if (available){
+
+		MergeFunctions(*this);
+
+	}
+
+	#ifdef __linux__
+
+		for (unsigned int j(0); j < N_EVENTS; j++){
+
+			if (fds[j] >= 0){
+
+				close(fds[j]);
+
+			}
+		}
+
+	#endif
+
+}
@@ -0,0 +1,189 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class collects hardware performance counters (cycles, instructions, last level cache misses and branch
+ * misses) with the Linux perf_event_open interface, for each processing stage and for the innermost functions
+ * of the segmentation.
+ *
+ * Each thread opens its own counters when it first uses them. Short-lived threads created within a stage (e.g. the
+ * threads of the parallel segmentation) add their counts to the thread which created them before they exit. The
+ * innermost functions are called millions of times, so only one call in a given period is measured and the
+ * totals are extrapolated. Collection is opt-in: when the counters are not available (unsupported platform,
+ * virtual machine, perf_event_paranoid setting), a warning is printed and nothing is collected. The stages also
+ * collect the heap allocations counted by AllocationTracker, when it is enabled.
+ *
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include "AllocationTracker.h"
+
+class PerfCounters {
+
+public:
+
+	/**
+	 * Counted events.
+	 *
+	 */
+	enum Event {CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, N_EVENTS};
+
+	/**
+	 * Functions with a separate breakdown.
+	 *
+	 */
+	enum Function {EXTRACT_POINTS_IN_BUFFER, CLASSIFY_SAMPLE, FIND_MIN_DISTANCE, N_FUNCTIONS};
+
+	/**
+	 * Counter values of a thread.
+	 *
+	 */
+	struct Counts {
+
+		uint64_t values[N_EVENTS];
+		AllocationTracker::Counts allocations; // Heap allocations of all the threads (stages only, when tracked)
+
+	};
+
+	/**
+	 * Enables the collection if the counters can be opened on the calling thread. Otherwise prints a warning and leaves
+	 * the collection disabled.
+	 *
+	 * @return Returns true if the collection is enabled.
+	 */
+	static bool Enable();
+
+	static bool IsEnabled() { return enabled_; };
+
+	/**
+	 * Counters and function statistics of a thread.
+	 *
+	 */
+	struct ThreadCounters {
+
+		bool opened;
+		bool available;
+		int fds[N_EVENTS];
+		std::atomic<uint64_t> child_values[N_EVENTS]; // Counts added by the child threads
+		Counts function_totals[N_FUNCTIONS];
+		uint64_t n_calls[N_FUNCTIONS];
+		uint64_t n_measured[N_FUNCTIONS];
+
+		ThreadCounters(); // Constructor
+		~ThreadCounters(); // Destructor (merges the function statistics)
+
+	};
+
+	/**
+	 * Returns the counters of the calling thread, opened on first use.
+	 *
+	 */
+	static ThreadCounters& GetThreadCounters();
+
+	/**
+	 * Reads the counters of a thread created within a stage, when it starts.
+	 *
+	 * @param  start A reference to the Counts where the current values will be contained.
+	 */
+	static void StartChildThread(Counts& start);
+
+	/**
+	 * Adds the counts of a thread created within a stage to the counts of the thread which created it. Must be called by
+	 * the child thread before it exits.
+	 *
+	 * @param  parent A reference to the ThreadCounters of the thread which created the calling thread.
+	 * @param  start The Counts read by StartChildThread.
+	 */
+	static void StopChildThread(ThreadCounters& parent, const Counts& start);
+
+	/**
+	 * Reads the counters of the calling thread (including the counts of its child threads) at the start of a stage.
+	 *
+	 * @param  start A reference to the Counts where the current values will be contained.
+	 */
+	static void StartStage(Counts& start);
+
+	/**
+	 * Adds the counts since the start of a stage to the totals of the stage (stages with the same name are summed).
+	 *
+	 * @param  name The name of the stage.
+	 * @param  start The Counts read by StartStage.
+	 */
+	static void StopStage(const std::string& name, const Counts& start);
+
+	/**
+	 * Starts the measurement of a call of a function, if the call is sampled.
+	 *
+	 * @param  function The measured Function.
+	 * @param  start A reference to the Counts where the current values will be contained.
+	 * @return Returns true if the call is measured, in which case StopFunction must be called at its end.
+	 */
+	static inline bool StartFunction(Function function, Counts& start)
+	{
+		return enabled_ and SampleFunction(function, start);
+	};
+
+	/**
+	 * Adds the counts of a measured call to the totals of the function.
+	 *
+	 * @param  function The measured Function.
+	 * @param  start The Counts read by StartFunction.
+	 */
+	static void StopFunction(Function function, const Counts& start);
+
+	/**
+	 * Prints the counters of each stage and the extrapolated counters of each function.
+	 *
+	 * @param  os The output stream.
+	 */
+	static void Report(std::ostream& os);
+
+private:
+
+	/**
+	 * Reads the counters of a thread.
+	 *
+	 * @return Returns false if the counters are not available.
+	 */
+	static bool ReadCounters(ThreadCounters& thread_counters, Counts& counts);
+
+	/**
+	 * Counts a call of a function and starts its measurement if it is sampled.
+	 *
+	 */
+	static bool SampleFunction(Function function, Counts& start);
+
+	/**
+	 * Adds the function statistics of a thread to the global statistics and resets them.
+	 *
+	 */
+	static void MergeFunctions(ThreadCounters& thread_counters);
+
+	static std::atomic<bool> enabled_;
+
+};
+
+#endif
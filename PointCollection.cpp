@@ -2,9 +2,16 @@
 #include <vector>
 #include <array>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
 #include "PointCollection.h"
 #include "CircularBuffer.h"
 #include "CircularBufferCollection.h"
+#include "SparseTable2D.h"
+#include "PerfCounters.h"
 
 using namespace std;
 
@@ -22,10 +29,12 @@ unsigned int PointCollection::SubscriptToIndex(unsigned int ncols, unsigned int
 }
 
 
-// Sort PointCollection by z 
+// Sort PointCollection by z (points of equal height are ordered by x and y, so that the order does not depend on the input order)
 void PointCollection::SortByZ()
 {
-	sort(points_.begin(), points_.end(), [](Point a, Point b) { return a.z > b.z;  });
+	sort(points_.begin(), points_.end(), [](const Point& a, const Point& b) { return (a.z > b.z) or ((a.z == b.z) and ((a.x < b.x) or ((a.x == b.x) and (a.y < b.y)))); });
+	height_order_.clear();
+	height_rank_.clear();
 }
 
 
@@ -36,7 +45,15 @@ void PointCollection::SetRGBColors(vector<array<unsigned int, 3>> colormap)
 	
 	for (unsigned int j(0); j < points_.size(); j++){
 		
-		points_[j].rgb_color = colormap[points_[j].tree_idx % ncolors];	
+		if (points_[j].tree_idx == unassigned_tree){
+			
+			points_[j].rgb_color = {0, 0, 0};
+			
+		} else {
+			
+			points_[j].rgb_color = colormap[points_[j].tree_idx % ncolors];
+			
+		}
 
 	}	
 	
@@ -45,8 +62,17 @@ void PointCollection::SetRGBColors(vector<array<unsigned int, 3>> colormap)
 
 // Extract and copy a subset from a vector of Points based on the classification attribute
 PointCollection PointCollection::FilterPointsByClass(vector<unsigned int>& keep_classes)
+{
+	return FilterPointsByClass(keep_classes, 0);
+}
+
+
+// Extract and copy a subset from a vector of Points based on the classification attribute, with reserved memory
+PointCollection PointCollection::FilterPointsByClass(vector<unsigned int>& keep_classes, size_t n_reserved)
 {
 	PointCollection point_collection_subset;
+	point_collection_subset.points_.reserve(n_reserved);
+	
 	for (unsigned int j(0); j < points_.size(); j++){
 		for (unsigned int k(0); k < keep_classes.size(); k++){
 			if (points_[j].classification == keep_classes[k]){
@@ -61,6 +87,144 @@ PointCollection PointCollection::FilterPointsByClass(vector<unsigned int>& keep_
 }
 
 
+// Keep the highest point of each voxel
+PointCollection PointCollection::ThinByVoxel(double voxel_size)
+{
+	PointCollection thinned;
+	thinned.coordinate_scaling_ = coordinate_scaling_;
+	
+	if (points_.empty()){
+		
+		return thinned;
+		
+	}
+	
+	if (not bounding_box_.availability){
+		
+		ComputeBoundingBox();
+		
+	}
+	
+	// Voxel keys pack 21 bits per axis, horizontally relative to the bounding box and vertically relative to z = 0
+	const int64_t max_index = (1 << 21) - 1;
+	unordered_set<uint64_t> voxels;
+	voxels.reserve(points_.size() / 4);
+	
+	for (unsigned int j(0); j < points_.size(); j++){
+		
+		int64_t ix = min(max_index, (int64_t) floor((points_[j].x - bounding_box_.x_min) / voxel_size));
+		int64_t iy = min(max_index, (int64_t) floor((points_[j].y - bounding_box_.y_min) / voxel_size));
+		int64_t iz = min(max_index, max((int64_t) 0, (int64_t) floor(points_[j].z / voxel_size) + (1 << 20)));
+		uint64_t key = (uint64_t(ix) << 42) | (uint64_t(iy) << 21) | uint64_t(iz);
+		
+		// Points are sorted by height, so the first point of a voxel is its highest
+		if (voxels.insert(key).second){
+			
+			thinned.points_.push_back(points_[j]);
+			
+		}
+	}
+	
+	return thinned;
+}
+
+
+// Copy the tree indexes of the nearest segmented points
+void PointCollection::CopyTreeIndexesFromNearest(PointCollection& segmented, unsigned int n_threads)
+{
+	const vector<Point>& sources = segmented.points_;
+	double scaling = double(segmented.coordinate_scaling_);
+	int n_cols = segmented.n_cols_;
+	int n_rows = segmented.n_rows_;
+	
+	auto run = [&](unsigned int begin, unsigned int end){
+		
+		for (unsigned int j(begin); j < end; j++){
+			
+			Point& point = points_[j];
+			int col_0 = min(n_cols - 1, max(0, (int) round((point.x - segmented.x_origin_) * scaling)));
+			int row_0 = min(n_rows - 1, max(0, (int) round((point.y - segmented.y_origin_) * scaling)));
+			double min_distance = HUGE_VAL;
+			int nearest(-1);
+			
+			// Search rings of cells until the ring is farther than the nearest point found
+			for (int ring(0); ring <= max(n_cols, n_rows); ring++){
+				
+				double ring_distance = max(0.0, (ring - 1) / scaling);
+				
+				if ((nearest >= 0) and (ring_distance * ring_distance > min_distance)){
+					
+					break;
+					
+				}
+				
+				for (int row(row_0 - ring); row <= row_0 + ring; row++){
+					
+					if ((row < 0) or (row >= n_rows)){
+						
+						continue;
+						
+					}
+					
+					// Only the border of the ring is visited
+					int step = ((row == row_0 - ring) or (row == row_0 + ring)) ? 1 : max(1, 2 * ring);
+					
+					for (int col(col_0 - ring); col <= col_0 + ring; col += step){
+						
+						if ((col < 0) or (col >= n_cols)){
+							
+							continue;
+							
+						}
+						
+						SparseGrid::Span cell = segmented.grid_.GetCell(row, col);
+						
+						for (const int* idx(cell.begin); idx != cell.end; idx++){
+							
+							const Point& source = sources[*idx];
+							double dx = source.x - point.x;
+							double dy = source.y - point.y;
+							double dz = source.z - point.z;
+							double distance = dx*dx + dy*dy + dz*dz;
+							
+							if (distance < min_distance){
+								
+								min_distance = distance;
+								nearest = *idx;
+								
+							}
+						}
+					}
+				}
+			}
+			
+			point.tree_idx = sources[nearest].tree_idx;
+			point.segmentation_status = true;
+			
+		}
+	};
+	
+	// Threads take contiguous ranges of points
+	n_threads = max(1u, min(n_threads, (unsigned int) (points_.size() / 10000 + 1)));
+	vector<thread> threads;
+	unsigned int n_points = points_.size();
+	
+	for (unsigned int t(1); t < n_threads; t++){
+		
+		threads.push_back(thread(run, (unsigned int) ((uint64_t) n_points * t / n_threads), (unsigned int) ((uint64_t) n_points * (t+1) / n_threads)));
+		
+	}
+	
+	run(0, n_points / n_threads);
+	
+	for (unsigned int t(0); t < threads.size(); t++){
+		
+		threads[t].join();
+		
+	}
+}
+
+
 // Compute point indexes
 void PointCollection::ComputePointIndexes()
 {
@@ -74,32 +238,60 @@ void PointCollection::ComputePointIndexes()
 
 // Compute the BoundingBox object of the PointCollection object
 void PointCollection::ComputeBoundingBox()
-{	
-	
-	auto result1 = minmax_element(points_.begin(), points_.end(), [](Point a, Point b) { return a.x >= b.x;  });
-	auto result2 = minmax_element(points_.begin(), points_.end(), [](Point a, Point b) { return a.y >= b.y;  }); 
-	
-	BoundingBox bounding_box;
-	
-	bounding_box.x_max_idx = result1.first - points_.begin();
-	bounding_box.x_min_idx = result1.second - points_.begin();
-	bounding_box.y_max_idx = result2.first - points_.begin();
-	bounding_box.y_min_idx = result2.second - points_.begin();
+{
+	if (points_.empty()){
+		
+		bounding_box_.availability = false;
+		return;
+		
+	}
 	
-	bounding_box.x_max = points_[bounding_box.x_max_idx].x;
-	bounding_box.x_min = points_[bounding_box.x_min_idx].x;
-	bounding_box.x_max = points_[bounding_box.y_max_idx].y;
-	bounding_box.y_min = points_[bounding_box.y_min_idx].y;
+	double x_min(points_[0].x), x_max(points_[0].x), y_min(points_[0].y), y_max(points_[0].y);
 	
-	bounding_box.availability = true;
+	for (unsigned int j(1); j < points_.size(); j++){
+		
+		x_min = min(x_min, points_[j].x);
+		x_max = max(x_max, points_[j].x);
+		y_min = min(y_min, points_[j].y);
+		y_max = max(y_max, points_[j].y);
+		
+	}
 	
-	bounding_box_ = bounding_box;
+	SetBoundingBox(x_min, x_max, y_min, y_max);
+
+}
+
+
+// Set the BoundingBox object of the PointCollection object
+void PointCollection::SetBoundingBox(double x_min, double x_max, double y_min, double y_max)
+{
+	bounding_box_.x_min = x_min;
+	bounding_box_.x_max = x_max;
+	bounding_box_.y_min = y_min;
+	bounding_box_.y_max = y_max;
+	bounding_box_.width = x_max - x_min;
+	bounding_box_.height = y_max - y_min;
+	bounding_box_.availability = true;
 
 }
 
 
 // Compute the grid coordinates
 void PointCollection::ComputeGridCoordinates()
+{
+	if (not bounding_box_.availability){
+		
+		ComputeBoundingBox();
+		
+	}
+	
+	ComputeGridCoordinates(bounding_box_.x_min, bounding_box_.y_min);
+
+}
+
+
+// Compute the grid coordinates with regard to the specified origin
+void PointCollection::ComputeGridCoordinates(double x_origin, double y_origin)
 {
 	if (coordinate_scaling_ != 1 and coordinate_scaling_ != 10){
 		
@@ -114,42 +306,205 @@ void PointCollection::ComputeGridCoordinates()
 		
 	}
 	
-	for(unsigned int j(0); j < points_.size(); j++){
+	x_origin_ = x_origin;
+	y_origin_ = y_origin;
+	
+	if ((quantization_ > 0) and (x_origin == x_quantization_origin_) and (y_origin == y_quantization_origin_)){
+		
+		// Integer gridding: a grid cell spans cell_size quantization units, coordinates are rounded half up
+		long long cell_size = quantization_ / coordinate_scaling_;
+		
+		for(unsigned int j(0); j < points_.size(); j++){
+			
+			points_[j].row = (int) ((points_[j].qy + cell_size / 2) / cell_size);
+			points_[j].col = (int) ((points_[j].qx + cell_size / 2) / cell_size);
+			
+		}
+		
+		// The extreme points are quantized as in Quantize
+		long long qx_max = (long long) round((bounding_box_.x_max - x_quantization_origin_) * double(quantization_));
+		long long qy_max = (long long) round((bounding_box_.y_max - y_quantization_origin_) * double(quantization_));
+		n_cols_ = (int) ((qx_max + cell_size / 2) / cell_size) + 1; // Number of columns
+		n_rows_ = (int) ((qy_max + cell_size / 2) / cell_size) + 1; // Number of rows
+		
+	} else {
+		
+		for(unsigned int j(0); j < points_.size(); j++){
+			
+			points_[j].row = (int) round((points_[j].y - y_origin) * double(coordinate_scaling_));
+			points_[j].col = (int) round((points_[j].x - x_origin) * double(coordinate_scaling_));
+
+		}
 		
-		points_[j].row = (int) round((points_[j].y - points_[bounding_box_.y_min_idx].y) * double(coordinate_scaling_)); //round(
-		points_[j].col = (int) round((points_[j].x - points_[bounding_box_.x_min_idx].x) * double(coordinate_scaling_));
+		n_cols_ = (int) round((bounding_box_.x_max - x_origin) * double(coordinate_scaling_)) + 1; // Number of columns
+		n_rows_ = (int) round((bounding_box_.y_max - y_origin) * double(coordinate_scaling_)) + 1; // Number of rows
+		
+	}
+
+}
+
 
+// Quantize the coordinates relative to the minimum x and y coordinates
+bool PointCollection::Quantize(unsigned int units_per_meter)
+{
+	if ((units_per_meter == 0) or (units_per_meter % coordinate_scaling_ != 0)){
+		
+		cerr << "Warning: the quantization must be a multiple of the scaling factor. Using double precision coordinates." << endl;
+		quantization_ = 0;
+		return false;
+		
 	}
 	
-	n_cols_ = points_[bounding_box_.x_max_idx].col + 1; // Number of columns
-	n_rows_ = points_[bounding_box_.y_max_idx].row + 1; // Number of rows
-	cout << "nrows: " <<  n_rows_ << endl;
-	cout << "ncols: " <<  n_cols_ << endl;
+	if (not bounding_box_.availability){
+		
+		ComputeBoundingBox();
+		
+	}
+	
+	x_quantization_origin_ = bounding_box_.x_min;
+	y_quantization_origin_ = bounding_box_.y_min;
+	double scale = double(units_per_meter);
+	
+	for(unsigned int j(0); j < points_.size(); j++){
+		
+		double qx = round((points_[j].x - x_quantization_origin_) * scale);
+		double qy = round((points_[j].y - y_quantization_origin_) * scale);
+		double qz = round(points_[j].z * scale);
+		
+		if ((qx > 2147483647.0) or (qy > 2147483647.0) or (fabs(qz) > 2147483647.0)){
+			
+			cerr << "Warning: quantized coordinates exceed 32 bits. Using double precision coordinates." << endl;
+			quantization_ = 0;
+			return false;
+			
+		}
+		
+		points_[j].qx = (int) qx;
+		points_[j].qy = (int) qy;
+		points_[j].qz = (int) qz;
+		
+	}
+	
+	quantization_ = units_per_meter;
+	
+	return true;
+}
+
 
+// Get the quantization
+unsigned int PointCollection::GetQuantization()
+{
+	
+	return quantization_;
+	
 }
 
 
 // Compute grid node membership
 void PointCollection::AssignGridCells()
 {
-	vector<vector<int>> idx_grid(n_cols_*n_rows_);
-	cout << "size: " <<  n_cols_*n_rows_ << endl;
+	grid_.Build(points_);
 	
-	for(unsigned int j(0); j < points_.size(); j++){
+}
+	
+
+// Half heights (in rows) of the columns of a circle of R grid cells
+template <int R>
+static array<int, 2*R+1> CircleHalfHeights()
+{
+	array<int, 2*R+1> half_heights;
+	
+	for (int dc(-R); dc <= R; dc++){
 		
-		idx_grid[SubscriptToIndex(n_cols_, points_[j].row, points_[j].col)].push_back(j);
+		int h(R);
+		
+		while (dc*dc + h*h > R*R){
+			
+			h--;
+			
+		}
+		
+		half_heights[dc + R] = h;
 		
 	}
 	
-	idx_grid_ = idx_grid;
-	
+	return half_heights;
 }
+
+
+// Extract the unsegmented points located within a circle of R grid cells
+template <int R>
+void PointCollection::ExtractPointsInCircle(PointCollection& sample, int col_0, int row_0)
+{
+	static const array<int, 2*R+1> half_heights = CircleHalfHeights<R>();
 	
+	// Columns, then rows, as in the coordinate offsets of a CircularBuffer
+	for (int dc(-R); dc <= R; dc++){
+		
+		int col_idx = col_0 + dc;
+		
+		if ((unsigned int) col_idx >= n_cols_){
+			
+			continue;
+			
+		}
+		
+		int row_begin = max(row_0 - half_heights[dc + R], 0);
+		int row_end = min(row_0 + half_heights[dc + R], int(n_rows_) - 1);
+		
+		// The cells of the column within a block are a single span
+		grid_.ForEachColumnSpan(col_idx, row_begin, row_end, [&](const SparseGrid::Span& span){
+			
+			for (const int* idx(span.begin); idx != span.end; idx++){
+				
+				// Check if the point is non-segmented
+				if (not points_[*idx].segmentation_status){
+					
+					sample.points_.push_back(points_[*idx]);
+					
+				}
+			}
+		});
+	}
+}
+
+
+// Dispatch table of the extraction kernels
+PointCollection::ExtractionKernel PointCollection::GetExtractionKernel(unsigned int scaled_radius)
+{
+	switch (scaled_radius){
+		
+		case 2: return &PointCollection::ExtractPointsInCircle<2>;
+		case 4: return &PointCollection::ExtractPointsInCircle<4>;
+		case 9: return &PointCollection::ExtractPointsInCircle<9>;
+		case 14: return &PointCollection::ExtractPointsInCircle<14>;
+		case 20: return &PointCollection::ExtractPointsInCircle<20>;
+		case 40: return &PointCollection::ExtractPointsInCircle<40>;
+		case 90: return &PointCollection::ExtractPointsInCircle<90>;
+		case 140: return &PointCollection::ExtractPointsInCircle<140>;
+		default: return NULL;
+		
+	}
+}
+
 
 // Extract the grid values located within the given CircularBuffer
 void PointCollection::ExtractPointsInBuffer(CircularBuffer& circular_buffer, PointCollection& sample, int& col_0, int& row_0)
 {
-	vector<int> tmp_idx;
+	PerfCounters::Counts perf_start;
+	bool measured = PerfCounters::StartFunction(PerfCounters::EXTRACT_POINTS_IN_BUFFER, perf_start);
+	
+	// Use the kernel specialized for the radius of the buffer, if there is one
+	ExtractionKernel kernel = GetExtractionKernel(circular_buffer.scaled_radius_);
+	
+	if (kernel != NULL){
+		
+		(this->*kernel)(sample, col_0, row_0);
+		if (measured) PerfCounters::StopFunction(PerfCounters::EXTRACT_POINTS_IN_BUFFER, perf_start);
+		return;
+		
+	}
+	
 	int col_idx, row_idx;
 
 	for(unsigned int j(0); j < circular_buffer.coordinate_offsets_.size(); j++){
@@ -161,17 +516,17 @@ void PointCollection::ExtractPointsInBuffer(CircularBuffer& circular_buffer, Poi
 		// Check if the kernel cell is located within the grid
 		if (((unsigned int)row_idx <= n_rows_-1) and ((unsigned int)row_idx >= 0) and ((unsigned int)col_idx <= n_cols_-1) and ((unsigned int)col_idx >= 0)){
 			
-			tmp_idx = idx_grid_[SubscriptToIndex(n_cols_, row_idx, col_idx)]; // Grid cell linear index
+			SparseGrid::Span cell = grid_.GetCell(row_idx, col_idx);
 			
 			// Check if the grid cell is non-empty
-			if (not tmp_idx.empty()){
+			if (not cell.empty()){
 
-				 for(unsigned int k(0); k < tmp_idx.size(); k++){
+				 for(const int* idx(cell.begin); idx != cell.end; idx++){
 					 
 					// Check if the point is non-segmented
-					if (not points_[tmp_idx[k]].segmentation_status){
+					if (not points_[*idx].segmentation_status){
 					
-						sample.points_.push_back(points_[tmp_idx[k]]); 
+						sample.points_.push_back(points_[*idx]); 
 
 					}
 						
@@ -179,18 +534,110 @@ void PointCollection::ExtractPointsInBuffer(CircularBuffer& circular_buffer, Poi
 			}
 		}
 	}
+	
+	if (measured) PerfCounters::StopFunction(PerfCounters::EXTRACT_POINTS_IN_BUFFER, perf_start);
 
 } 
 
 
+// Interleave the bits of a row and a column (Morton code)
+static uint64_t CellMortonCode(uint32_t row, uint32_t col)
+{
+	uint64_t code(0);
+	
+	for (unsigned int b(0); b < 32; b++){
+		
+		code |= (uint64_t((col >> b) & 1) << (2*b)) | (uint64_t((row >> b) & 1) << (2*b + 1));
+		
+	}
+	
+	return code;
+}
+
+
+// Store the points in the Morton order of their grid cells
+void PointCollection::SortBySpatialOrder()
+{
+	if (IsSpatiallyOrdered() or points_.empty()){
+		
+		return;
+		
+	}
+	
+	// Sort by cell code, the point indexes keeping the height order of the points of a cell
+	vector<pair<uint64_t, unsigned int>> order(points_.size());
+	
+	for (unsigned int j(0); j < points_.size(); j++){
+		
+		order[j] = {CellMortonCode(points_[j].row, points_[j].col), j};
+		
+	}
+	
+	sort(order.begin(), order.end());
+	
+	vector<Point> points(points_.size());
+	height_order_.resize(points_.size());
+	height_rank_.resize(points_.size());
+	
+	for (unsigned int k(0); k < order.size(); k++){
+		
+		points[k] = points_[order[k].second];
+		points[k].point_idx = k;
+		height_order_[order[k].second] = k;
+		height_rank_[k] = order[k].second;
+		
+	}
+	
+	points_.swap(points);
+	AssignGridCells();
+	
+}
+
+
+// Store the points in height order again
+void PointCollection::RestoreHeightOrder()
+{
+	if (not IsSpatiallyOrdered()){
+		
+		return;
+		
+	}
+	
+	vector<Point> points(points_.size());
+	
+	for (unsigned int rank(0); rank < points.size(); rank++){
+		
+		points[rank] = points_[height_order_[rank]];
+		points[rank].point_idx = rank;
+		
+	}
+	
+	points_.swap(points);
+	height_order_.clear();
+	height_rank_.clear();
+	AssignGridCells();
+	
+}
+
+
 // Find the local maxima
 void PointCollection::FindLocalMaxima(CircularBuffer& circular_buffer)
+{
+	FindLocalMaxima(circular_buffer, 1000); // Value based on max point density (current max. density is ~70 pts per square meter for ALS)
+}
+
+
+// Find the local maxima, with the expected number of Points within the CircularBuffer
+void PointCollection::FindLocalMaxima(CircularBuffer& circular_buffer, unsigned int n_reserved)
 {
 	bool locmax;
 	PointCollection local_points;
-	local_points.points_.reserve(1000); // Value based on max point density (current max. density is ~70 pts per square meter for ALS)
+	local_points.points_.reserve(n_reserved);
 	
-	for(unsigned int j(0); j < points_.size(); j++){
+	// Points are visited in decreasing height order, whatever their storage order
+	for(unsigned int rank(0); rank < points_.size(); rank++){
+		
+		unsigned int j = GetHeightOrderIndex(rank);
 		
 		if (points_[j].local_maxima_status == 2){ // If the LocalMaximaStatus is undetermined
 			
@@ -226,6 +673,131 @@ void PointCollection::FindLocalMaxima(CircularBuffer& circular_buffer)
 	
 }
 
+// Find the local maxima within the local maxima buffers of a collection
+void PointCollection::FindLocalMaxima(CircularBufferCollection& circular_buffer_collection, unsigned int n_reserved, unsigned int n_threads)
+{
+	if (not circular_buffer_collection.HasLocalMaximaModel()){
+		
+		FindLocalMaxima(circular_buffer_collection.GetCircularBuffer(0), n_reserved);
+		return;
+		
+	}
+	
+	const int block_size = SparseGrid::block_size;
+	atomic<size_t> next_block(0);
+	
+	// Each thread takes the next occupied block, and searches the buffers of its cells in the table of the block
+	// extended by the largest buffer radius of its cells
+	auto run = [&](){
+		
+		SparseTable2D table;
+		vector<uint32_t> keys;
+		vector<const CircularBuffer*> buffers(block_size * block_size);
+		size_t block;
+		
+		while ((block = next_block++) < grid_.GetNumberOfBlocks()){
+			
+			int block_row, block_col;
+			grid_.GetBlockCoordinates(block, block_row, block_col);
+			int row_0 = block_row * block_size;
+			int col_0 = block_col * block_size;
+			int margin(0);
+			
+			// The highest Point of a cell is its first Point, whatever the storage order
+			for (int c(0); c < block_size; c++){
+				
+				for (int r(0); r < block_size; r++){
+					
+					SparseGrid::Span cell = grid_.GetCell(row_0 + r, col_0 + c);
+					buffers[c * block_size + r] = NULL;
+					
+					if (not cell.empty()){
+						
+						CircularBuffer& buffer = circular_buffer_collection.GetLocalMaximaBuffer(points_[*cell.begin].z);
+						buffers[c * block_size + r] = &buffer;
+						margin = max(margin, int(buffer.scaled_radius_));
+						
+					}
+				}
+			}
+			
+			// Height rank of the highest Point of each cell of the extended block (empty cells are lower than any Point)
+			int side = block_size + 2 * margin;
+			keys.assign(size_t(side) * side, UINT32_MAX);
+			
+			for (int r(0); r < side; r++){
+				
+				for (int c(0); c < side; c++){
+					
+					SparseGrid::Span cell = grid_.GetCell(row_0 - margin + r, col_0 - margin + c);
+					
+					if (not cell.empty()){
+						
+						keys[size_t(r) * side + c] = GetHeightRank(*cell.begin);
+						
+					}
+				}
+			}
+			
+			table.Build(keys, side, side, 2 * margin + 1);
+			
+			for (int c(0); c < block_size; c++){
+				
+				for (int r(0); r < block_size; r++){
+					
+					const CircularBuffer* buffer = buffers[c * block_size + r];
+					
+					if (buffer == NULL){
+						
+						continue;
+						
+					}
+					
+					SparseGrid::Span cell = grid_.GetCell(row_0 + r, col_0 + c);
+					uint32_t rank = GetHeightRank(*cell.begin);
+					bool locmax(true);
+					
+					for (unsigned int k(0); locmax and (k < buffer->rectangles_.size()); k++){
+						
+						int half_width = buffer->rectangles_[k][0];
+						int half_height = buffer->rectangles_[k][1];
+						locmax = (table.GetMinimum(margin + r - half_height, margin + c - half_width, 2 * half_height + 1, 2 * half_width + 1) == rank);
+						
+					}
+					
+					// The other Points of the cell are lower than its highest Point, or equal and later in the height order
+					for (const int* j = cell.begin; j != cell.end; j++){
+						
+						points_[*j].local_maxima_status = 0;
+						
+					}
+					
+					points_[*cell.begin].local_maxima_status = locmax ? 1 : 0;
+					
+				}
+			}
+		}
+	};
+	
+	n_threads = max(1u, min(n_threads, (unsigned int) grid_.GetNumberOfBlocks()));
+	vector<thread> threads;
+	
+	for (unsigned int t(1); t < n_threads; t++){
+		
+		threads.push_back(thread(run));
+		
+	}
+	
+	run();
+	
+	for (unsigned int t(0); t < threads.size(); t++){
+		
+		threads[t].join();
+		
+	}
+}
+
+
 // Get coordinate scaling factor
 unsigned int PointCollection::GetScalingFactor()
 {
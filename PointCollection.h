@@ -28,15 +28,26 @@
 #include <iostream>
 #include <vector>
 #include <array>
+#include <climits>
 #include "CircularBuffer.h"
 #include "CircularBufferCollection.h"
+#include "SparseGrid.h"
 
 class PointCollection {
 	
 friend class SegmenterSNC;
+friend class SegmenterWatershed;
 friend class FileIO;
 friend class CircularBufferCollection;
 friend class TreeCollection;
+friend class SegmentationPipeline;
+friend class BatchProcessor;
+friend class SegmentationState;
+friend class StreamingWriter;
+friend class IngestStatistics;
+friend class TreeIndex;
+friend class OctreeExporter;
+friend class SpatialOrderBenchmark;
 
 public:
 	
@@ -53,6 +64,13 @@ public:
 	 */
 	void ComputeBoundingBox();
 	
+	
+	/**
+	 * Sets the bounding box of the PointCollection, when it is already known (e.g. from the IngestStatistics of the input).
+	 *
+	 */
+	void SetBoundingBox(double x_min, double x_max, double y_min, double y_max);
+	
 	/**
 	 * Computes the linear index of each Point in the PointCollection.
 	 *
@@ -67,6 +85,34 @@ public:
 	void ComputeGridCoordinates();
 	
 	
+	/**
+	 * Computes a grid coordinate (col, row) for each Point in the PointCollection with regard to the specified grid origin.
+	 * The origin must be located at or below the minimum x and y coordinates of the PointCollection.
+	 *
+	 * @param  x_origin The x coordinate of the center of the grid cell (0, 0).
+	 * @param  y_origin The y coordinate of the center of the grid cell (0, 0).
+	 */
+	void ComputeGridCoordinates(double x_origin, double y_origin);
+	
+	
+	/**
+	 * Quantizes the coordinates of each Point to integers relative to the minimum x and y coordinates of the PointCollection
+	 * (and to z = 0), as in the LAS format. Once quantized, gridding is done in integer arithmetic and SegmenterSNC compares
+	 * squared distances in integer arithmetic. The double coordinates are kept for input and output.
+	 *
+	 * @param  units_per_meter The number of quantization units per coordinate unit (e.g. 100 = centimetric). Must be a multiple of the coordinate scaling factor.
+	 * @return Returns false if a coordinate does not fit in 32 bits.
+	 */
+	bool Quantize(unsigned int units_per_meter);
+	
+	
+	/**
+	 * Accessor to the number of quantization units per coordinate unit (0 if the coordinates are not quantized).
+	 * 
+	 */
+	unsigned int GetQuantization();
+	
+	
 	/**
 	 * Assigns each Point to a grid cell.
 	 *
@@ -96,8 +142,70 @@ public:
 	void FindLocalMaxima(CircularBuffer& circular_buffer);
 	
 	
+	/**
+	 * Finds all local maxima in the PointCollection.
+	 *
+	 * @param  circular_buffer A reference to the CircularBuffer used in the local maxima definition.
+	 * @param  n_reserved The expected largest number of Points within the CircularBuffer.
+	 */
+	void FindLocalMaxima(CircularBuffer& circular_buffer, unsigned int n_reserved);
+	
+	
+	/**
+	 * Finds all local maxima in the PointCollection, within the local maxima buffers of a CircularBufferCollection. With
+	 * a local maxima model (see CircularBufferCollection::SetLocalMaximaModel), the radius of the buffer depends on the
+	 * height of each Point and a Point is a local maximum if it is the first Point of the height order within its buffer.
+	 * The buffers are then searched in a SparseTable2D of the height rank of the highest Point of each grid cell, built
+	 * for each occupied block of the grid, so that the cost of a search does not depend on the number of Points within
+	 * the buffer. Otherwise, the local maxima are found within the first CircularBuffer of the collection.
+	 *
+	 * @param  circular_buffer_collection A reference to the CircularBufferCollection.
+	 * @param  n_reserved The expected largest number of Points within the first CircularBuffer.
+	 * @param  n_threads The number of threads searching the blocks of a local maxima model.
+	 */
+	void FindLocalMaxima(CircularBufferCollection& circular_buffer_collection, unsigned int n_reserved, unsigned int n_threads);
+	
+	
+	/**
+	 * Stores the Points in the Morton (Z-order) curve order of their grid cells, so that the Points of a cell and of its
+	 * neighbouring cells are contiguous in memory. The Points of a cell keep their height order, and the height order of all
+	 * the Points is kept in a separate index (see GetHeightOrderIndex). The PointCollection must be sorted by height and gridded.
+	 *
+	 */
+	void SortBySpatialOrder();
+	
+	
+	/**
+	 * Stores the Points in height order again after SortBySpatialOrder (the Point indexes and the grid are updated).
+	 *
+	 */
+	void RestoreHeightOrder();
+	
+	
+	/**
+	 * Accessor to the index of the Point of the specified rank in decreasing height order.
+	 *
+	 */
+	unsigned int GetHeightOrderIndex(unsigned int rank) const {return height_order_.empty() ? rank : height_order_[rank];};
+	
+	
+	/**
+	 * Accessor to the rank in decreasing height order of the Point of the specified index.
+	 *
+	 */
+	unsigned int GetHeightRank(unsigned int idx) const {return height_rank_.empty() ? idx : height_rank_[idx];};
+	
+	
+	/**
+	 * Returns true if the Points are stored in spatial order (see SortBySpatialOrder).
+	 *
+	 */
+	bool IsSpatiallyOrdered() const {return not height_order_.empty();};
+	
+	
 	/**
 	 * Set the int16 RGB color triplet for each Point in the PointCollection based on its tree index (tree_idx member).
+	 * Unassigned Points are colored black.
 	 *
 	 * @param  hsv_colormap A colormap consisting of int16 RGB triplets.
 	 * 
@@ -121,7 +229,42 @@ public:
 	PointCollection FilterPointsByClass(std::vector<unsigned int>& keep_classes);
 	
 	
-	PointCollection(){coordinate_scaling_ = 1;}; // Constructor
+	/**
+	 * Filter Points in the PointCollection by their classification.
+	 *
+	 * @param  keep_classes The classes which are kept.
+	 * @param  n_reserved The expected number of kept Points.
+	 */
+	PointCollection FilterPointsByClass(std::vector<unsigned int>& keep_classes, size_t n_reserved);
+	
+	
+	/**
+	 * Keeps the highest Point of each cubic voxel. The PointCollection must be sorted by height.
+	 *
+	 * @param  voxel_size The side of the voxels.
+	 * @return Returns the kept Points, in height order.
+	 */
+	PointCollection ThinByVoxel(double voxel_size);
+	
+	
+	/**
+	 * Sets the tree index and the segmentation status of each Point to those of the nearest Point (in 3D) of a segmented
+	 * PointCollection. The nearest Point is searched in rings of grid cells of the segmented PointCollection.
+	 *
+	 * @param  segmented A reference to the segmented (and gridded) PointCollection.
+	 * @param  n_threads The number of threads sharing the Points.
+	 */
+	void CopyTreeIndexesFromNearest(PointCollection& segmented, unsigned int n_threads);
+	
+	
+	/**
+	 * Tree index of the Points which are not assigned to any tree (Points of the trees rejected during the segmentation).
+	 *
+	 */
+	static const unsigned int unassigned_tree = UINT_MAX;
+	
+	
+	PointCollection(){coordinate_scaling_ = 1; quantization_ = 0; bounding_box_.availability = false;}; // Constructor
 	~PointCollection(){}; // Destructor
 	
 private:
@@ -143,6 +286,9 @@ private:
 		unsigned int local_maxima_status;
 		bool segmentation_status;
 		std::array<unsigned int,3> rgb_color;
+		int qx; // Quantized coordinates
+		int qy;
+		int qz;
 	
 	};
 	
@@ -160,10 +306,6 @@ private:
 		double x_max;
 		double y_min;
 		double y_max;
-		unsigned int x_min_idx;
-		unsigned int x_max_idx;
-		unsigned int y_min_idx;
-		unsigned int y_max_idx;
 		
 	};
 	
@@ -174,6 +316,14 @@ private:
 	 */
 	std::vector<Point> points_;
 	
+	/**
+	 * Index of the Points in decreasing height order and rank of each Point in this order, when the Points are stored in
+	 * spatial order (both are empty when the Points are stored in height order).
+	 *
+	 */
+	std::vector<unsigned int> height_order_;
+	std::vector<unsigned int> height_rank_;
+	
 	/**
 	 * Bounding box.
 	 *
@@ -181,10 +331,17 @@ private:
 	BoundingBox bounding_box_;
 	
 	/**
-	 * Grid.
+	 * Grid (occupied blocks of cells only).
+	 *
+	 */
+	SparseGrid grid_;
+	
+	/**
+	 * Grid origin (coordinates of the center of the grid cell (0, 0)).
 	 *
 	 */
-	std::vector<std::vector<int>> idx_grid_;
+	double x_origin_;
+	double y_origin_;
 	
 	/**
 	 * Number of grid columns.
@@ -204,6 +361,14 @@ private:
 	 */
 	unsigned int coordinate_scaling_;
 	
+	/**
+	 * Number of quantization units per coordinate unit (0 = coordinates are not quantized) and quantization origin.
+	 *
+	 */
+	unsigned int quantization_;
+	double x_quantization_origin_;
+	double y_quantization_origin_;
+	
 	/**
 	 * Number of segmented points.
 	 *
@@ -229,6 +394,23 @@ private:
 	 * @return Returns a linear cell index.
 	 */
 	unsigned int SubscriptToIndex(unsigned int ncols, unsigned int row, unsigned int column);
+	
+	/**
+	 * Extracts the unsegmented Points located within a circle of R grid cells centered at (col_0, row_0), in the order of
+	 * the coordinate offsets of a CircularBuffer of the same radius. The radius is a template parameter, so that the
+	 * row ranges of the columns of the circle are known at compile time.
+	 *
+	 */
+	template <int R>
+	void ExtractPointsInCircle(PointCollection& sample, int col_0, int row_0);
+	
+	/**
+	 * Extraction kernel of a circle radius, or NULL if the radius has no specialized kernel. The kernels are instantiated
+	 * for the radii of the fixed CircularBuffers (2, 4, 9 and 14) at the coordinate scaling factors 1 and 10.
+	 *
+	 */
+	typedef void (PointCollection::*ExtractionKernel)(PointCollection& sample, int col_0, int row_0);
+	static ExtractionKernel GetExtractionKernel(unsigned int scaled_radius);
 
 		
 };
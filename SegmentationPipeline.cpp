@@ -0,0 +1,810 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <cmath>
+#include "SegmentationPipeline.h"
+#include "FileIO.h"
+#include "PointCollection.h"
+#include "TreeCollection.h"
+#include "Segmenter.h"
+#include "CircularBuffer.h"
+#include "CircularBufferCollection.h"
+#include "SegmentationState.h"
+#include "PerfCounters.h"
+#include "TraceRecorder.h"
+#include "StreamingWriter.h"
+#include "IngestStatistics.h"
+#include "TreeIndex.h"
+#include "OctreeExporter.h"
+
+using namespace std;
+
+
+// Elapsed time in seconds since the specified time point
+static double ElapsedSeconds(chrono::steady_clock::time_point t0)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+
+// Push the tree filter down into the segmentation, unless the trees are measured on other points than the segmented
+// ones (thinning) or all the trees are kept for later incremental updates
+static void SetTreeFilter(Segmenter& segmenter, const SegmentationPipeline::Parameters& parameters)
+{
+	if ((parameters.thinning_voxel_size <= 0.0) and (not parameters.save_state)){
+
+		segmenter.SetTreeFilter(parameters.min_height, parameters.min_n_points);
+
+	} else {
+
+		segmenter.SetTreeFilter(0, 0);
+
+	}
+}
+
+
+// Default processing parameters
+SegmentationPipeline::Parameters SegmentationPipeline::DefaultParameters()
+{
+	Parameters parameters;
+	parameters.keep_classes = {5}; // High vegetation
+	parameters.min_n_points = 20;
+	parameters.min_height = 3;
+	parameters.precision = 2;
+	parameters.verbosity = true;
+	parameters.save_state = false;
+	parameters.use_cache = false;
+	parameters.segmentation_threads = 1;
+	parameters.max_segmentation_threads = 0;
+	parameters.wavefront_size = 0;
+	parameters.quantization = 0;
+	parameters.verify_quantization = false;
+	parameters.radius_model = CircularBufferCollection::DefaultRadiusModel();
+	parameters.variable_local_maxima = false;
+	parameters.local_maxima_model = CircularBufferCollection::DefaultRadiusModel();
+	parameters.stream_output = false;
+	parameters.compression_threads = 0;
+	parameters.segmenter = Segmenter::SNC;
+	parameters.tree_index = false;
+	parameters.array_output = FileIO::NO_ARRAYS;
+	parameters.octree = false;
+	parameters.thinning_voxel_size = 0.0;
+	parameters.spatial_order = false;
+	parameters.region_of_interest.has_bbox = false;
+	parameters.region_of_interest.x_min = 0.0;
+	parameters.region_of_interest.x_max = 0.0;
+	parameters.region_of_interest.y_min = 0.0;
+	parameters.region_of_interest.y_max = 0.0;
+
+	return parameters;
+}
+
+
+// Read, segment and write a csv or chunked point file
+SegmentationPipeline::Metrics SegmentationPipeline::ProcessFile(const string& i_filepath, const Parameters& parameters)
+{
+	Metrics metrics = {false, "", "", "", 0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0};
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	FileIO file_io(i_filepath);
+
+	if ((i_filepath.size() >= 4) and (i_filepath.rfind(".tsp") == (i_filepath.size()-4))){
+
+		// Read the chunks intersecting the region of interest, with the kept classes only
+		FileIO::RegionOfInterest region_of_interest = parameters.region_of_interest;
+		region_of_interest.classes = parameters.keep_classes;
+		PointCollection point_collection;
+
+		if (not file_io.ReadChunkedPoints(region_of_interest, point_collection, parameters.verbosity)){
+
+			metrics.message = "unable to read chunked point file " + i_filepath;
+			return metrics;
+
+		}
+
+		PerfCounters::StopStage("read", perf_start);
+		TraceRecorder::AddStage("read", t0);
+		metrics.t_read = ElapsedSeconds(t0);
+		ProcessPoints(point_collection, NULL, file_io, parameters, metrics);
+		metrics.t_total = ElapsedSeconds(t0);
+
+		return metrics;
+
+	}
+
+	// Read the csv file
+	vector<char> buffer;
+
+	if (not file_io.ReadInputBuffer(buffer)){
+
+		metrics.message = "unable to open input file " + i_filepath;
+		return metrics;
+
+	}
+
+	if (parameters.verbosity) cout << "Reading " << i_filepath << "...Done!" << endl;
+	PerfCounters::StopStage("read", perf_start);
+	TraceRecorder::AddStage("read", t0);
+	metrics.t_read = ElapsedSeconds(t0);
+
+	ProcessBuffer(buffer, file_io, parameters, metrics);
+	metrics.t_total = ElapsedSeconds(t0);
+
+	return metrics;
+}
+
+
+// Parse (or load from the cache), segment and write the contents of a csv file
+void SegmentationPipeline::ProcessBuffer(const vector<char>& buffer, FileIO& file_io, const Parameters& parameters, Metrics& metrics)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	bool verbosity = parameters.verbosity;
+	PointCollection point_collection_subset, point_collection_unthinned;
+	uint64_t key(0);
+
+	// The cache only holds the segmented points, so thinned runs do not use it
+	bool use_cache = parameters.use_cache and (parameters.thinning_voxel_size <= 0.0);
+
+	if (use_cache){
+
+		// The cache key covers the input contents and the parameters of the preparation stages
+		vector<unsigned int> key_parameters = parameters.keep_classes;
+		key_parameters.push_back(scaling_factor_);
+		key_parameters.push_back((unsigned int) circular_buffer_collection_.GetCircularBuffer(0).GetRadius());
+		key_parameters.push_back(parameters.quantization);
+		key_parameters.push_back(parameters.variable_local_maxima);
+		key = FileIO::HashBuffer(buffer.data(), buffer.size(), 0);
+		key = FileIO::HashBuffer((const char*) key_parameters.data(), key_parameters.size() * sizeof(unsigned int), key);
+
+		if (parameters.variable_local_maxima){
+
+			const CircularBufferCollection::RadiusModel& model = parameters.local_maxima_model;
+			vector<double> model_parameters = {double(model.type), model.a, model.b, model.min_radius, model.max_radius};
+			model_parameters.insert(model_parameters.end(), model.heights.begin(), model.heights.end());
+			model_parameters.insert(model_parameters.end(), model.radii.begin(), model.radii.end());
+			key = FileIO::HashBuffer((const char*) model_parameters.data(), model_parameters.size() * sizeof(double), key);
+
+		}
+
+		uint64_t n_input_points;
+
+		if (file_io.ReadPointCache(point_collection_subset, key, n_input_points)){
+
+			if (verbosity) cout << "Loaded prepared points from " << file_io.GetCacheFilepath() << endl;
+			if (parameters.quantization > 0) point_collection_subset.Quantize(parameters.quantization);
+			metrics.n_points = n_input_points;
+			metrics.n_filtered = point_collection_subset.points_.size();
+			PerfCounters::StopStage("prepare", perf_start);
+			TraceRecorder::AddStage("prepare", t0);
+			metrics.t_prepare = ElapsedSeconds(t0);
+			SegmentPreparedPoints(point_collection_subset, point_collection_unthinned, file_io, parameters, metrics);
+			return;
+
+		}
+	}
+
+	PointCollection point_collection;
+	IngestStatistics statistics;
+	FileIO::ParseCsvBuffer(buffer.data(), buffer.data() + buffer.size(), point_collection, statistics);
+	PerfCounters::StopStage("read", perf_start);
+	TraceRecorder::AddStage("read", t0);
+	metrics.t_read += ElapsedSeconds(t0);
+
+	if (not PreparePoints(point_collection, &statistics, point_collection_subset, point_collection_unthinned, parameters, metrics)){
+
+		return;
+
+	}
+
+	if (use_cache and file_io.WritePointCache(point_collection_subset, key, point_collection.points_.size())){
+
+		if (verbosity) cout << "Saved prepared points to " << file_io.GetCacheFilepath() << endl;
+
+	}
+
+	SegmentPreparedPoints(point_collection_subset, point_collection_unthinned, file_io, parameters, metrics);
+}
+
+
+// Segment a PointCollection and write the results
+void SegmentationPipeline::ProcessPoints(PointCollection& point_collection, const IngestStatistics* statistics, FileIO& file_io, const Parameters& parameters, Metrics& metrics)
+{
+	PointCollection point_collection_subset, point_collection_unthinned;
+
+	if (PreparePoints(point_collection, statistics, point_collection_subset, point_collection_unthinned, parameters, metrics)){
+
+		SegmentPreparedPoints(point_collection_subset, point_collection_unthinned, file_io, parameters, metrics);
+
+	}
+}
+
+
+// Filter, sort, grid and find the local maxima
+bool SegmentationPipeline::PreparePoints(PointCollection& point_collection, const IngestStatistics* statistics, PointCollection& point_collection_subset, PointCollection& point_collection_unthinned, const Parameters& parameters, Metrics& metrics)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	bool verbosity = parameters.verbosity;
+	metrics.n_points = point_collection.points_.size();
+
+	// Sources read without statistics are summarized in a single pass
+	IngestStatistics computed_statistics;
+
+	if (statistics == NULL){
+
+		computed_statistics.AddPoints(point_collection);
+		statistics = &computed_statistics;
+
+	}
+
+	// Create a subset of PointCollection containing only points with the kept classifications
+	vector<unsigned int> keep_classes = parameters.keep_classes;
+	if (verbosity) cout << "Extracting subset...";
+	point_collection_subset = point_collection.FilterPointsByClass(keep_classes, statistics->GetNumberOfPoints(keep_classes));
+	if (verbosity) cout << "Done!" << endl;
+	metrics.n_filtered = point_collection_subset.points_.size();
+
+	if (point_collection_subset.points_.empty()){
+
+		metrics.message = "no point with the requested classification";
+		return false;
+
+	}
+
+	// Sort the PointCollection by height
+	if (verbosity) cout << "Sorting points by height...";
+	point_collection_subset.SortByZ();
+	if (verbosity) cout << "Done!" << endl;
+
+	// Segment the highest point of each voxel only
+	if (parameters.thinning_voxel_size > 0.0){
+
+		if (verbosity) cout << "Thinning points...";
+		point_collection_unthinned = move(point_collection_subset);
+		point_collection_unthinned.ComputePointIndexes();
+		point_collection_subset = point_collection_unthinned.ThinByVoxel(parameters.thinning_voxel_size);
+		if (verbosity) cout << "Done! (" << point_collection_subset.points_.size() << " of " << point_collection_unthinned.points_.size() << " points kept)" << endl;
+
+	}
+
+	// Recompute the Point indexes
+	point_collection_subset.ComputePointIndexes();
+
+	// Set the bounding box of the kept classes from the statistics
+	if (verbosity) cout << "Computing bounding box... ";
+	IngestStatistics::Extent extent;
+
+	if (statistics->GetExtent(keep_classes, extent)){
+
+		point_collection_subset.SetBoundingBox(extent.x_min, extent.x_max, extent.y_min, extent.y_max);
+
+	} else {
+
+		point_collection_subset.ComputeBoundingBox();
+
+	}
+
+	if (verbosity) cout << "Done!" << endl;
+
+	// Quantize the coordinates
+	if (parameters.quantization > 0){
+
+		if (verbosity) cout << "Quantizing coordinates...";
+		point_collection_subset.Quantize(parameters.quantization);
+		if (verbosity) cout << "Done!" << endl;
+
+	}
+
+	// Compute the associated grid
+	if (verbosity) cout << "Gridding points...";
+	point_collection_subset.ComputeGridCoordinates();
+	point_collection_subset.AssignGridCells();
+	if (verbosity) cout << "Done! (" << point_collection_subset.n_rows_ << " rows x " << point_collection_subset.n_cols_ << " columns, " << point_collection_subset.grid_.GetNumberOfBlocks() << " occupied blocks)" << endl;
+
+	// Store the points of neighbouring cells contiguously for the neighbourhood searches
+	if (parameters.spatial_order){
+
+		if (verbosity) cout << "Sorting points by grid cell...";
+		point_collection_subset.SortBySpatialOrder();
+		if (verbosity) cout << "Done!" << endl;
+
+	}
+
+	// Size the neighbourhood reservations and create the seed buffers of the occupied heights
+	double peak_density = statistics->GetPeakDensity();
+	CircularBuffer& local_maxima_buffer = circular_buffer_collection_.GetCircularBuffer(0);
+	circular_buffer_collection_.SetRadiusModel(parameters.radius_model);
+	circular_buffer_collection_.SetLocalMaximaModel(parameters.variable_local_maxima, parameters.local_maxima_model);
+	circular_buffer_collection_.PrepareSeedBuffers(statistics->GetHeightHistogram());
+	GetSegmenter(parameters.segmenter).ReserveScratch(EstimatePointsInBuffer(peak_density, circular_buffer_collection_.GetMaxSeedRadius()));
+	if (verbosity) cout << "Peak density: " << peak_density << " points per square unit" << endl;
+
+	// Find all local maxima
+	if (verbosity) cout << "Finding local maxima...";
+	point_collection_subset.FindLocalMaxima(circular_buffer_collection_, EstimatePointsInBuffer(peak_density, local_maxima_buffer.GetRadius()), max(1u, thread::hardware_concurrency()));
+	if (verbosity) cout << "Done!" << endl;
+	PerfCounters::StopStage("prepare", perf_start);
+	TraceRecorder::AddStage("prepare", t0);
+	metrics.t_prepare = ElapsedSeconds(t0);
+
+	return true;
+}
+
+
+// Estimate the number of points within a circle
+unsigned int SegmentationPipeline::EstimatePointsInBuffer(double peak_density, double radius)
+{
+	// A quarter more than the densest cell, and at least the former fixed reservation of the local maxima search
+	double n_points = 1.25 * peak_density * M_PI * radius * radius;
+
+	return (unsigned int) min(max(n_points, 1000.0), 10000000.0);
+}
+
+
+// Choose the number of segmentation threads
+unsigned int SegmentationPipeline::ChooseSegmentationThreads(const PointCollection& point_collection, const Parameters& parameters)
+{
+	unsigned int n_cores = (parameters.max_segmentation_threads > 0) ? parameters.max_segmentation_threads : max(1u, thread::hardware_concurrency());
+
+	// A wave only finds concurrent seeds if the tile holds many disjoint seed buffers
+	double diameter = 2.0 * circular_buffer_collection_.GetMaxSeedRadius();
+	double n_disjoint = (point_collection.bounding_box_.width + diameter) * (point_collection.bounding_box_.height + diameter) / (diameter * diameter);
+
+	// Small tiles do not amortize the synchronization of the waves
+	double n_threads = min(n_disjoint / 16.0, point_collection.points_.size() / 50000.0);
+
+	return (unsigned int) max(1.0, min(n_threads, double(n_cores)));
+}
+
+
+// Segment a prepared PointCollection and write the results
+void SegmentationPipeline::SegmentPreparedPoints(PointCollection& point_collection_subset, PointCollection& point_collection_unthinned, FileIO& file_io, const Parameters& parameters, Metrics& metrics)
+{
+	bool verbosity = parameters.verbosity;
+	bool thinned = not point_collection_unthinned.points_.empty();
+	circular_buffer_collection_.SetRadiusModel(parameters.radius_model);
+	circular_buffer_collection_.SetLocalMaximaModel(parameters.variable_local_maxima, parameters.local_maxima_model);
+
+	// Write the trees as they are found (thinned trees are only complete once the tree indexes are propagated)
+	unique_ptr<StreamingWriter> streaming_writer;
+
+	if (parameters.stream_output and not thinned){
+
+		file_io.SetOutputCompression(parameters.compression_threads);
+		streaming_writer.reset(new StreamingWriter(point_collection_subset, file_io, hsv_colormap_, parameters.precision, parameters.min_n_points, parameters.min_height, 256));
+
+		if (not streaming_writer->Start()){
+
+			metrics.message = "unable to open output files";
+			return;
+
+		}
+	}
+
+	// Points loaded from the cache are stored in height order
+	if (parameters.spatial_order){
+
+		point_collection_subset.SortBySpatialOrder();
+
+	}
+
+	// Keep the double precision segmentation of the same points for comparison
+	vector<unsigned int> reference_tree_idx;
+
+	if (parameters.verify_quantization and (point_collection_subset.quantization_ > 0)){
+
+		reference_tree_idx = SegmentDoublePrecision(point_collection_subset, parameters);
+
+	}
+
+	// Segment the point cloud
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	unsigned int n_threads = parameters.segmentation_threads;
+
+	if (n_threads == 0){
+
+		n_threads = ChooseSegmentationThreads(point_collection_subset, parameters);
+		if (verbosity) cout << "Segmenting with " << n_threads << " thread(s)" << endl;
+
+	}
+
+	Segmenter& segmenter = GetSegmenter(parameters.segmenter);
+	segmenter.SetParallelism(n_threads, parameters.wavefront_size);
+	SetTreeFilter(segmenter, parameters);
+
+	if (streaming_writer){
+
+		StreamingWriter* writer = streaming_writer.get();
+		segmenter.SetTreeCallback([writer](unsigned int tree_idx, vector<unsigned int>& point_idx){ writer->Push(tree_idx, point_idx); });
+
+	}
+
+	segmenter.SegmentPointCollection(point_collection_subset, circular_buffer_collection_, verbosity);
+	segmenter.SetTreeCallback(Segmenter::TreeCallback());
+	PerfCounters::StopStage("segment", perf_start);
+	TraceRecorder::AddStage("segment", t0);
+	metrics.t_segment = ElapsedSeconds(t0);
+
+	// The streamed trees are read from the points until they are all written
+	if (streaming_writer){
+
+		FinishStreaming(*streaming_writer, file_io, metrics);
+
+	}
+
+	// Store the points in height order for the outputs
+	point_collection_subset.RestoreHeightOrder();
+
+	if (not reference_tree_idx.empty()){
+
+		for (unsigned int j(0); j < reference_tree_idx.size(); j++){
+
+			metrics.n_quantization_mismatches += (reference_tree_idx[j] != point_collection_subset.points_[j].tree_idx);
+
+		}
+
+		cout << "Quantized segmentation: " << metrics.n_quantization_mismatches << " of " << reference_tree_idx.size() << " points differ from the double precision segmentation" << endl;
+
+	}
+
+	// Propagate the tree indexes of the thinned points to all the filtered points
+	PointCollection& point_collection_output = thinned ? point_collection_unthinned : point_collection_subset;
+
+	if (thinned){
+
+		t0 = chrono::steady_clock::now();
+		PerfCounters::StartStage(perf_start);
+		if (verbosity) cout << "Propagating tree indexes...";
+		point_collection_unthinned.CopyTreeIndexesFromNearest(point_collection_subset, max(1u, thread::hardware_concurrency()));
+		if (verbosity) cout << "Done!" << endl;
+		PerfCounters::StopStage("segment", perf_start);
+		TraceRecorder::AddStage("propagate", t0);
+		metrics.t_segment += ElapsedSeconds(t0);
+
+	}
+
+	// Save the segmentation state for later incremental updates
+	if (parameters.save_state){
+
+		SegmentationState state;
+		state.Build(point_collection_output, file_io.GetInputFilepath());
+
+		if (not state.Write(file_io.GetStateFilepath())){
+
+			metrics.success = false;
+			metrics.message = "unable to write state file " + file_io.GetStateFilepath();
+			return;
+
+		}
+	}
+
+	if (not streaming_writer){
+
+		WriteResults(point_collection_output, file_io, parameters, metrics);
+
+	} else if ((parameters.array_output != FileIO::NO_ARRAYS) and metrics.success){
+
+		// The streamed points were colored in the output file only
+		point_collection_output.SetRGBColors(hsv_colormap_);
+		WriteArrays(point_collection_output, streaming_writer->GetTreeCollection(), file_io, parameters, metrics);
+
+	}
+
+	if (parameters.tree_index and metrics.success){
+
+		WriteTreeIndex(point_collection_output, file_io, parameters, metrics);
+
+	}
+
+	if (parameters.octree and metrics.success){
+
+		WriteOctree(point_collection_output, file_io, parameters, metrics);
+
+	}
+
+}
+
+
+// Write the points grouped by tree and the index of the trees
+void SegmentationPipeline::WriteTreeIndex(PointCollection& point_collection, FileIO& file_io, const Parameters& parameters, Metrics& metrics)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	if (parameters.verbosity) cout << "Writing tree index to " << file_io.GetTreeIndexFilepath() << "...";
+	bool success = TreeIndex::Write(point_collection, file_io.GetTreeIndexFilepath());
+	if (parameters.verbosity) cout << "Done!" << endl;
+	PerfCounters::StopStage("write", perf_start);
+	TraceRecorder::AddStage("index", t0);
+	metrics.t_write += ElapsedSeconds(t0);
+
+	if (not success){
+
+		metrics.success = false;
+		metrics.message = "unable to write tree index " + file_io.GetTreeIndexFilepath();
+
+	}
+}
+
+
+// Write the level of detail octree
+void SegmentationPipeline::WriteOctree(PointCollection& point_collection, FileIO& file_io, const Parameters& parameters, Metrics& metrics)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	if (parameters.verbosity) cout << "Writing octree to " << file_io.GetOctreeDirectory() << "...";
+	bool success = OctreeExporter::Write(point_collection, hsv_colormap_, file_io.GetOctreeDirectory(), max(1u, thread::hardware_concurrency()));
+	if (parameters.verbosity) cout << "Done!" << endl;
+	PerfCounters::StopStage("write", perf_start);
+	TraceRecorder::AddStage("octree", t0);
+	metrics.t_write += ElapsedSeconds(t0);
+
+	if (not success){
+
+		metrics.success = false;
+		metrics.message = "unable to write octree " + file_io.GetOctreeDirectory();
+
+	}
+}
+
+
+// Wait for the streamed outputs
+void SegmentationPipeline::FinishStreaming(StreamingWriter& streaming_writer, FileIO& file_io, Metrics& metrics)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	bool success = streaming_writer.Finish();
+	PerfCounters::StopStage("write", perf_start);
+	TraceRecorder::AddStage("write", t0);
+	metrics.t_write = ElapsedSeconds(t0);
+
+	if (not success){
+
+		metrics.message = "unable to write output files";
+		return;
+
+	}
+
+	metrics.n_trees = streaming_writer.GetNumberOfTrees();
+	metrics.o_filepath_points = file_io.GetPointOutputFilepath();
+	metrics.o_filepath_trees = file_io.GetTreeOutputFilepath();
+	metrics.success = true;
+
+}
+
+
+// Write the points and the trees as NumPy arrays
+void SegmentationPipeline::WriteArrays(const PointCollection& point_collection, const TreeCollection& tree_collection, FileIO& file_io, const Parameters& parameters, Metrics& metrics)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	string points_path = file_io.GetArrayOutputPath("_seg", parameters.array_output);
+	string trees_path = file_io.GetArrayOutputPath("_trees", parameters.array_output);
+	if (parameters.verbosity) cout << "Writing arrays to " << points_path << " and " << trees_path << "...";
+	bool success = file_io.WritePointsToNpy(point_collection, parameters.array_output) and file_io.WriteTreesToNpy(tree_collection, parameters.array_output);
+	if (parameters.verbosity) cout << "Done!" << endl;
+	PerfCounters::StopStage("write", perf_start);
+	TraceRecorder::AddStage("arrays", t0);
+	metrics.t_write += ElapsedSeconds(t0);
+
+	if (not success){
+
+		metrics.success = false;
+		metrics.message = "unable to write arrays " + points_path + " and " + trees_path;
+
+	}
+}
+
+
+// Segment a copy of a prepared PointCollection with double precision coordinates
+vector<unsigned int> SegmentationPipeline::SegmentDoublePrecision(PointCollection point_collection, const Parameters& parameters)
+{
+	// Grid and find the local maxima again, as integer gridding can round coordinates located half-way between cells differently
+	point_collection.quantization_ = 0;
+	point_collection.ComputeGridCoordinates();
+	point_collection.AssignGridCells();
+
+	for (unsigned int j(0); j < point_collection.points_.size(); j++){
+
+		point_collection.points_[j].local_maxima_status = 2;
+
+	}
+
+	point_collection.FindLocalMaxima(circular_buffer_collection_, 1000, max(1u, thread::hardware_concurrency()));
+
+	unique_ptr<Segmenter> segmenter = Segmenter::Create(parameters.segmenter);
+	SetTreeFilter(*segmenter, parameters);
+	segmenter->SegmentPointCollection(point_collection, circular_buffer_collection_, false);
+	point_collection.RestoreHeightOrder();
+
+	vector<unsigned int> tree_idx(point_collection.points_.size());
+
+	for (unsigned int j(0); j < point_collection.points_.size(); j++){
+
+		tree_idx[j] = point_collection.points_[j].tree_idx;
+
+	}
+
+	return tree_idx;
+}
+
+
+// Color, extract the trees and write the output files
+void SegmentationPipeline::WriteResults(PointCollection& point_collection, FileIO& file_io, const Parameters& parameters, Metrics& metrics)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	bool verbosity = parameters.verbosity;
+	file_io.SetOutputCompression(parameters.compression_threads);
+
+	// Set RGB color values for each segmented point
+	point_collection.SetRGBColors(hsv_colormap_);
+
+	// Extract individual tree attributes (x, y, h)
+	if (verbosity) cout << "Computing tree attributes...";
+	TreeCollection tree_collection(point_collection, parameters.min_n_points, parameters.min_height);
+	if (verbosity) cout << "Done!" << endl;
+	metrics.n_trees = tree_collection.trees_.size();
+	PerfCounters::StopStage("segment", perf_start);
+	TraceRecorder::AddStage("trees", t0);
+	metrics.t_segment += ElapsedSeconds(t0);
+
+	// Write the segmented points and the tree attributes to .csv
+	t0 = chrono::steady_clock::now();
+	PerfCounters::StartStage(perf_start);
+	file_io.WritePointsToCSV(point_collection, parameters.precision);
+	file_io.WriteTreesToCSV(tree_collection, parameters.precision);
+	PerfCounters::StopStage("write", perf_start);
+	TraceRecorder::AddStage("write", t0);
+	metrics.t_write = ElapsedSeconds(t0);
+
+	metrics.o_filepath_points = file_io.GetPointOutputFilepath();
+	metrics.o_filepath_trees = file_io.GetTreeOutputFilepath();
+	metrics.success = true;
+
+	if (parameters.array_output != FileIO::NO_ARRAYS){
+
+		WriteArrays(point_collection, tree_collection, file_io, parameters, metrics);
+
+	}
+
+}
+
+
+// Update a saved segmentation with re-surveyed points
+SegmentationPipeline::Metrics SegmentationPipeline::UpdateFile(const string& state_filepath, const string& changes_filepath, const Parameters& parameters)
+{
+	Metrics metrics = {false, "", "", "", 0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0};
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+
+	SegmentationState state;
+
+	if (not state.Read(state_filepath)){
+
+		metrics.message = "unable to read state file " + state_filepath;
+		return metrics;
+
+	}
+
+	ifstream i_file(changes_filepath);
+	if (not i_file){
+
+		metrics.message = "unable to open input file " + changes_filepath;
+		return metrics;
+
+	}
+	i_file.close();
+
+	FileIO changes_io(changes_filepath);
+	PointCollection changed_points = changes_io.ReadCsvPoints();
+	metrics.n_points = changed_points.points_.size();
+	PerfCounters::StopStage("read", perf_start);
+	TraceRecorder::AddStage("read", t0);
+	metrics.t_read = ElapsedSeconds(t0);
+
+	// Re-segment the changed area
+	t0 = chrono::steady_clock::now();
+	PerfCounters::StartStage(perf_start);
+	vector<unsigned int> keep_classes = parameters.keep_classes;
+	circular_buffer_collection_.SetRadiusModel(parameters.radius_model);
+	circular_buffer_collection_.SetLocalMaximaModel(parameters.variable_local_maxima, parameters.local_maxima_model);
+	double halo = max(double(max_radius_), circular_buffer_collection_.GetMaxSeedRadius());
+	if (parameters.variable_local_maxima) halo = max(halo, CircularBufferCollection::GetMaxRadius(parameters.local_maxima_model));
+	Segmenter& segmenter = GetSegmenter(parameters.segmenter);
+	segmenter.SetParallelism(parameters.segmentation_threads, parameters.wavefront_size);
+	segmenter.SetTreeFilter(0, 0);
+	state.Update(changed_points, keep_classes, halo, circular_buffer_collection_, segmenter, parameters.verbosity);
+	PerfCounters::StopStage("segment", perf_start);
+	TraceRecorder::AddStage("segment", t0);
+	metrics.t_segment = ElapsedSeconds(t0);
+
+	if (not state.Write(state_filepath)){
+
+		metrics.message = "unable to write state file " + state_filepath;
+		return metrics;
+
+	}
+
+	// Overwrite the outputs of the initial segmentation
+	PointCollection point_collection = state.GetPointCollection();
+	metrics.n_filtered = point_collection.points_.size();
+	FileIO file_io(state.GetInputFilepath());
+	WriteResults(point_collection, file_io, parameters, metrics);
+
+	if (parameters.tree_index and metrics.success){
+
+		WriteTreeIndex(point_collection, file_io, parameters, metrics);
+
+	}
+
+	if (parameters.octree and metrics.success){
+
+		WriteOctree(point_collection, file_io, parameters, metrics);
+
+	}
+
+	metrics.t_total = metrics.t_read + metrics.t_segment + metrics.t_write;
+
+	return metrics;
+}
+
+
+// Get the Segmenter of an algorithm
+Segmenter& SegmentationPipeline::GetSegmenter(Segmenter::Type type)
+{
+	if ((not segmenter_) or (segmenter_type_ != type)){
+
+		segmenter_ = Segmenter::Create(type);
+		segmenter_type_ = type;
+
+	}
+
+	return *segmenter_;
+}
+
+
+// Constructor
+SegmentationPipeline::SegmentationPipeline(unsigned int scaling_factor, vector<unsigned int> radius_list) : circular_buffer_collection_(radius_list, scaling_factor)
+{
+	scaling_factor_ = scaling_factor;
+	max_radius_ = 0;
+	segmenter_type_ = Segmenter::SNC;
+
+	for (unsigned int j(0); j < radius_list.size(); j++){
+
+		max_radius_ = max(max_radius_, radius_list[j]);
+
+	}
+
+	// Set the 16 bit hsv colormap
+	hsv_colormap_.push_back({32767,      0,      0});
+	hsv_colormap_.push_back({32767,  19660,      0});
+	hsv_colormap_.push_back({26214,  32767,      0});
+	hsv_colormap_.push_back({ 6553,  32767,      0});
+	hsv_colormap_.push_back({    0,  32767,  13107});
+	hsv_colormap_.push_back({    0,  32767,  32767});
+	hsv_colormap_.push_back({    0,  13107,  32767});
+	hsv_colormap_.push_back({ 6553,      0,  32767});
+	hsv_colormap_.push_back({26214,      0,  32767});
+	hsv_colormap_.push_back({32767,      0,  19660});
+
+}
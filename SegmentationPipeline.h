@@ -0,0 +1,255 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class chains the processing stages (reading, filtering, gridding, segmentation, tree extraction and writing)
+ * applied to a single data source. The circular buffers and the segmentation scratch memory are kept between runs,
+ * so that a single SegmentationPipeline can process many data sources without re-allocating them.
+ *
+ */
+
+#ifndef SEGMENTATIONPIPELINE_H
+#define SEGMENTATIONPIPELINE_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include "FileIO.h"
+#include "PointCollection.h"
+#include "Segmenter.h"
+#include "CircularBufferCollection.h"
+#include "SegmentationState.h"
+#include "StreamingWriter.h"
+#include "IngestStatistics.h"
+
+class SegmentationPipeline {
+
+public:
+
+	/**
+	 * Parameters of the processing stages.
+	 *
+	 */
+	struct Parameters {
+
+		std::vector<unsigned int> keep_classes; // Classes kept for the segmentation
+		unsigned int min_n_points; // Minimum number of points in a tree
+		unsigned int min_height; // Minimum height of a tree
+		unsigned int precision; // Decimal precision of the output files
+		bool verbosity; // If true, prints information about each processing stage
+		bool save_state; // If true, writes the SegmentationState next to the input file
+		bool use_cache; // If true, reuses (or creates) the cache of prepared points next to the input file
+		unsigned int segmentation_threads; // Number of threads classifying non-overlapping seeds concurrently (0 = chosen from the size of the point cloud)
+		unsigned int max_segmentation_threads; // Largest number of threads chosen automatically (0 = number of cores)
+		unsigned int wavefront_size; // Number of candidate seeds per wave (0 = 4 times the number of threads)
+		FileIO::RegionOfInterest region_of_interest; // Region read from chunked point files (classes are set to keep_classes)
+		unsigned int quantization; // Number of quantization units per coordinate unit (0 = double precision coordinates)
+		bool verify_quantization; // If true, the quantized segmentation is compared to the double precision segmentation
+		CircularBufferCollection::RadiusModel radius_model; // Radius of the circular buffer of a seed as a function of its height
+		bool variable_local_maxima; // If true, the local maxima are searched within a radius depending on their height (see local_maxima_model)
+		CircularBufferCollection::RadiusModel local_maxima_model; // Radius of the local maxima search as a function of the height of a point
+		bool stream_output; // If true, the trees are written while the segmentation is running (points are grouped by tree)
+		unsigned int compression_threads; // Number of threads compressing the output files in gzip blocks (0 = uncompressed output)
+		Segmenter::Type segmenter; // Segmentation algorithm
+		bool tree_index; // If true, also writes the points grouped by tree with an index of the trees (see TreeIndex)
+		double thinning_voxel_size; // Side of the voxels of which only the highest point is segmented, the other points taking the tree of their nearest segmented point (0 = no thinning)
+		FileIO::ArrayOutput array_output; // NumPy arrays of the points and trees written in addition to the csv files (.npy files or .npz archives)
+		bool octree; // If true, also writes a level of detail octree of the segmented points for viewers (see OctreeExporter)
+		bool spatial_order; // If true, the points are stored in the Morton order of their grid cells while they are searched (the outputs are unchanged)
+
+	};
+
+	/**
+	 * Metrics describing a processing run.
+	 *
+	 */
+	struct Metrics {
+
+		bool success;
+		std::string message;
+		std::string o_filepath_points;
+		std::string o_filepath_trees;
+		unsigned int n_points;
+		unsigned int n_filtered;
+		unsigned int n_trees;
+		double t_read; // Elapsed time (in seconds) of each stage
+		double t_prepare;
+		double t_segment;
+		double t_write;
+		double t_total;
+		unsigned int n_quantization_mismatches; // Number of points assigned to a different tree by the double precision path
+
+	};
+
+	/**
+	 * Returns the default Parameters.
+	 *
+	 */
+	static Parameters DefaultParameters();
+
+	/**
+	 * Reads, segments and writes the specified csv (optionally gzip compressed) or chunked point (.tsp) file. Only the points of chunked point files
+	 * located within the region of interest of the Parameters are read.
+	 *
+	 * @param  i_filepath The input file path.
+	 * @param  parameters The Parameters used for this run.
+	 * @return Returns the Metrics of the run.
+	 */
+	Metrics ProcessFile(const std::string& i_filepath, const Parameters& parameters);
+
+	/**
+	 * Parses, segments and writes the contents of a csv file loaded in memory. If the cache is enabled, the prepared
+	 * points are loaded from the cache file when it matches the buffer contents and the parameters, or saved to it otherwise.
+	 *
+	 * @param  buffer The csv file contents.
+	 * @param  file_io A reference to the FileIO of the input file.
+	 * @param  parameters The Parameters used for this run.
+	 * @param  metrics A reference to the Metrics updated with the run statistics.
+	 */
+	void ProcessBuffer(const std::vector<char>& buffer, FileIO& file_io, const Parameters& parameters, Metrics& metrics);
+
+	/**
+	 * Segments the specified PointCollection and writes the results using the output paths of the specified FileIO.
+	 *
+	 * @param  point_collection A reference to the PointCollection containing all the points of the data source.
+	 * @param  statistics A pointer to the IngestStatistics collected while the points were read (NULL = computed from the points).
+	 * @param  file_io A reference to the FileIO used to write the output files.
+	 * @param  parameters The Parameters used for this run.
+	 * @param  metrics A reference to the Metrics updated with the run statistics.
+	 */
+	void ProcessPoints(PointCollection& point_collection, const IngestStatistics* statistics, FileIO& file_io, const Parameters& parameters, Metrics& metrics);
+
+	/**
+	 * Updates a saved segmentation with re-surveyed points. Only the trees located near the changed area are re-segmented.
+	 * The output files of the initial segmentation and the state file are overwritten with the updated results.
+	 *
+	 * @param  state_filepath The path of the SegmentationState file.
+	 * @param  changes_filepath The path of a csv file containing the re-surveyed points.
+	 * @param  parameters The Parameters used for this run.
+	 * @return Returns the Metrics of the run.
+	 */
+	Metrics UpdateFile(const std::string& state_filepath, const std::string& changes_filepath, const Parameters& parameters);
+
+	SegmentationPipeline(unsigned int scaling_factor, std::vector<unsigned int> radius_list); // Constructor
+	~SegmentationPipeline(){}; // Destructor
+
+private:
+
+	/**
+	 * Circular buffers created once and shared by all runs.
+	 *
+	 */
+	CircularBufferCollection circular_buffer_collection_;
+
+	/**
+	 * Segmenter (and its scratch memory) shared by all runs, re-created when the algorithm changes.
+	 *
+	 */
+	std::unique_ptr<Segmenter> segmenter_;
+	Segmenter::Type segmenter_type_;
+	
+	/**
+	 * Returns the Segmenter of the specified Type.
+	 *
+	 */
+	Segmenter& GetSegmenter(Segmenter::Type type);
+
+	/**
+	 * 16 bit hsv colormap used to color the segmented points.
+	 *
+	 */
+	std::vector<std::array<unsigned int, 3>> hsv_colormap_;
+
+	unsigned int scaling_factor_;
+
+	/**
+	 * Largest radius of the fixed circular buffers. The halo around changed areas also covers the largest seed buffer.
+	 *
+	 */
+	unsigned int max_radius_;
+
+	/**
+	 * Filters, sorts by height, thins, grids and finds the local maxima of a PointCollection. The reservations and the bounding
+	 * box are taken from the IngestStatistics of the points (NULL = computed from the points). When the points are thinned,
+	 * the filtered points are moved to point_collection_unthinned (which is left empty otherwise).
+	 *
+	 * @return Returns false if no point is left after filtering.
+	 */
+	bool PreparePoints(PointCollection& point_collection, const IngestStatistics* statistics, PointCollection& point_collection_subset, PointCollection& point_collection_unthinned, const Parameters& parameters, Metrics& metrics);
+	
+	/**
+	 * Estimates the number of Points within a circle, from the peak density of the input.
+	 *
+	 */
+	static unsigned int EstimatePointsInBuffer(double peak_density, double radius);
+	
+	/**
+	 * Chooses the number of segmentation threads from the extent and the number of points of a prepared PointCollection.
+	 *
+	 */
+	unsigned int ChooseSegmentationThreads(const PointCollection& point_collection, const Parameters& parameters);
+
+	/**
+	 * Segments a prepared PointCollection and writes the results. If point_collection_unthinned is not empty, the tree
+	 * indexes are propagated to its points, which are written instead of the thinned points.
+	 *
+	 */
+	void SegmentPreparedPoints(PointCollection& point_collection_subset, PointCollection& point_collection_unthinned, FileIO& file_io, const Parameters& parameters, Metrics& metrics);
+
+	/**
+	 * Segments a copy of a prepared quantized PointCollection with double precision coordinates.
+	 *
+	 * @return Returns the tree index of each Point.
+	 */
+	std::vector<unsigned int> SegmentDoublePrecision(PointCollection point_collection, const Parameters& parameters);
+
+	/**
+	 * Colors, extracts the trees and writes the output files of a segmented PointCollection.
+	 *
+	 */
+	void WriteResults(PointCollection& point_collection, FileIO& file_io, const Parameters& parameters, Metrics& metrics);
+
+	/**
+	 * Writes the points grouped by tree and the TreeIndex of a segmented PointCollection.
+	 *
+	 */
+	void WriteTreeIndex(PointCollection& point_collection, FileIO& file_io, const Parameters& parameters, Metrics& metrics);
+
+	/**
+	 * Writes the points and the trees as NumPy arrays. The points must be colored.
+	 *
+	 */
+	void WriteArrays(const PointCollection& point_collection, const TreeCollection& tree_collection, FileIO& file_io, const Parameters& parameters, Metrics& metrics);
+
+	/**
+	 * Writes the level of detail octree of a segmented PointCollection.
+	 *
+	 */
+	void WriteOctree(PointCollection& point_collection, FileIO& file_io, const Parameters& parameters, Metrics& metrics);
+
+	/**
+	 * Waits until a StreamingWriter has written all the trees and updates the Metrics.
+	 *
+	 */
+	void FinishStreaming(StreamingWriter& streaming_writer, FileIO& file_io, Metrics& metrics);
+
+};
+
+#endif
@@ -0,0 +1,416 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#include "SegmentationServer.h"
+#include "SegmentationPipeline.h"
+#include "FileIO.h"
+#include "PointCollection.h"
+
+using namespace std;
+
+
+#ifndef _WIN32
+
+// Read a single line from a socket
+static bool ReadLine(int fd, string& line)
+{
+	line.clear();
+	char c;
+
+	while (read(fd, &c, 1) == 1){
+
+		if (c == '\n'){
+
+			return true;
+
+		}
+
+		if (c != '\r'){
+
+			line.push_back(c);
+
+		}
+
+	}
+
+	return not line.empty();
+}
+
+
+// Write a full line to a socket
+static void WriteLine(int fd, const string& line)
+{
+	string data = line + "\n";
+	size_t n_written = 0;
+
+	while (n_written < data.size()){
+
+		ssize_t n = send(fd, data.data() + n_written, data.size() - n_written, MSG_NOSIGNAL); // Do not raise SIGPIPE if the client left
+
+		if (n <= 0){
+
+			return;
+
+		}
+
+		n_written += n;
+	}
+}
+
+
+// Open a Unix domain socket address
+static bool SetSocketAddress(const string& socket_path, sockaddr_un& address)
+{
+	if (socket_path.size() >= sizeof(address.sun_path)){
+
+		cerr << "FAILURE: socket path is too long " << socket_path << endl;
+		return false;
+
+	}
+
+	address = sockaddr_un();
+	address.sun_family = AF_UNIX;
+	socket_path.copy(address.sun_path, socket_path.size());
+
+	return true;
+}
+
+#endif
+
+
+// Parse an unsigned integer argument value
+static bool ParseUnsigned(const string& value, unsigned int& result)
+{
+	char* end;
+	unsigned long parsed = strtoul(value.c_str(), &end, 10);
+	
+	if (value.empty() or (*end != '\0')){
+		
+		return false;
+		
+	}
+	
+	result = (unsigned int) parsed;
+	
+	return true;
+}
+
+
+// Listen for requests and dispatch them to the workers
+int SegmentationServer::Run()
+{
+	#ifdef _WIN32
+
+		cerr << "FAILURE: daemon mode is not supported on this platform" << endl;
+		return 1;
+
+	#else
+
+		sockaddr_un address;
+
+		if (not SetSocketAddress(socket_path_, address)){
+
+			return 1;
+
+		}
+
+		int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(socket_path_.c_str()); // Remove a stale socket left by a previous run
+
+		if ((server_fd < 0) or (bind(server_fd, (sockaddr*) &address, sizeof(address)) != 0) or (listen(server_fd, 64) != 0)){
+
+			cerr << "FAILURE: unable to listen on socket " << socket_path_ << endl;
+			return 1;
+
+		}
+
+		cout << "Listening on " << socket_path_ << " with " << n_workers_ << " worker(s)" << endl;
+
+		// Start the worker pool
+		vector<thread> workers;
+		for (unsigned int j(0); j < n_workers_; j++){
+
+			workers.push_back(thread(&SegmentationServer::WorkerLoop, this, j));
+
+		}
+
+		string request;
+		bool running(true);
+
+		while (running){
+
+			int client_fd = accept(server_fd, NULL, NULL);
+
+			if (client_fd < 0){
+
+				continue;
+
+			}
+
+			if (not ReadLine(client_fd, request)){
+
+				close(client_fd);
+				continue;
+
+			}
+
+			if (request == "PING"){
+
+				WriteLine(client_fd, "OK");
+				close(client_fd);
+
+			} else if (request == "SHUTDOWN"){
+
+				WriteLine(client_fd, "OK");
+				close(client_fd);
+				running = false;
+
+			} else {
+
+				lock_guard<mutex> lock(jobs_mutex_);
+				jobs_.push_back({client_fd, request});
+				jobs_condition_.notify_one();
+
+			}
+
+		}
+
+		// Let the workers finish the pending jobs
+		{
+			lock_guard<mutex> lock(jobs_mutex_);
+			stop_ = true;
+		}
+		jobs_condition_.notify_all();
+
+		for (unsigned int j(0); j < workers.size(); j++){
+
+			workers[j].join();
+
+		}
+
+		close(server_fd);
+		unlink(socket_path_.c_str());
+
+		cout << "Server stopped" << endl;
+
+		return 0;
+
+	#endif
+}
+
+
+// Process jobs from the queue
+void SegmentationServer::WorkerLoop(unsigned int worker_idx)
+{
+	#ifndef _WIN32
+
+		// Each worker keeps its own pipeline (circular buffers and segmentation scratch memory)
+		SegmentationPipeline pipeline(scaling_factor_, radius_list_);
+
+		while (true){
+
+			Job job;
+
+			{
+				unique_lock<mutex> lock(jobs_mutex_);
+				jobs_condition_.wait(lock, [this]{ return stop_ or not jobs_.empty(); });
+
+				if (jobs_.empty()){
+
+					return; // Stopped and no pending job
+
+				}
+
+				job = jobs_.front();
+				jobs_.pop_front();
+			}
+
+			WriteLine(job.client_fd, ProcessRequest(pipeline, job.request, worker_idx));
+			close(job.client_fd);
+
+		}
+
+	#endif
+}
+
+
+// Parse and process a SEGMENT request
+string SegmentationServer::ProcessRequest(SegmentationPipeline& pipeline, const string& request, unsigned int worker_idx)
+{
+	istringstream tokens(request);
+	string command, source, token, o_filepath;
+	SegmentationPipeline::Parameters parameters = parameters_;
+	parameters.verbosity = false;
+
+	tokens >> command >> source;
+
+	if ((command != "SEGMENT") or source.empty()){
+
+		return "ERROR unknown request";
+
+	}
+
+	// Parse the key=value overrides
+	while (tokens >> token){
+
+		size_t sep = token.find('=');
+
+		if (sep == string::npos){
+
+			return "ERROR malformed argument " + token;
+
+		}
+
+		string key = token.substr(0, sep);
+		string value = token.substr(sep + 1);
+
+		bool valid(true);
+
+		if (key == "output"){
+
+			o_filepath = value;
+
+		} else if (key == "min_n_points"){
+
+			valid = ParseUnsigned(value, parameters.min_n_points);
+
+		} else if (key == "min_height"){
+
+			valid = ParseUnsigned(value, parameters.min_height);
+
+		} else if (key == "precision"){
+
+			valid = ParseUnsigned(value, parameters.precision);
+
+		} else {
+
+			return "ERROR unknown argument " + key;
+
+		}
+
+		if (not valid){
+
+			return "ERROR invalid value for " + key;
+
+		}
+	}
+
+	SegmentationPipeline::Metrics metrics;
+
+	if (source.compare(0, 4, "shm:") == 0){
+
+		if (o_filepath.empty()){
+
+			return "ERROR shared memory jobs require an output=<path.csv> argument";
+
+		}
+
+		metrics = {false, "", "", "", 0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0};
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		FileIO file_io(o_filepath);
+		PointCollection point_collection;
+
+		if (not file_io.ReadSharedMemoryPoints(source.substr(4), point_collection)){
+
+			return "ERROR unable to read shared memory object " + source.substr(4);
+
+		}
+
+		metrics.t_read = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+		pipeline.ProcessPoints(point_collection, NULL, file_io, parameters, metrics);
+		metrics.t_total = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+	} else {
+
+		metrics = pipeline.ProcessFile(source, parameters);
+
+	}
+
+	if (not metrics.success){
+
+		return "ERROR " + metrics.message;
+
+	}
+
+	ostringstream response;
+	response << fixed << setprecision(4);
+	response << "OK"
+	<< " worker=" << worker_idx
+	<< " n_points=" << metrics.n_points
+	<< " n_filtered=" << metrics.n_filtered
+	<< " n_trees=" << metrics.n_trees
+	<< " t_read=" << metrics.t_read
+	<< " t_prepare=" << metrics.t_prepare
+	<< " t_segment=" << metrics.t_segment
+	<< " t_write=" << metrics.t_write
+	<< " t_total=" << metrics.t_total
+	<< " points=" << metrics.o_filepath_points
+	<< " trees=" << metrics.o_filepath_trees;
+
+	return response.str();
+}
+
+
+// Send a request to a running server
+int SegmentationServer::Submit(const string& socket_path, const string& request)
+{
+	#ifdef _WIN32
+
+		cerr << "FAILURE: daemon mode is not supported on this platform" << endl;
+		return 1;
+
+	#else
+
+		sockaddr_un address;
+
+		if (not SetSocketAddress(socket_path, address)){
+
+			return 1;
+
+		}
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if ((fd < 0) or (connect(fd, (sockaddr*) &address, sizeof(address)) != 0)){
+
+			cerr << "FAILURE: unable to connect to socket " << socket_path << endl;
+			return 1;
+
+		}
+
+		string response;
+		WriteLine(fd, request);
+		ReadLine(fd, response);
+		close(fd);
+
+		cout << response << endl;
+
+		return (response.compare(0, 2, "OK") == 0) ? 0 : 1;
+
+	#endif
+}
+
+
+// Constructor
+SegmentationServer::SegmentationServer(string socket_path, unsigned int n_workers, SegmentationPipeline::Parameters parameters, unsigned int scaling_factor, vector<unsigned int> radius_list)
+{
+	socket_path_ = socket_path;
+	n_workers_ = (n_workers > 0) ? n_workers : 1;
+	parameters_ = parameters;
+	scaling_factor_ = scaling_factor;
+	radius_list_ = radius_list;
+	stop_ = false;
+
+}
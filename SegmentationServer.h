@@ -0,0 +1,125 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class implements a local segmentation daemon listening on a Unix domain socket.
+ *
+ * Each connection carries a single request line and receives a single response line:
+ * - SEGMENT <input.csv> [key=value ...]
+ * - SEGMENT shm:<name> output=<output.csv> [key=value ...]
+ * - PING
+ * - SHUTDOWN
+ *
+ * Supported keys are min_n_points, min_height and precision. Jobs are processed by a persistent pool of workers,
+ * each owning a SegmentationPipeline whose circular buffers and scratch memory are reused from one job to the next.
+ * The response is either "OK key=value ..." with the job metrics or "ERROR <message>".
+ *
+ */
+
+#ifndef SEGMENTATIONSERVER_H
+#define SEGMENTATIONSERVER_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "SegmentationPipeline.h"
+
+class SegmentationServer {
+
+public:
+
+	/**
+	 * Listens on the socket and processes jobs until a SHUTDOWN request is received.
+	 *
+	 * @return Returns 0 on a clean shutdown, 1 if the socket could not be created.
+	 */
+	int Run();
+
+	/**
+	 * Sends a request line to a running server and prints the response.
+	 *
+	 * @param  socket_path The path of the Unix domain socket.
+	 * @param  request The request line.
+	 * @return Returns 0 if the response starts with OK, 1 otherwise.
+	 */
+	static int Submit(const std::string& socket_path, const std::string& request);
+
+	/**
+	 * Creates a segmentation server.
+	 *
+	 * @param  socket_path The path of the Unix domain socket.
+	 * @param  n_workers The number of worker threads.
+	 * @param  parameters The default Parameters, which can be overridden per job.
+	 * @param  scaling_factor The coordinate scaling factor used to create the circular buffers.
+	 * @param  radius_list The radius of the circular buffers.
+	 */
+	SegmentationServer(std::string socket_path, unsigned int n_workers, SegmentationPipeline::Parameters parameters, unsigned int scaling_factor, std::vector<unsigned int> radius_list); // Constructor
+	~SegmentationServer(){}; // Destructor
+
+private:
+
+	/**
+	 * A request waiting to be processed, together with the connection on which to answer.
+	 *
+	 */
+	struct Job {
+
+		int client_fd;
+		std::string request;
+
+	};
+
+	/**
+	 * Processes jobs from the queue until the server stops.
+	 *
+	 * @param  worker_idx The index of the worker.
+	 */
+	void WorkerLoop(unsigned int worker_idx);
+
+	/**
+	 * Parses and processes a SEGMENT request.
+	 *
+	 * @param  pipeline A reference to the SegmentationPipeline of the worker.
+	 * @param  request The request line.
+	 * @param  worker_idx The index of the worker.
+	 * @return Returns the response line.
+	 */
+	std::string ProcessRequest(SegmentationPipeline& pipeline, const std::string& request, unsigned int worker_idx);
+
+	std::string socket_path_;
+	unsigned int n_workers_;
+	SegmentationPipeline::Parameters parameters_;
+	unsigned int scaling_factor_;
+	std::vector<unsigned int> radius_list_;
+
+	/**
+	 * Pending jobs.
+	 *
+	 */
+	std::deque<Job> jobs_;
+	std::mutex jobs_mutex_;
+	std::condition_variable jobs_condition_;
+	bool stop_;
+
+};
+
+#endif
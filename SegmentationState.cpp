@@ -0,0 +1,354 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "SegmentationState.h"
+#include "PointCollection.h"
+#include "Segmenter.h"
+#include "CircularBuffer.h"
+#include "CircularBufferCollection.h"
+
+using namespace std;
+
+
+// File signature
+static const char state_magic[8] = {'T', 'S', 'S', 'T', 'A', 'T', 'E', '1'};
+
+
+// Write a value to a binary stream
+template <typename T> static void WriteValue(ofstream& o_file, const T& value)
+{
+	o_file.write((const char*) &value, sizeof(T));
+}
+
+
+// Read a value from a binary stream
+template <typename T> static void ReadValue(ifstream& i_file, T& value)
+{
+	i_file.read((char*) &value, sizeof(T));
+}
+
+
+string SegmentationState::GetInputFilepath()
+{
+	return i_filepath_;
+}
+
+
+// Create the state from a segmented PointCollection
+void SegmentationState::Build(PointCollection& point_collection, const string& i_filepath)
+{
+	i_filepath_ = i_filepath;
+	x_origin_ = point_collection.x_origin_;
+	y_origin_ = point_collection.y_origin_;
+	coordinate_scaling_ = point_collection.coordinate_scaling_;
+	point_collection_.points_ = point_collection.points_;
+
+	IndexTrees();
+}
+
+
+// Group the points by tree and compute the extent of each tree
+void SegmentationState::IndexTrees()
+{
+	vector<PointCollection::Point>& points = point_collection_.points_;
+
+	// Points keep their height order within each tree
+	stable_sort(points.begin(), points.end(), [](const PointCollection::Point& a, const PointCollection::Point& b) { return a.tree_idx < b.tree_idx; });
+
+	trees_.clear();
+
+	for (unsigned int j(0); j < points.size(); j++){
+
+		if (trees_.empty() or (trees_.back().tree_idx != points[j].tree_idx)){
+
+			Tree tree = {points[j].tree_idx, j, 0, points[j].x, points[j].x, points[j].y, points[j].y};
+			trees_.push_back(tree);
+
+		}
+
+		Tree& tree = trees_.back();
+		tree.n_points++;
+		tree.x_min = min(tree.x_min, points[j].x);
+		tree.x_max = max(tree.x_max, points[j].x);
+		tree.y_min = min(tree.y_min, points[j].y);
+		tree.y_max = max(tree.y_max, points[j].y);
+
+	}
+}
+
+
+// Write the state to a binary file
+bool SegmentationState::Write(const string& filepath)
+{
+	ofstream o_file(filepath, ios::binary);
+
+	if (not o_file){
+
+		cerr << "FAILURE: unable to open output file " << filepath << endl;
+		return false;
+
+	}
+
+	o_file.write(state_magic, sizeof(state_magic));
+	WriteValue(o_file, x_origin_);
+	WriteValue(o_file, y_origin_);
+	WriteValue(o_file, (uint32_t) coordinate_scaling_);
+	WriteValue(o_file, (uint32_t) i_filepath_.size());
+	o_file.write(i_filepath_.data(), i_filepath_.size());
+
+	// Points
+	const vector<PointCollection::Point>& points = point_collection_.points_;
+	WriteValue(o_file, (uint64_t) points.size());
+
+	for (unsigned int j(0); j < points.size(); j++){
+
+		WriteValue(o_file, points[j].x);
+		WriteValue(o_file, points[j].y);
+		WriteValue(o_file, points[j].z);
+		WriteValue(o_file, (uint32_t) points[j].classification);
+		WriteValue(o_file, (uint32_t) points[j].tree_idx);
+
+	}
+
+	// Trees
+	WriteValue(o_file, (uint64_t) trees_.size());
+
+	for (unsigned int j(0); j < trees_.size(); j++){
+
+		WriteValue(o_file, (uint32_t) trees_[j].tree_idx);
+		WriteValue(o_file, (uint32_t) trees_[j].offset);
+		WriteValue(o_file, (uint32_t) trees_[j].n_points);
+		WriteValue(o_file, trees_[j].x_min);
+		WriteValue(o_file, trees_[j].x_max);
+		WriteValue(o_file, trees_[j].y_min);
+		WriteValue(o_file, trees_[j].y_max);
+
+	}
+
+	return bool(o_file);
+}
+
+
+// Read the state from a binary file
+bool SegmentationState::Read(const string& filepath)
+{
+	ifstream i_file(filepath, ios::binary);
+	char magic[sizeof(state_magic)];
+
+	if (not (i_file and i_file.read(magic, sizeof(magic)) and (memcmp(magic, state_magic, sizeof(magic)) == 0))){
+
+		cerr << "FAILURE: invalid state file " << filepath << endl;
+		return false;
+
+	}
+
+	uint32_t coordinate_scaling, path_length;
+	ReadValue(i_file, x_origin_);
+	ReadValue(i_file, y_origin_);
+	ReadValue(i_file, coordinate_scaling);
+	ReadValue(i_file, path_length);
+	coordinate_scaling_ = coordinate_scaling;
+	i_filepath_.resize(path_length);
+	i_file.read(&i_filepath_[0], path_length);
+
+	// Points
+	uint64_t n_points;
+	ReadValue(i_file, n_points);
+
+	PointCollection::Point point = {0.0, 0.0, 0.0, 0, 0, 0, 0, 0, 2, false, {0,0,0}};
+	point_collection_.points_.clear();
+	point_collection_.points_.reserve(n_points);
+
+	for (uint64_t j(0); (j < n_points) and i_file; j++){
+
+		uint32_t classification, tree_idx;
+		ReadValue(i_file, point.x);
+		ReadValue(i_file, point.y);
+		ReadValue(i_file, point.z);
+		ReadValue(i_file, classification);
+		ReadValue(i_file, tree_idx);
+		point.classification = classification;
+		point.tree_idx = tree_idx;
+		point.segmentation_status = true;
+		point_collection_.points_.push_back(point);
+
+	}
+
+	// Trees
+	uint64_t n_trees;
+	ReadValue(i_file, n_trees);
+	trees_.clear();
+
+	for (uint64_t j(0); (j < n_trees) and i_file; j++){
+
+		uint32_t tree_idx, offset, n_tree_points;
+		Tree tree;
+		ReadValue(i_file, tree_idx);
+		ReadValue(i_file, offset);
+		ReadValue(i_file, n_tree_points);
+		ReadValue(i_file, tree.x_min);
+		ReadValue(i_file, tree.x_max);
+		ReadValue(i_file, tree.y_min);
+		ReadValue(i_file, tree.y_max);
+		tree.tree_idx = tree_idx;
+		tree.offset = offset;
+		tree.n_points = n_tree_points;
+		trees_.push_back(tree);
+
+	}
+
+	if (not i_file){
+
+		cerr << "FAILURE: truncated state file " << filepath << endl;
+		return false;
+
+	}
+
+	return true;
+}
+
+
+// Re-segment the trees located near the changed points
+void SegmentationState::Update(PointCollection& changed_points, vector<unsigned int>& keep_classes, double halo, CircularBufferCollection& circular_buffer_collection, Segmenter& segmenter, bool verbosity)
+{
+	if (changed_points.points_.empty()){
+
+		return;
+
+	}
+
+	// Bounding box of the changed area
+	double x_min(changed_points.points_[0].x), x_max(x_min), y_min(changed_points.points_[0].y), y_max(y_min);
+
+	for (unsigned int j(0); j < changed_points.points_.size(); j++){
+
+		x_min = min(x_min, changed_points.points_[j].x);
+		x_max = max(x_max, changed_points.points_[j].x);
+		y_min = min(y_min, changed_points.points_[j].y);
+		y_max = max(y_max, changed_points.points_[j].y);
+
+	}
+
+	// Split the points between the kept trees and the area to re-segment
+	vector<PointCollection::Point>& points = point_collection_.points_;
+	PointCollection kept, area;
+	vector<unsigned int> freed_idx;
+	unsigned int next_idx(0), n_removed(0);
+
+	for (unsigned int j(0); j < trees_.size(); j++){
+
+		const Tree& tree = trees_[j];
+		next_idx = max(next_idx, tree.tree_idx + 1);
+
+		bool invalid = (tree.x_max >= x_min - halo) and (tree.x_min <= x_max + halo) and (tree.y_max >= y_min - halo) and (tree.y_min <= y_max + halo);
+
+		for (unsigned int k(tree.offset); k < tree.offset + tree.n_points; k++){
+
+			if (not invalid){
+
+				kept.points_.push_back(points[k]);
+
+			} else if ((points[k].x >= x_min) and (points[k].x <= x_max) and (points[k].y >= y_min) and (points[k].y <= y_max)){
+
+				n_removed++; // Replaced by the changed points
+
+			} else {
+
+				area.points_.push_back(points[k]);
+
+			}
+		}
+
+		if (invalid){
+
+			freed_idx.push_back(tree.tree_idx);
+
+		}
+	}
+
+	PointCollection new_points = changed_points.FilterPointsByClass(keep_classes);
+	area.points_.insert(area.points_.end(), new_points.points_.begin(), new_points.points_.end());
+
+	unsigned int n_new_trees(0);
+
+	if (not area.points_.empty()){
+
+		// Reset the segmentation attributes
+		for (unsigned int j(0); j < area.points_.size(); j++){
+
+			area.points_[j].tree_idx = 0;
+			area.points_[j].local_maxima_status = 2;
+			area.points_[j].segmentation_status = false;
+
+		}
+
+		area.coordinate_scaling_ = coordinate_scaling_;
+		area.SortByZ();
+		area.ComputePointIndexes();
+		area.ComputeBoundingBox();
+
+		// Align the grid of the area with the grid of the initial segmentation
+		double scaling = double(coordinate_scaling_);
+		double x_origin = x_origin_ + floor((area.bounding_box_.x_min - x_origin_) * scaling) / scaling;
+		double y_origin = y_origin_ + floor((area.bounding_box_.y_min - y_origin_) * scaling) / scaling;
+		area.ComputeGridCoordinates(x_origin, y_origin);
+		area.AssignGridCells();
+		area.FindLocalMaxima(circular_buffer_collection, 1000, max(1u, thread::hardware_concurrency()));
+		segmenter.SegmentPointCollection(area, circular_buffer_collection, false);
+
+		// Assign the freed tree indexes first, then new ones
+		sort(freed_idx.begin(), freed_idx.end());
+		vector<unsigned int> idx_map;
+
+		for (unsigned int j(0); j < area.points_.size(); j++){
+
+			unsigned int tree_idx = area.points_[j].tree_idx;
+
+			while (idx_map.size() <= tree_idx){
+
+				idx_map.push_back((idx_map.size() < freed_idx.size()) ? freed_idx[idx_map.size()] : next_idx++);
+
+			}
+
+			area.points_[j].tree_idx = idx_map[tree_idx];
+			area.points_[j].segmentation_status = true;
+
+		}
+
+		n_new_trees = idx_map.size();
+		kept.points_.insert(kept.points_.end(), area.points_.begin(), area.points_.end());
+
+	}
+
+	if (verbosity){
+
+		cout << "Changed area: [" << x_min << ", " << x_max << "] x [" << y_min << ", " << y_max << "]" << endl;
+		cout << "Invalidated trees: " << freed_idx.size() << endl;
+		cout << "Replaced points: " << n_removed << " -> " << new_points.points_.size() << endl;
+		cout << "Re-segmented points: " << area.points_.size() << endl;
+		cout << "New trees: " << n_new_trees << endl;
+
+	}
+
+	point_collection_.points_.swap(kept.points_);
+	IndexTrees();
+}
+
+
+// Return the segmented points sorted by height
+PointCollection SegmentationState::GetPointCollection()
+{
+	PointCollection point_collection;
+	point_collection.points_ = point_collection_.points_;
+	point_collection.coordinate_scaling_ = coordinate_scaling_;
+	point_collection.SortByZ();
+	point_collection.ComputePointIndexes();
+
+	return point_collection;
+}
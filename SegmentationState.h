@@ -0,0 +1,133 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class represents the persistent result of a segmentation: the segmented points grouped by tree, the
+ * point range and the horizontal extent of each tree, and the definition of the grid. It allows updating
+ * a segmentation when part of the area is re-surveyed, by re-segmenting only the trees located near the
+ * changed area.
+ *
+ */
+
+#ifndef SEGMENTATIONSTATE_H
+#define SEGMENTATIONSTATE_H
+
+#include <vector>
+#include <string>
+#include "PointCollection.h"
+#include "Segmenter.h"
+#include "CircularBufferCollection.h"
+
+class SegmentationState {
+
+public:
+
+	/**
+	 * Creates the state from a segmented PointCollection.
+	 *
+	 * @param  point_collection A reference to the segmented PointCollection.
+	 * @param  i_filepath The input file path of the segmentation, used to name the output files after an update.
+	 */
+	void Build(PointCollection& point_collection, const std::string& i_filepath);
+
+	/**
+	 * Writes the state to a binary file.
+	 *
+	 * @param  filepath The state file path.
+	 * @return Returns true if the file could be written.
+	 */
+	bool Write(const std::string& filepath);
+
+	/**
+	 * Reads the state from a binary file.
+	 *
+	 * @param  filepath The state file path.
+	 * @return Returns true if the file could be read.
+	 */
+	bool Read(const std::string& filepath);
+
+	/**
+	 * Replaces the points located within the bounding box of the changed points and re-segments the trees whose extent
+	 * intersects this bounding box expanded by the halo. The other trees are kept unchanged.
+	 *
+	 * @param  changed_points A reference to a PointCollection containing the re-surveyed points (all classes).
+	 * @param  keep_classes The classes which are kept.
+	 * @param  halo The distance by which the changed area is expanded (largest circular buffer radius).
+	 * @param  circular_buffer_collection A reference to the CircularBufferCollection used in the segmentation.
+	 * @param  segmenter A reference to the Segmenter used in the segmentation.
+	 * @param  verbosity If true, prints information about the update.
+	 */
+	void Update(PointCollection& changed_points, std::vector<unsigned int>& keep_classes, double halo, CircularBufferCollection& circular_buffer_collection, Segmenter& segmenter, bool verbosity);
+
+	/**
+	 * Returns all the segmented points, sorted by height.
+	 *
+	 */
+	PointCollection GetPointCollection();
+
+	std::string GetInputFilepath();
+
+	SegmentationState(){}; // Constructor
+	~SegmentationState(){}; // Destructor
+
+private:
+
+	/**
+	 * Structure representing the point range and the horizontal extent of a tree.
+	 *
+	 */
+	struct Tree {
+
+		unsigned int tree_idx;
+		unsigned int offset;
+		unsigned int n_points;
+		double x_min;
+		double x_max;
+		double y_min;
+		double y_max;
+
+	};
+
+	/**
+	 * Groups the points by tree and recomputes the Tree table.
+	 *
+	 */
+	void IndexTrees();
+
+	/**
+	 * Segmented points, grouped by tree.
+	 *
+	 */
+	PointCollection point_collection_;
+
+	std::vector<Tree> trees_;
+
+	/**
+	 * Grid definition (origin and coordinate scaling factor) of the initial segmentation.
+	 *
+	 */
+	double x_origin_;
+	double y_origin_;
+	unsigned int coordinate_scaling_;
+
+	std::string i_filepath_;
+
+};
+
+#endif
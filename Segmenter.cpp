@@ -0,0 +1,49 @@
+#include <vector>
+#include <string>
+#include <memory>
+#include "Segmenter.h"
+#include "SegmenterSNC.h"
+#include "SegmenterWatershed.h"
+
+using namespace std;
+
+
+// Create a Segmenter
+unique_ptr<Segmenter> Segmenter::Create(Type type)
+{
+	if (type == WATERSHED){
+		
+		return unique_ptr<Segmenter>(new SegmenterWatershed());
+		
+	}
+	
+	return unique_ptr<Segmenter>(new SegmenterSNC());
+}
+
+
+// Find the Type of a segmentation algorithm from its name
+bool Segmenter::ParseType(const string& name, Type& type)
+{
+	if (name == "snc"){
+		
+		type = SNC;
+		
+	} else if (name == "watershed"){
+		
+		type = WATERSHED;
+		
+	} else {
+		
+		return false;
+		
+	}
+	
+	return true;
+}
+
+
+// Set the function called for each finished tree
+void Segmenter::SetTreeCallback(TreeCallback tree_callback)
+{
+	tree_callback_ = tree_callback;
+}
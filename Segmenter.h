@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class is the interface of the algorithms which split a prepared PointCollection (sorted by height, gridded and
+ * with its local maxima found) into individual trees. A Segmenter sets the tree index and the segmentation status of
+ * every Point, with tree indexes given in decreasing height order of the tree tops. The Points of the trees rejected
+ * by the tree filter (see SetTreeFilter) are given the PointCollection::unassigned_tree index.
+ *
+ */
+
+#ifndef SEGMENTER_H
+#define SEGMENTER_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include "PointCollection.h"
+#include "CircularBufferCollection.h"
+
+class Segmenter {
+
+public:
+	
+	/**
+	 * Available segmentation algorithms.
+	 *
+	 */
+	enum Type {SNC, WATERSHED};
+	
+	/**
+	 * Creates a Segmenter of the specified Type.
+	 *
+	 */
+	static std::unique_ptr<Segmenter> Create(Type type);
+	
+	/**
+	 * Finds the Type of a segmentation algorithm from its name ("snc" or "watershed").
+	 *
+	 * @return Returns false if the name is unknown.
+	 */
+	static bool ParseType(const std::string& name, Type& type);
+	
+	/**
+	 * Attempts to split the PointCollection into groups each representing an individual tree.
+	 *
+	 * @param  point_collection A reference to the PointCollection which is to be segmented.
+	 * @param  circular_buffer_collection A reference to the CircularBufferCollection giving the buffer of each seed.
+	 * @param  verbosity If true, will print information about the segmentation process to the terminal. 
+	 */
+	virtual void SegmentPointCollection(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, bool verbosity) = 0;
+	
+	/**
+	 * Sets the number of threads used by SegmentPointCollection (ignored by sequential algorithms).
+	 *
+	 * @param  n_threads The number of threads (1 = sequential algorithm).
+	 * @param  wavefront_size The number of candidate seeds considered in each wave (0 = 4 times the number of threads).
+	 */
+	virtual void SetParallelism(unsigned int n_threads, unsigned int wavefront_size){};
+	
+	/**
+	 * Reserves the scratch memory for the specified number of Points within a seed buffer (ignored by algorithms without scratch memory).
+	 *
+	 */
+	virtual void ReserveScratch(unsigned int n_points){};
+	
+	/**
+	 * Sets the filter of the trees which are kept, so that the rejected trees are not segmented further (ignored by
+	 * algorithms without seeds). The Points of the rejected trees are unassigned and the retained trees are given
+	 * consecutive indexes.
+	 *
+	 * @param  min_height The minimum height of a tree top (0 = no limit).
+	 * @param  min_n_points The minimum number of Points of a tree (0 = no limit).
+	 */
+	virtual void SetTreeFilter(double min_height, unsigned int min_n_points){};
+	
+	/**
+	 * Function called for each finished tree, in increasing tree index order, with the tree index and the indexes of
+	 * its Points in the segmented PointCollection. The function may take the contents of the index vector. The unassigned
+	 * Points are handed over with the PointCollection::unassigned_tree index.
+	 *
+	 */
+	typedef std::function<void(unsigned int tree_idx, std::vector<unsigned int>& point_idx)> TreeCallback;
+	
+	/**
+	 * Sets the TreeCallback called by SegmentPointCollection (an empty function disables it).
+	 *
+	 */
+	void SetTreeCallback(TreeCallback tree_callback);
+	
+	virtual ~Segmenter(){}; // Destructor
+	
+protected:
+	
+	TreeCallback tree_callback_;
+	
+};
+
+#endif
@@ -1,100 +1,104 @@
 #include <iostream>
 #include <vector>
+#include <map>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <climits>
+#include <limits>
+#include <chrono>
+#include <cmath>
+#include <memory_resource>
 #include "PointCollection.h"
 #include "SegmenterSNC.h"
 #include "CircularBuffer.h"
 #include "CircularBufferCollection.h"
+#include "PerfCounters.h"
+#include "TraceRecorder.h"
+#include "AllocationTracker.h"
 
 using namespace std;
 
 void SegmenterSNC::SegmentPointCollection(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, bool verbosity)
 {
-	PointCollection N, P, sample;
-	N.points_.reserve(20000);
-	P.points_.reserve(20000);
-	sample.points_.reserve(20000);
+	if (n_threads_ > 1){
+		
+		SegmentWavefront(point_collection, circular_buffer_collection, verbosity);
+		return;
+		
+	}
+	
+	// Scratch collections are members so that they keep their capacity between calls
+	Scratch& scratch = scratch_[0];
 	
-	unsigned int buffer_idx, iteration_idx(0);
-	double offset;
+	unsigned int iteration_idx(0), max_rank(0);
 	
 	n_unsegmented_ = point_collection.points_.size();
 	
 	while (n_unsegmented_ >  0)
 	{
 		
-		// Determine the index of the highest unsegmented Point in the PointCollection
-		unsigned int j(0), max_idx(0);
-		while(point_collection.points_[j].segmentation_status){
+		// Determine the index of the highest unsegmented Point in the PointCollection (seeds are found in decreasing height order)
+		while(point_collection.points_[point_collection.GetHeightOrderIndex(max_rank)].segmentation_status){
 			
-			max_idx++;
-			j++;
+			max_rank++;
 			
 		}
 		
-		double max_z = point_collection.points_[max_idx].z;
-		//cout << "max z: " << max_z << endl;
+		unsigned int max_idx = point_collection.GetHeightOrderIndex(max_rank);
+		
+		// The tops of the remaining trees cannot be higher than the seed
+		if (point_collection.points_[max_idx].z < min_height_){
+			
+			UnassignRemaining(point_collection, max_rank);
+			break;
+			
+		}
 		
 		// Find column and row of the highest unsegmented point in the cloud
 		int col_0 = point_collection.points_[max_idx].col;
 		int row_0 = point_collection.points_[max_idx].row;
 		
-		// Set the search radius as a function of height
-		if(max_z > 15){
+		// Extract and classify the points located within the circular buffer
+		SegmentSeed(point_collection, circular_buffer_collection, max_idx, scratch);
+		PointCollection& P = scratch.P;
+		
+		// Trees with too few points are rejected before their points are written back
+		bool rejected = (P.points_.size() < min_n_points_);
+		unsigned int tree_idx = rejected ? PointCollection::unassigned_tree : iteration_idx;
+		
+		for (unsigned int j(0); j < P.points_.size(); j++){
 			
-			buffer_idx  = 3; 
+			point_collection.points_[P.points_[j].point_idx].segmentation_status = true; // Set "segmentation_status" attribute to true for segmented points
+			point_collection.points_[P.points_[j].point_idx].tree_idx = tree_idx; // Set "tree_idx" attribute to current iteration index for segmented points
 			
-		} else if((max_z <= 15) and (max_z > 8)){
+		}
+		
+		n_unsegmented_ = n_unsegmented_ - P.points_.size(); // Update the number of remaining unsegmented points 
+		
+		// Hand the finished tree over (e.g. to a StreamingWriter)
+		if (tree_callback_){
 			
-			buffer_idx  = 2;
+			vector<unsigned int> tree(P.points_.size());
 			
-		} else{
+			for (unsigned int j(0); j < P.points_.size(); j++){
+				
+				tree[j] = P.points_[j].point_idx;
+				
+			}
 			
-			buffer_idx = 1;
+			tree_callback_(tree_idx, tree);
 			
 		}
 		
-		// Extract the points located within the circular buffer
-		point_collection.ExtractPointsInBuffer(circular_buffer_collection.circular_buffers_[buffer_idx], sample, col_0, row_0);
-		
-		// Sort sample by height
-		//cout << "Sorting sample...";
-		sample.SortByZ();
-		//cout << "Done!" << endl;
-		
-		// Add the Point with the maximum height to P as an initial seed
-		P.points_.push_back(sample.points_[0]);
-		
-		// Add a random point to N as initial seed
-		//offset = 2 * double(current_buffer.GetRadius());
-		offset = 2 * double(circular_buffer_collection.circular_buffers_[buffer_idx].radius_);
-		PointCollection::Point seed_n; 
-		seed_n.x = point_collection.points_[max_idx].x + offset;
-		seed_n.y = point_collection.points_[max_idx].y + offset;
-		seed_n.z = point_collection.points_[max_idx].z;
-		seed_n.row = 0;
-		seed_n.col = 0;
-		seed_n.classification = 0;
-		seed_n.point_idx = 0;
-		seed_n.tree_idx = 0;
-		seed_n.local_maxima_status = 2;
-		seed_n.segmentation_status = false;
-		seed_n.rgb_color = {0, 0, 0};
-		N.points_.push_back(seed_n);
-		
-		// Classify sample points
-		//cout << "Classifying sample..." << endl;
-		ClassifySample(P, N, sample);
-		//cout << "Done!" << endl;
-		
-		for (unsigned int j(0); j < P.points_.size(); j++){
+		if (rejected){
 			
-			point_collection.points_[P.points_[j].point_idx].segmentation_status = true; // Set "segmentation_status" attribute to true for segmented points
-			point_collection.points_[P.points_[j].point_idx].tree_idx = iteration_idx; // Set "tree_idx" attribute to current iteration index for segmented points
+			continue;
 			
 		}
 		
-		n_unsegmented_ = n_unsegmented_ - P.points_.size(); // Update the number of remaining unsegmented points 
-		
 		if (verbosity){
 			
 			cout << "Iteration: "  << iteration_idx <<  endl;
@@ -108,107 +112,552 @@ void SegmenterSNC::SegmentPointCollection(PointCollection& point_collection, Cir
 		
 		iteration_idx++; // Increment tree index at each successful segmentation
 		
-		// Clear current sample contents
-		sample.points_.clear();
-		N.points_.clear();
-		P.points_.clear();
+	}
+		
+}
+
+
+// Extract the sample around a seed and classify it into P and N
+void SegmenterSNC::SegmentSeed(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, unsigned int max_idx, Scratch& scratch)
+{
+	PointCollection& N = scratch.N;
+	PointCollection& P = scratch.P;
+	PointCollection& sample = scratch.sample;
+	sample.points_.clear();
+	N.points_.clear();
+	P.points_.clear();
+	scratch.arena->release();
+	
+	// Count the heap allocations of the iteration (none are expected once the scratch memory is reserved)
+	AllocationTracker::Counts allocation_start = AllocationTracker::GetThreadTotals();
+	
+	// Time the iteration if it is sampled for the timeline
+	bool traced = TraceRecorder::SampleIteration();
+	chrono::steady_clock::time_point t0;
+	
+	if (traced){
+		
+		t0 = chrono::steady_clock::now();
+		
+	}
+	
+	// Find column and row of the seed
+	int col_0 = point_collection.points_[max_idx].col;
+	int row_0 = point_collection.points_[max_idx].row;
+	
+	// Set the search radius as a function of height
+	CircularBuffer& circular_buffer = circular_buffer_collection.GetSeedBuffer(point_collection.points_[max_idx].z);
+	
+	// Extract the points located within the circular buffer
+	point_collection.ExtractPointsInBuffer(circular_buffer, sample, col_0, row_0);
+	
+	// Sort sample by height
+	sample.SortByZ();
+	
+	// Add the Point with the maximum height to P as an initial seed
+	P.points_.push_back(sample.points_[0]);
+	
+	// Add a random point to N as initial seed
+	double offset = 2 * circular_buffer.radius_;
+	PointCollection::Point seed_n; 
+	seed_n.x = point_collection.points_[max_idx].x + offset;
+	seed_n.y = point_collection.points_[max_idx].y + offset;
+	seed_n.z = point_collection.points_[max_idx].z;
+	seed_n.row = 0;
+	seed_n.col = 0;
+	seed_n.classification = 0;
+	seed_n.point_idx = 0;
+	seed_n.tree_idx = 0;
+	seed_n.local_maxima_status = 2;
+	seed_n.segmentation_status = false;
+	seed_n.rgb_color = {0, 0, 0};
+	
+	// Classify sample points
+	unsigned int quantization = point_collection.quantization_;
+	
+	if (quantization > 0){
+		
+		seed_n.qx = point_collection.points_[max_idx].qx + (int) (offset * quantization);
+		seed_n.qy = point_collection.points_[max_idx].qy + (int) (offset * quantization);
+		seed_n.qz = point_collection.points_[max_idx].qz;
+		N.points_.push_back(seed_n);
+		ClassifySample<QuantizedDistance>(scratch, quantization);
+		
+	} else {
+		
+		N.points_.push_back(seed_n);
+		ClassifySample<DoubleDistance>(scratch, 0);
 		
 	}
+	
+	// Record the iteration span
+	if (traced){
+		
+		const PointCollection::Point& seed = point_collection.points_[max_idx];
+		TraceRecorder::IterationArgs args = {seed.x, seed.y, seed.z, circular_buffer.radius_, (unsigned int) sample.points_.size(), (unsigned int) P.points_.size(), (unsigned int) N.points_.size() - 1};
+		TraceRecorder::AddIteration(t0, args);
 		
+	}
+	
+	AllocationTracker::AddRegion("segment/seed", allocation_start);
+	
 }
 
 
-void SegmenterSNC::ClassifySample(PointCollection& P, PointCollection& N, PointCollection& sample)
+// Segment seeds whose circular buffers do not overlap concurrently
+void SegmenterSNC::SegmentWavefront(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, bool verbosity)
 {
-	double dmin1, dmin2, dt;	
+	vector<PointCollection::Point>& points = point_collection.points_;
+	unsigned int n_threads = n_threads_;
+	
+	// Reserve after resizing, since growing the vector copies the PointCollections without their capacity
+	if (scratch_.size() < n_threads){
+		
+		scratch_.resize(n_threads);
+		
+		for (unsigned int t(0); t < n_threads; t++){
 			
-	for (unsigned int j(1); j < sample.points_.size(); j++){
+			ReserveScratch(scratch_[t]);
+			
+		}
+	}
+	
+	// Height ranks of the seeds processed in the current wave and the point indexes of their trees
+	vector<unsigned int> accepted;
+	vector<vector<unsigned int>> results;
+	vector<array<int, 3>> candidate_buffers; // Column, row and radius (in grid cells) of the candidate seeds
+	
+	// Team of worker threads processing the seeds of each wave
+	mutex team_mutex;
+	condition_variable start_condition, done_condition;
+	atomic<unsigned int> next_task(0);
+	unsigned int wave_idx(0), n_finished(0);
+	bool stop(false);
+	
+	auto run_tasks = [&](unsigned int thread_idx){
+		
+		unsigned int task_idx;
 		
-		//if (not sample.points_[j].segmentation_status){
+		while ((task_idx = next_task++) < accepted.size()){
 			
-			// Compute minimal distance from u to any point in P_i
-			dmin1 = FindMinDistance(sample.points_[j], P);
-			//cout << "dmin1 = " << dmin1 << endl;
+			SegmentSeed(point_collection, circular_buffer_collection, point_collection.GetHeightOrderIndex(accepted[task_idx]), scratch_[thread_idx]);
 			
-			// Compute minimal distance from u to any point in N_i
-			dmin2 = FindMinDistance(sample.points_[j], N);
-			//cout << "dmin2 = " << dmin2 << endl;
+			const PointCollection& P = scratch_[thread_idx].P;
+			results[task_idx].clear();
+			
+			for (unsigned int j(0); j < P.points_.size(); j++){
+				
+				results[task_idx].push_back(P.points_[j].point_idx);
+				
+			}
+		}
+	};
+	
+	vector<thread> team;
+	PerfCounters::ThreadCounters* perf_parent = PerfCounters::IsEnabled() ? &PerfCounters::GetThreadCounters() : NULL;
+	
+	for (unsigned int t(1); t < n_threads; t++){
 		
-			if (not sample.points_[j].local_maxima_status) { // If the point is the local maximum 
+		team.push_back(thread([&, t](){
+			
+			unsigned int last_wave(0);
+			PerfCounters::Counts perf_start;
+			PerfCounters::StartChildThread(perf_start);
+			
+			while (true){
 				
-				if (dmin1 <= dmin2){
-					
-					P.points_.push_back(sample.points_[j]);
+				{
+					unique_lock<mutex> lock(team_mutex);
+					start_condition.wait(lock, [&]{ return stop or (wave_idx != last_wave); });
 					
-				} else if (dmin1 > dmin2) {
-
-					N.points_.push_back(sample.points_[j]);
+					if (stop){
+						
+						// Add the counters of the thread to the segmentation stage
+						if (perf_parent != NULL) PerfCounters::StopChildThread(*perf_parent, perf_start);
+						return;
+						
+					}
 					
+					last_wave = wave_idx;
 				}
+				
+				run_tasks(t);
+				
+				lock_guard<mutex> lock(team_mutex);
+				n_finished++;
+				done_condition.notify_one();
+				
 			}
-			else {
-
-				if (sample.points_[j].z > 15) {
-					
-					dt = 4;
-					
-				} else {
-					
-					dt = 2.89;
-					
-				}
+		}));
+		
+	}
+	
+	// Trees waiting for their index, by seed rank. Seeds are found in decreasing height order by the
+	// sequential algorithm, so the index of a tree is known once no unsegmented point remains above its seed.
+	multimap<unsigned int, vector<unsigned int>> pending_trees;
+	unsigned int cursor(0), tree_idx(0);
+	
+	n_unsegmented_ = points.size();
+	
+	while (n_unsegmented_ > 0){
+		
+		while (points[point_collection.GetHeightOrderIndex(cursor)].segmentation_status){
+			
+			cursor++;
+			
+		}
+		
+		// Assign the indexes of the trees whose seed is above the highest unsegmented point
+		FlushTrees(point_collection, pending_trees, cursor, tree_idx, verbosity);
+		
+		// The tops of the remaining trees cannot be higher than the highest unsegmented point
+		if (points[point_collection.GetHeightOrderIndex(cursor)].z < min_height_){
+			
+			UnassignRemaining(point_collection, cursor);
+			break;
+			
+		}
+		
+		// Take the next highest unsegmented points as candidate seeds and accept those whose buffer does not intersect
+		// the buffer of any higher candidate, so that their sample is the same as in the sequential algorithm
+		candidate_buffers.clear();
+		accepted.clear();
+		
+		for (unsigned int rank(cursor); (rank < points.size()) and (candidate_buffers.size() < wavefront_size_); rank++){
+			
+			const PointCollection::Point& point = points[point_collection.GetHeightOrderIndex(rank)];
+			
+			if (point.segmentation_status){
+				
+				continue;
+				
+			}
+			
+			if (point.z < min_height_){
 				
-				// Compare dmin1 and dmin2 to threshold
-				if (dmin1 > dt) {
+				break;
+				
+			}
+			
+			const CircularBuffer& buffer = circular_buffer_collection.GetSeedBuffer(point.z);
+			array<int, 3> candidate = {point.col, point.row, int(buffer.scaled_radius_)};
+			bool disjoint(true);
+			
+			for (unsigned int k(0); disjoint and (k < candidate_buffers.size()); k++){
+				
+				long long dc = candidate[0] - candidate_buffers[k][0];
+				long long dr = candidate[1] - candidate_buffers[k][1];
+				long long rr = candidate[2] + candidate_buffers[k][2];
+				disjoint = (dc*dc + dr*dr > rr*rr);
+				
+			}
+			
+			if (disjoint){
+				
+				accepted.push_back(rank);
+				
+			}
+			
+			candidate_buffers.push_back(candidate);
+			
+		}
+		
+		// Classify the accepted seeds concurrently
+		if (results.size() < accepted.size()){
+			
+			results.resize(accepted.size());
+			
+		}
+		
+		{
+			lock_guard<mutex> lock(team_mutex);
+			next_task = 0;
+			n_finished = 0;
+			wave_idx++;
+		}
+		start_condition.notify_all();
+		
+		run_tasks(0);
+		
+		{
+			unique_lock<mutex> lock(team_mutex);
+			done_condition.wait(lock, [&]{ return n_finished == n_threads - 1; });
+		}
+		
+		// Commit the segmentation status of the wave
+		for (unsigned int k(0); k < accepted.size(); k++){
+			
+			for (unsigned int j(0); j < results[k].size(); j++){
+				
+				points[results[k][j]].segmentation_status = true;
+				
+			}
+			
+			n_unsegmented_ -= results[k].size();
+			
+			// A seed can end up in N when it ties in height with another point of its sample, in which case it is selected
+			// again by the next wave. Equal keys keep their insertion order, which is the order of the sequential algorithm.
+			multimap<unsigned int, vector<unsigned int>>::iterator tree = pending_trees.insert({accepted[k], vector<unsigned int>()});
+			tree->second.swap(results[k]);
+			
+		}
+		
+	}
+	
+	FlushTrees(point_collection, pending_trees, points.size(), tree_idx, verbosity);
+	
+	{
+		lock_guard<mutex> lock(team_mutex);
+		stop = true;
+	}
+	start_condition.notify_all();
+	
+	for (unsigned int t(0); t < team.size(); t++){
+		
+		team[t].join();
+		
+	}
+	
+}
 
-					N.points_.push_back(sample.points_[j]);
-					
-				} 
-				else if (dmin1 <= dt and dmin1 <= dmin2) {
 
-					P.points_.push_back(sample.points_[j]);
-					
-				} 
-				else if (dmin1 <= dt and dmin1 > dmin2) {
-					
-					N.points_.push_back(sample.points_[j]);
-					
-				}
+// Assign the tree index of the pending trees whose seed is located before the specified height rank
+void SegmenterSNC::FlushTrees(PointCollection& point_collection, multimap<unsigned int, vector<unsigned int>>& pending_trees, unsigned int position, unsigned int& tree_idx, bool verbosity)
+{
+	while ((not pending_trees.empty()) and (pending_trees.begin()->first < position)){
+		
+		vector<unsigned int>& tree = pending_trees.begin()->second;
+		
+		// Trees with too few points are rejected without taking an index
+		if (tree.size() < min_n_points_){
+			
+			for (unsigned int j(0); j < tree.size(); j++){
+				
+				point_collection.points_[tree[j]].tree_idx = PointCollection::unassigned_tree;
+				
+			}
+			
+			if (tree_callback_){
+				
+				tree_callback_(PointCollection::unassigned_tree, tree);
+				
 			}
+			
+			pending_trees.erase(pending_trees.begin());
+			continue;
+			
+		}
+		
+		for (unsigned int j(0); j < tree.size(); j++){
+			
+			point_collection.points_[tree[j]].tree_idx = tree_idx;
+			
+		}
+		
+		if (verbosity){
+			
+			const PointCollection::Point& seed = point_collection.points_[point_collection.GetHeightOrderIndex(pending_trees.begin()->first)];
+			cout << "Iteration: "  << tree_idx <<  endl;
+			cout << "Col: " << seed.col << endl;
+		    cout << "Row: " << seed.row << endl;
+			cout << "Tree size: "  << tree.size() <<  endl;
+			cout << "****************************************" <<  endl;
+			
+		}
+		
+		if (tree_callback_){
+			
+			tree_callback_(tree_idx, tree);
+			
+		}
+		
+		pending_trees.erase(pending_trees.begin());
+		tree_idx++;
+		
+	}
+}
+
+
+// Unassign the unsegmented points from a height rank on
+void SegmenterSNC::UnassignRemaining(PointCollection& point_collection, unsigned int rank)
+{
+	vector<unsigned int> remaining;
+	remaining.reserve(n_unsegmented_);
 	
-		//}
+	for (unsigned int k(rank); k < point_collection.points_.size(); k++){
+		
+		unsigned int idx = point_collection.GetHeightOrderIndex(k);
+		PointCollection::Point& point = point_collection.points_[idx];
+		
+		if (not point.segmentation_status){
+			
+			point.segmentation_status = true;
+			point.tree_idx = PointCollection::unassigned_tree;
+			remaining.push_back(idx);
+			
+		}
 	}
 	
+	n_unsegmented_ = 0;
+	
+	if (tree_callback_){
+		
+		tree_callback_(PointCollection::unassigned_tree, remaining);
+		
+	}
+}
+
+
+// Set the filter of the trees which are kept
+void SegmenterSNC::SetTreeFilter(double min_height, unsigned int min_n_points)
+{
+	min_height_ = min_height;
+	min_n_points_ = min_n_points;
 }
 
 
-inline double SegmenterSNC::FindMinDistance(PointCollection::Point& point, PointCollection& point_collection)
+void SegmenterSNC::SetParallelism(unsigned int n_threads, unsigned int wavefront_size)
 {
-	vector<double> d;
-	d.reserve(point_collection.points_.size());
+	n_threads_ = (n_threads > 0) ? n_threads : 1;
+	wavefront_size_ = (wavefront_size > 0) ? wavefront_size : 4 * n_threads_;
+}
+
+
+// Reserve the scratch memory
+void SegmenterSNC::ReserveScratch(unsigned int n_points)
+{
+	scratch_capacity_ = n_points;
 	
-	// Compute pairwise squared distances
-	double nx, ny;
-	for (unsigned int j(0); j < point_collection.points_.size(); j++){
+	for (unsigned int j(0); j < scratch_.size(); j++){
 		
-		nx = point_collection.points_[j].x - point.x;
-		ny = point_collection.points_[j].y - point.y;
-		d.push_back(nx*nx + ny*ny); // Use the squared distance to avoid square root computation
+		ReserveScratch(scratch_[j]);
 		
 	}
+}
+
+
+// Reserve the scratch memory of a thread
+void SegmenterSNC::ReserveScratch(Scratch& scratch)
+{
+	scratch.P.points_.reserve(scratch_capacity_);
+	scratch.N.points_.reserve(scratch_capacity_);
+	scratch.sample.points_.reserve(scratch_capacity_);
 	
-	// Find minimum distance
-	double min = d[0];
-	for (unsigned int j(0); j < d.size(); j++){
+	// Room for the four coordinate arrays of a sample, plus the alignment of each array
+	size_t arena_size = 4 * (size_t(scratch_capacity_) * sizeof(double) + alignof(max_align_t));
+	
+	if ((scratch.arena == NULL) or (scratch.arena_buffer.size() < arena_size)){
+		
+		scratch.arena.reset();
+		vector<char>(arena_size).swap(scratch.arena_buffer);
+		scratch.arena.reset(new pmr::monotonic_buffer_resource(scratch.arena_buffer.data(), scratch.arena_buffer.size()));
 		
-		if (d[j] < min){
+	}
+}
+
+
+// Classify the sample with the squared distances of the distance policy
+template <typename Policy>
+void SegmenterSNC::ClassifySample(Scratch& scratch, unsigned int quantization)
+{
+	PointCollection& P = scratch.P;
+	PointCollection& N = scratch.N;
+	PointCollection& sample = scratch.sample;
+	Coordinates<typename Policy::Coordinate> coordinates(sample.points_.size(), scratch.arena.get());
+	
+	PerfCounters::Counts perf_start;
+	bool measured = PerfCounters::StartFunction(PerfCounters::CLASSIFY_SAMPLE, perf_start);
+	
+	// Distance thresholds of the local maxima (in squared coordinate units)
+	const typename Policy::Distance dt_high = Policy::Threshold(4, quantization);
+	const typename Policy::Distance dt_low = Policy::Threshold(2.89, quantization);
+	typename Policy::Distance dmin1, dmin2, dt;
+	
+	coordinates.P_x.push_back(Policy::X(P.points_[0]));
+	coordinates.P_y.push_back(Policy::Y(P.points_[0]));
+	coordinates.N_x.push_back(Policy::X(N.points_[0]));
+	coordinates.N_y.push_back(Policy::Y(N.points_[0]));
+	
+	for (unsigned int j(1); j < sample.points_.size(); j++){
+		
+		const PointCollection::Point& point = sample.points_[j];
+		typename Policy::Coordinate x = Policy::X(point);
+		typename Policy::Coordinate y = Policy::Y(point);
+		
+		// Compute minimal distance from u to any point in P_i and in N_i
+		dmin1 = FindMinDistance<Policy>(x, y, coordinates.P_x, coordinates.P_y);
+		dmin2 = FindMinDistance<Policy>(x, y, coordinates.N_x, coordinates.N_y);
+		
+		bool in_tree;
+		
+		if (not point.local_maxima_status){ // If the point is not a local maximum
 			
-			min = d[j];
+			in_tree = (dmin1 <= dmin2);
+			
+		} else {
+			
+			// Compare dmin1 and dmin2 to threshold
+			dt = (point.z > 15) ? dt_high : dt_low;
+			in_tree = (dmin1 <= dt) and (dmin1 <= dmin2);
 			
 		}
 		
+		if (in_tree){
+			
+			P.points_.push_back(point);
+			coordinates.P_x.push_back(x);
+			coordinates.P_y.push_back(y);
+			
+		} else {
+			
+			N.points_.push_back(point);
+			coordinates.N_x.push_back(x);
+			coordinates.N_y.push_back(y);
+			
+		}
 	}
 	
-	return min; 
+	if (measured) PerfCounters::StopFunction(PerfCounters::CLASSIFY_SAMPLE, perf_start);
+}
+
+
+// Find the minimum squared distance (the loop has no dependency between iterations but the minimum, so that it can be vectorized)
+template <typename Policy>
+typename Policy::Distance SegmenterSNC::FindMinDistance(typename Policy::Coordinate x, typename Policy::Coordinate y, const pmr::vector<typename Policy::Coordinate>& xs, const pmr::vector<typename Policy::Coordinate>& ys)
+{
+	PerfCounters::Counts perf_start;
+	bool measured = PerfCounters::StartFunction(PerfCounters::FIND_MIN_DISTANCE, perf_start);
+	
+	typename Policy::Distance min = numeric_limits<typename Policy::Distance>::max();
+	const typename Policy::Coordinate* x_data = xs.data();
+	const typename Policy::Coordinate* y_data = ys.data();
+	size_t n = xs.size();
+	
+	for (size_t j(0); j < n; j++){
+		
+		typename Policy::Distance dx = x_data[j] - x;
+		typename Policy::Distance dy = y_data[j] - y;
+		typename Policy::Distance d = dx*dx + dy*dy; // Use the squared distance to avoid square root computation
+		min = (d < min) ? d : min;
+		
+	}
+	
+	if (measured) PerfCounters::StopFunction(PerfCounters::FIND_MIN_DISTANCE, perf_start);
+	
+	return min;
+}
+
+
+// Constructor
+SegmenterSNC::SegmenterSNC()
+{
+	n_threads_ = 1;
+	wavefront_size_ = 1;
+	min_height_ = 0;
+	min_n_points_ = 0;
+	scratch_capacity_ = 20000;
+	
+	scratch_.resize(1);
+	ReserveScratch(scratch_[0]);
 	
 }
@@ -30,13 +30,18 @@
 #define SEGMENTERSNC_H
 #include <iostream>
 #include <vector>
+#include <map>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <cmath>
 #include "PointCollection.h"
-#include "SegmenterSNC.h"
+#include "Segmenter.h"
 #include "CircularBuffer.h"
 #include "CircularBufferCollection.h"
 
 
-class SegmenterSNC {
+class SegmenterSNC : public Segmenter {
 
 friend class PointCollection;
 
@@ -49,9 +54,35 @@ public:
 	 * @param  circular_buffer_collection A reference to the CircularBufferCollection used to extract Points within the local neighbourhood around the suspected tree.
 	 * @param  verbosity If true, will print information about the segmentation process to the terminal. 
 	 */
-	void SegmentPointCollection(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, bool verbosity);
+	void SegmentPointCollection(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, bool verbosity) override;
 	
-	SegmenterSNC(){}; // Constructor
+	/**
+	 * Sets the number of threads used by SegmentPointCollection. With more than one thread, the next highest unsegmented
+	 * seeds are processed in waves: the seeds whose CircularBuffer does not intersect the CircularBuffer of any higher
+	 * candidate seed are classified concurrently. The result is identical to the sequential algorithm.
+	 *
+	 * @param  n_threads The number of threads (1 = sequential algorithm).
+	 * @param  wavefront_size The number of candidate seeds considered in each wave (0 = 4 times the number of threads).
+	 */
+	void SetParallelism(unsigned int n_threads, unsigned int wavefront_size) override;
+	
+	/**
+	 * Reserves the scratch memory of each thread for the specified number of Points within a seed buffer.
+	 *
+	 */
+	void ReserveScratch(unsigned int n_points) override;
+	
+	/**
+	 * Sets the filter of the trees which are kept. Seeds are taken in decreasing height order, so once a seed is below
+	 * the minimum height, all the remaining Points are unassigned at once without extracting any more samples. The
+	 * trees with too few Points are unassigned as soon as they are classified.
+	 *
+	 * @param  min_height The minimum height of a tree top (0 = no limit).
+	 * @param  min_n_points The minimum number of Points of a tree (0 = no limit).
+	 */
+	void SetTreeFilter(double min_height, unsigned int min_n_points) override;
+	
+	SegmenterSNC(); // Constructor
 	~SegmenterSNC(){}; // Destructor
 	
 private:
@@ -61,25 +92,144 @@ private:
 	 *
 	 */
 	unsigned int n_unsegmented_;
+	
+	/**
+	 * Coordinates of the Points of P and N, stored contiguously for the distance computations. The arrays are allocated
+	 * from the arena of a Scratch, with room for all the Points of the sample.
+	 *
+	 */
+	template <typename T>
+	struct Coordinates {
+		
+		std::pmr::vector<T> P_x;
+		std::pmr::vector<T> P_y;
+		std::pmr::vector<T> N_x;
+		std::pmr::vector<T> N_y;
+		
+		Coordinates(size_t n_points, std::pmr::memory_resource* arena) : P_x(arena), P_y(arena), N_x(arena), N_y(arena)
+		{
+			P_x.reserve(n_points);
+			P_y.reserve(n_points);
+			N_x.reserve(n_points);
+			N_y.reserve(n_points);
+		}; // Constructor
+		
+	};
+	
+	/**
+	 * Scratch memory of a thread: PointCollections (P, N and sample) reused across iterations and calls, and a monotonic
+	 * arena for the arrays of an iteration, released at the start of the next one. The initial buffer of the arena is
+	 * sized for the scratch capacity, so that an iteration only falls back to the heap for an unusually large sample.
+	 *
+	 */
+	struct Scratch {
+		
+		PointCollection P;
+		PointCollection N;
+		PointCollection sample;
+		std::vector<char> arena_buffer;
+		std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+		
+	};
+	
+	/**
+	 * Distance policies of ClassifySample: squared distances computed from the double precision coordinates, or computed and
+	 * compared in integer arithmetic from the quantized coordinates.
+	 *
+	 */
+	struct DoubleDistance {
+		
+		typedef double Coordinate;
+		typedef double Distance;
+		static Coordinate X(const PointCollection::Point& point) {return point.x;};
+		static Coordinate Y(const PointCollection::Point& point) {return point.y;};
+		static Distance Threshold(double squared_distance, unsigned int quantization) {return squared_distance;};
+		
+	};
+	
+	struct QuantizedDistance {
+		
+		typedef int Coordinate;
+		typedef long long Distance;
+		static Coordinate X(const PointCollection::Point& point) {return point.qx;};
+		static Coordinate Y(const PointCollection::Point& point) {return point.qy;};
+		static Distance Threshold(double squared_distance, unsigned int quantization) {return llround(squared_distance * double((long long) quantization * quantization));};
+		
+	};
+	
+	std::vector<Scratch> scratch_;
+	unsigned int scratch_capacity_; // Number of Points reserved in each scratch PointCollection
+	
+	/**
+	 * Reserves the PointCollections and the arena of a Scratch for the scratch capacity.
+	 *
+	 */
+	void ReserveScratch(Scratch& scratch);
+	
+	unsigned int n_threads_;
+	unsigned int wavefront_size_;
+	double min_height_;
+	unsigned int min_n_points_;
+	
+	/**
+	 * Unassigns the unsegmented Points from the specified height rank on (all the Points above are segmented).
+	 *
+	 * @param  point_collection A reference to the PointCollection which is segmented.
+	 * @param  rank The height rank of the highest unsegmented Point.
+	 */
+	void UnassignRemaining(PointCollection& point_collection, unsigned int rank);
+	
+	/**
+	 * Extracts the sample around a seed and classifies it. The Points of the tree are left in scratch.P.
+	 *
+	 * @param  point_collection A reference to the PointCollection which is segmented.
+	 * @param  circular_buffer_collection A reference to the CircularBufferCollection.
+	 * @param  max_idx The index of the seed (highest unsegmented Point).
+	 * @param  scratch A reference to the Scratch of the calling thread.
+	 */
+	void SegmentSeed(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, unsigned int max_idx, Scratch& scratch);
+	
+	/**
+	 * Segments the PointCollection in waves of seeds with non-intersecting CircularBuffers.
+	 *
+	 */
+	void SegmentWavefront(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, bool verbosity);
+	
+	/**
+	 * Assigns consecutive tree indexes to the pending trees whose seed is located before the specified height rank (the
+	 * trees rejected by the tree filter are unassigned).
+	 *
+	 * @param  point_collection A reference to the PointCollection which is segmented.
+	 * @param  pending_trees The point indexes of the trees waiting for their index, by height rank of their seed.
+	 * @param  position The height rank of the highest unsegmented Point.
+	 * @param  tree_idx A reference to the next tree index.
+	 * @param  verbosity If true, prints information about each tree.
+	 */
+	void FlushTrees(PointCollection& point_collection, std::multimap<unsigned int, std::vector<unsigned int>>& pending_trees, unsigned int position, unsigned int& tree_idx, bool verbosity);
 
 	/**
-	 * Classifies a sample PointCollection into groups P (part of the the tree) and N (not part of the tree).
+	 * Classifies the sample of a Scratch into groups P (part of the the tree) and N (not part of the tree). The sample must
+	 * contain the initial P seed first and N must contain the initial N seed. The distance Policy (DoubleDistance or
+	 * QuantizedDistance) is a template parameter, so that the distance loops are compiled for its coordinate type.
 	 *
-	 * @param  P A reference to the PointCollection where Points that are part of the tree will be contained.
-	 * @param  N A reference to the PointCollection where Points that are not part of the tree will be contained.
-	 * @param  sample A reference to the PointCollection where each Point within the CircularBuffer will be contained.
+	 * @param  scratch A reference to the Scratch containing the sample and the initial P and N seeds.
+	 * @param  quantization The number of quantization units per coordinate unit (0 for the DoubleDistance policy).
 	 */
-	void ClassifySample(PointCollection& P, PointCollection& N, PointCollection& sample);
+	template <typename Policy>
+	void ClassifySample(Scratch& scratch, unsigned int quantization);
 	
 	
 	/**
-	 * Finds the minimum squared distance between the specified Point and all the Points within the specified PointCollection.
+	 * Finds the minimum squared distance between the specified coordinates and the coordinates of a group of Points.
 	 *
-	 * @param  point A reference to a Point.
-	 * @param  point_collection A reference to the a PointCollection.
-	 * @return Returns the smallest squared distance between the specified Point and all the Points within the specified PointCollection.
+	 * @param  x The x coordinate.
+	 * @param  y The y coordinate.
+	 * @param  xs The x coordinates of the group.
+	 * @param  ys The y coordinates of the group.
+	 * @return Returns the smallest squared distance.
 	 */
-	double FindMinDistance(PointCollection::Point& point, PointCollection& point_collection);
+	template <typename Policy>
+	static typename Policy::Distance FindMinDistance(typename Policy::Coordinate x, typename Policy::Coordinate y, const std::pmr::vector<typename Policy::Coordinate>& xs, const std::pmr::vector<typename Policy::Coordinate>& ys);
 	
 };
 
@@ -0,0 +1,219 @@
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cmath>
+#include "PointCollection.h"
+#include "SegmenterWatershed.h"
+#include "CircularBufferCollection.h"
+
+using namespace std;
+
+
+// Flood the canopy height model from the local maxima
+void SegmenterWatershed::SegmentPointCollection(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, bool verbosity)
+{
+	vector<PointCollection::Point>& points = point_collection.points_;
+	int n_cols = point_collection.n_cols_;
+	int n_rows = point_collection.n_rows_;
+	double scaling = double(point_collection.coordinate_scaling_);
+	const unsigned int unlabeled = UINT_MAX;
+	
+	// Canopy height model of the occupied blocks (the height of the highest point of each cell)
+	blocks_.clear();
+	block_origins_.clear();
+	chm_.clear();
+	labels_.clear();
+	
+	for (unsigned int j(0); j < points.size(); j++){
+		
+		size_t cell = GetCell(points[j].row, points[j].col);
+		chm_[cell] = max(chm_[cell], points[j].z);
+		
+	}
+	
+	vector<Marker> markers;
+	priority_queue<Entry> queue;
+	uint64_t order(0);
+	
+	auto add_marker = [&](unsigned int point_idx){
+		
+		const PointCollection::Point& point = points[point_idx];
+		size_t cell = GetCell(point.row, point.col);
+		double radius = circular_buffer_collection.GetSeedRadius(point.z) * scaling;
+		labels_[cell] = markers.size();
+		markers.push_back({point_idx, point.row, point.col, radius * radius});
+		queue.push({chm_[cell], order++, cell});
+		
+	};
+	
+	// Markers of the local maxima, highest first
+	for (unsigned int rank(0); rank < points.size(); rank++){
+		
+		unsigned int j = point_collection.GetHeightOrderIndex(rank);
+		
+		if ((points[j].local_maxima_status == 1) and (labels_[GetCell(points[j].row, points[j].col)] == unlabeled)){
+			
+			add_marker(j);
+			
+		}
+	}
+	
+	unsigned int n_local_maxima = markers.size();
+	unsigned int next_rank(0);
+	
+	while (true){
+		
+		// Flood the neighbouring cells within the radius of the marker, across empty cells at the height of their neighbour
+		while (not queue.empty()){
+			
+			Entry entry = queue.top();
+			queue.pop();
+			
+			unsigned int label = labels_[entry.cell];
+			const Marker& marker = markers[label];
+			const array<int, 2>& origin = block_origins_[entry.cell / SparseGrid::block_cells];
+			int row = origin[0] + int(entry.cell % SparseGrid::block_cells) / SparseGrid::block_size;
+			int col = origin[1] + int(entry.cell % SparseGrid::block_cells) % SparseGrid::block_size;
+			
+			for (int dr(-1); dr <= 1; dr++){
+				
+				for (int dc(-1); dc <= 1; dc++){
+					
+					int r = row + dr;
+					int c = col + dc;
+					
+					if ((r < 0) or (r >= n_rows) or (c < 0) or (c >= n_cols)){
+						
+						continue;
+						
+					}
+					
+					double distance = double(r - marker.row) * (r - marker.row) + double(c - marker.col) * (c - marker.col);
+					
+					if (distance > marker.squared_radius){
+						
+						continue;
+						
+					}
+					
+					size_t cell = GetCell(r, c);
+					
+					if (labels_[cell] != unlabeled){
+						
+						continue;
+						
+					}
+					
+					labels_[cell] = label;
+					queue.push({(chm_[cell] == -HUGE_VAL) ? entry.z : chm_[cell], order++, cell});
+					
+				}
+			}
+		}
+		
+		// Start a new tree from the highest point of the unreached cells
+		while (next_rank < points.size()){
+			
+			const PointCollection::Point& point = points[point_collection.GetHeightOrderIndex(next_rank)];
+			
+			if (labels_[GetCell(point.row, point.col)] == unlabeled){
+				
+				break;
+				
+			}
+			
+			next_rank++;
+			
+		}
+		
+		if (next_rank == points.size()){
+			
+			break;
+			
+		}
+		
+		add_marker(point_collection.GetHeightOrderIndex(next_rank));
+		
+	}
+	
+	// Number the trees in decreasing height order of their highest point
+	vector<unsigned int> marker_order(markers.size());
+	vector<unsigned int> tree_idx(markers.size());
+	
+	for (unsigned int k(0); k < markers.size(); k++){
+		
+		marker_order[k] = k;
+		
+	}
+	
+	sort(marker_order.begin(), marker_order.end(), [&](unsigned int a, unsigned int b){ return point_collection.GetHeightRank(markers[a].point_idx) < point_collection.GetHeightRank(markers[b].point_idx); });
+	
+	for (unsigned int k(0); k < marker_order.size(); k++){
+		
+		tree_idx[marker_order[k]] = k;
+		
+	}
+	
+	// Back-project the trees to the points through the grid, and group the point indexes by tree
+	tree_offsets_.assign(markers.size() + 1, 0);
+	
+	for (unsigned int j(0); j < points.size(); j++){
+		
+		points[j].tree_idx = tree_idx[labels_[GetCell(points[j].row, points[j].col)]];
+		points[j].segmentation_status = true;
+		tree_offsets_[points[j].tree_idx + 1]++;
+		
+	}
+	
+	if (tree_callback_){
+		
+		for (unsigned int k(0); k < markers.size(); k++){
+			
+			tree_offsets_[k+1] += tree_offsets_[k];
+			
+		}
+		
+		tree_points_.resize(points.size());
+		vector<unsigned int> position(tree_offsets_.begin(), tree_offsets_.end() - 1);
+		
+		for (unsigned int j(0); j < points.size(); j++){
+			
+			tree_points_[position[points[j].tree_idx]++] = j;
+			
+		}
+		
+		for (unsigned int k(0); k < markers.size(); k++){
+			
+			vector<unsigned int> tree(tree_points_.begin() + tree_offsets_[k], tree_points_.begin() + tree_offsets_[k+1]);
+			tree_callback_(k, tree);
+			
+		}
+	}
+	
+	if (verbosity){
+		
+		cout << "Watershed: " << markers.size() << " trees (" << n_local_maxima << " from local maxima)" << endl;
+		
+	}
+}
+
+
+// Get the index of a cell, allocating its block
+size_t SegmenterWatershed::GetCell(int row, int col)
+{
+	uint64_t key = (uint64_t(uint32_t(row >> SparseGrid::block_bits)) << 32) | uint32_t(col >> SparseGrid::block_bits);
+	pair<unordered_map<uint64_t, unsigned int>::iterator, bool> block = blocks_.insert({key, (unsigned int) block_origins_.size()});
+	
+	if (block.second){
+		
+		block_origins_.push_back({row & ~(SparseGrid::block_size - 1), col & ~(SparseGrid::block_size - 1)});
+		chm_.resize(chm_.size() + SparseGrid::block_cells, -HUGE_VAL);
+		labels_.resize(labels_.size() + SparseGrid::block_cells, UINT_MAX);
+		
+	}
+	
+	return size_t(block.first->second) * SparseGrid::block_cells + (row & (SparseGrid::block_size - 1)) * SparseGrid::block_size + (col & (SparseGrid::block_size - 1));
+}
@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class segments a PointCollection with a marker-controlled watershed of its canopy height model. The canopy
+ * height model is the height of the highest Point of each grid cell. It is flooded from the cells of the local maxima,
+ * highest cells first, and each tree is limited to the seed buffer radius of its local maximum. Cells which no flood
+ * reaches start new trees from their highest cell. Each Point takes the tree of its grid cell. The algorithm is much
+ * faster than SegmenterSNC, but the trees cannot overlap within a grid cell.
+ *
+ */
+
+#ifndef SEGMENTERWATERSHED_H
+#define SEGMENTERWATERSHED_H
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include "PointCollection.h"
+#include "Segmenter.h"
+#include "CircularBufferCollection.h"
+
+class SegmenterWatershed : public Segmenter {
+
+public:
+	
+	/**
+	 * Splits the PointCollection into trees by flooding its canopy height model from its local maxima.
+	 *
+	 * @param  point_collection A reference to the prepared PointCollection which is to be segmented.
+	 * @param  circular_buffer_collection A reference to the CircularBufferCollection giving the largest extent of each tree.
+	 * @param  verbosity If true, prints the number of markers and trees.
+	 */
+	void SegmentPointCollection(PointCollection& point_collection, CircularBufferCollection& circular_buffer_collection, bool verbosity) override;
+	
+	SegmenterWatershed(){}; // Constructor
+	~SegmenterWatershed(){}; // Destructor
+	
+private:
+	
+	/**
+	 * Local maximum (or highest unreached cell) from which a tree is flooded.
+	 *
+	 */
+	struct Marker {
+		
+		unsigned int point_idx; // Highest Point of the marker cell
+		int row;
+		int col;
+		double squared_radius; // In squared grid cells
+		
+	};
+	
+	/**
+	 * Cell waiting to be flooded. Cells are flooded from the highest, and in insertion order at equal heights.
+	 *
+	 */
+	struct Entry {
+		
+		double z;
+		uint64_t order;
+		size_t cell;
+		
+		bool operator<(const Entry& other) const { return (z < other.z) or ((z == other.z) and (order > other.order)); }
+		
+	};
+	
+	/**
+	 * Canopy height model and marker index of each cell, in blocks of SparseGrid::block_cells cells (row-major) allocated
+	 * when a point or the flood reaches them, and point indexes by tree, kept between calls.
+	 *
+	 */
+	std::unordered_map<uint64_t, unsigned int> blocks_; // Block of each block key (block row in the high 32 bits)
+	std::vector<std::array<int, 2>> block_origins_; // Row and column of the first cell of each block
+	std::vector<double> chm_;
+	std::vector<unsigned int> labels_;
+	std::vector<unsigned int> tree_offsets_;
+	std::vector<unsigned int> tree_points_;
+	
+	/**
+	 * Returns the index of the cell (row, col) in chm_ and labels_, allocating its block if needed.
+	 *
+	 */
+	size_t GetCell(int row, int col);
+	
+};
+
+#endif
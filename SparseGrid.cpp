@@ -0,0 +1,65 @@
+#include <vector>
+#include <cstdint>
+#include "SparseGrid.h"
+
+using namespace std;
+
+
+// Release the grid
+void SparseGrid::Clear()
+{
+	vector<uint64_t>().swap(block_keys_);
+	vector<int>().swap(slots_);
+	vector<uint32_t>().swap(cell_offsets_);
+	vector<int>().swap(indexes_);
+	slot_bits_ = 0;
+}
+
+
+// Create the hash table of the stored blocks, with at most half of the slots used
+void SparseGrid::BuildTable(size_t n_blocks)
+{
+	slot_bits_ = 4;
+
+	while ((size_t(1) << slot_bits_) < 2 * n_blocks){
+
+		slot_bits_++;
+
+	}
+
+	slots_.assign(size_t(1) << slot_bits_, -1);
+
+	for (size_t j(0); j < block_keys_.size(); j++){
+
+		slots_[FindSlot(block_keys_[j])] = int(j);
+
+	}
+}
+
+
+// Find or insert a block
+int SparseGrid::InsertBlock(uint64_t key)
+{
+	size_t slot = FindSlot(key);
+
+	if (slots_[slot] >= 0){
+
+		return slots_[slot];
+
+	}
+
+	block_keys_.push_back(key);
+
+	// Grow the table when it is half full
+	if (2 * block_keys_.size() > slots_.size()){
+
+		BuildTable(block_keys_.size());
+
+	} else {
+
+		slots_[slot] = int(block_keys_.size() - 1);
+
+	}
+
+	return int(block_keys_.size() - 1);
+}
@@ -0,0 +1,288 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class represents the grid of a PointCollection as a set of occupied blocks of 64 x 64 cells, found through an
+ * open addressing hash table of the block coordinates. Only the blocks containing at least one point are stored, so
+ * that the memory is proportional to the occupied area rather than to the bounding box (e.g. for corridor surveys).
+ * The point indexes of all the cells are stored contiguously in compressed sparse row layout, the cells of a block in
+ * column-major order, so that the cells of a column within a block form a single span.
+ *
+ */
+
+#ifndef SPARSEGRID_H
+#define SPARSEGRID_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class SparseGrid {
+
+friend class FileIO;
+
+public:
+
+	static const int block_bits = 6;
+	static const int block_size = 1 << block_bits; // Number of cells along the side of a block
+	static const int block_cells = block_size * block_size; // Number of cells in a block
+
+	/**
+	 * Contiguous range of point indexes.
+	 *
+	 */
+	struct Span {
+
+		const int* begin;
+		const int* end;
+
+		bool empty() const {return begin == end;};
+		size_t size() const {return end - begin;};
+
+	};
+
+	/**
+	 * Builds the grid from the cell coordinates of each point. The point indexes of a cell are in increasing order.
+	 *
+	 * @param  points The points, with row and col members (non negative).
+	 */
+	template <typename PointVector>
+	void Build(const PointVector& points);
+
+	/**
+	 * Returns the point indexes of the cell (row, col) (an empty Span if the cell is outside of the occupied blocks).
+	 *
+	 */
+	Span GetCell(int row, int col) const;
+
+	/**
+	 * Calls f with the non empty Spans of the cells of a column, from row_begin to row_end (included), in increasing row order.
+	 * The cells of a block are returned as a single Span.
+	 *
+	 */
+	template <typename Function>
+	void ForEachColumnSpan(int col, int row_begin, int row_end, Function f) const;
+
+	/**
+	 * Returns the index of the block (block_row, block_col), or -1 if the block is not occupied.
+	 *
+	 */
+	int FindBlock(int block_row, int block_col) const;
+
+	/**
+	 * Accessor to the number of occupied blocks.
+	 *
+	 */
+	size_t GetNumberOfBlocks() const {return block_keys_.size();};
+
+	/**
+	 * Returns the coordinates (in blocks) of a block.
+	 *
+	 */
+	void GetBlockCoordinates(size_t block, int& block_row, int& block_col) const {block_row = int(uint32_t(block_keys_[block] >> 32)); block_col = int(uint32_t(block_keys_[block]));};
+
+	/**
+	 * Releases the memory of the grid.
+	 *
+	 */
+	void Clear();
+
+	SparseGrid(){slot_bits_ = 0;}; // Constructor
+	~SparseGrid(){}; // Destructor
+
+private:
+
+	/**
+	 * Coordinates (block row in the high 32 bits, block column in the low 32 bits) of each block, in block index order.
+	 *
+	 */
+	std::vector<uint64_t> block_keys_;
+
+	/**
+	 * Open addressing (linear probing) hash table of the block indexes (-1 = free slot). Its size is a power of two.
+	 *
+	 */
+	std::vector<int> slots_;
+	unsigned int slot_bits_;
+
+	/**
+	 * Offsets of the cells of all the blocks in indexes_ (block_cells entries per block, plus the end offset).
+	 *
+	 */
+	std::vector<uint32_t> cell_offsets_;
+
+	/**
+	 * Point indexes of all the cells.
+	 *
+	 */
+	std::vector<int> indexes_;
+
+	static uint64_t BlockKey(int block_row, int block_col) {return (uint64_t(uint32_t(block_row)) << 32) | uint32_t(block_col);};
+
+	/**
+	 * Returns the slot of a block key in the hash table (its slot if it is stored, the free slot where it would be inserted otherwise).
+	 *
+	 */
+	size_t FindSlot(uint64_t key) const;
+
+	/**
+	 * Creates the hash table of the stored block keys.
+	 *
+	 */
+	void BuildTable(size_t n_blocks);
+
+	/**
+	 * Returns the index of the block of a key, inserting it if it is not stored yet.
+	 *
+	 */
+	int InsertBlock(uint64_t key);
+
+};
+
+
+// Find the slot of a block key
+inline size_t SparseGrid::FindSlot(uint64_t key) const
+{
+	size_t mask = slots_.size() - 1;
+	size_t slot = (key * 0x9E3779B97F4A7C15ULL) >> (64 - slot_bits_);
+
+	while ((slots_[slot] >= 0) and (block_keys_[slots_[slot]] != key)){
+
+		slot = (slot + 1) & mask;
+
+	}
+
+	return slot;
+}
+
+
+// Find the index of a block
+inline int SparseGrid::FindBlock(int block_row, int block_col) const
+{
+	if (slots_.empty()){
+
+		return -1;
+
+	}
+
+	return slots_[FindSlot(BlockKey(block_row, block_col))];
+}
+
+
+// Get the point indexes of a cell
+inline SparseGrid::Span SparseGrid::GetCell(int row, int col) const
+{
+	int block = ((row < 0) or (col < 0)) ? -1 : FindBlock(row >> block_bits, col >> block_bits);
+
+	if (block < 0){
+
+		return {NULL, NULL};
+
+	}
+
+	size_t cell = size_t(block) * block_cells + (col & (block_size - 1)) * block_size + (row & (block_size - 1));
+
+	return {indexes_.data() + cell_offsets_[cell], indexes_.data() + cell_offsets_[cell + 1]};
+}
+
+
+// Call a function with the spans of the cells of a column
+template <typename Function>
+void SparseGrid::ForEachColumnSpan(int col, int row_begin, int row_end, Function f) const
+{
+	if ((col < 0) or (row_end < 0)){
+
+		return;
+
+	}
+
+	int block_col = col >> block_bits;
+	size_t column_offset = size_t(col & (block_size - 1)) * block_size;
+
+	for (int row(row_begin < 0 ? 0 : row_begin); row <= row_end; ){
+
+		int block_row = row >> block_bits;
+		int segment_end = (block_row << block_bits) + block_size - 1;
+		segment_end = (segment_end < row_end) ? segment_end : row_end;
+		int block = FindBlock(block_row, block_col);
+
+		if (block >= 0){
+
+			size_t first_cell = size_t(block) * block_cells + column_offset;
+			Span span = {indexes_.data() + cell_offsets_[first_cell + (row & (block_size - 1))], indexes_.data() + cell_offsets_[first_cell + (segment_end & (block_size - 1)) + 1]};
+
+			if (not span.empty()){
+
+				f(span);
+
+			}
+		}
+
+		row = segment_end + 1;
+
+	}
+}
+
+
+// Build the grid
+template <typename PointVector>
+void SparseGrid::Build(const PointVector& points)
+{
+	Clear();
+	BuildTable(0);
+
+	// Block of each point, and number of points per cell
+	std::vector<uint32_t> cells(points.size());
+	std::vector<uint32_t> counts;
+
+	for (size_t j(0); j < points.size(); j++){
+
+		int block = InsertBlock(BlockKey(points[j].row >> block_bits, points[j].col >> block_bits));
+		cells[j] = uint32_t(block) * block_cells + (points[j].col & (block_size - 1)) * block_size + (points[j].row & (block_size - 1));
+
+		if (counts.size() < block_keys_.size() * block_cells){
+
+			counts.resize(block_keys_.size() * block_cells, 0);
+
+		}
+
+		counts[cells[j]]++;
+
+	}
+
+	// Cell offsets, then point indexes in increasing order
+	cell_offsets_.assign(counts.size() + 1, 0);
+
+	for (size_t j(0); j < counts.size(); j++){
+
+		cell_offsets_[j+1] = cell_offsets_[j] + counts[j];
+
+	}
+
+	indexes_.resize(points.size());
+	std::vector<uint32_t> position(cell_offsets_.begin(), cell_offsets_.end() - 1);
+
+	for (size_t j(0); j < points.size(); j++){
+
+		indexes_[position[cells[j]]++] = int(j);
+
+	}
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "SparseTable2D.h"
+
+using namespace std;
+
+
+// Build the tables of a raster
+void SparseTable2D::Build(const vector<uint32_t>& keys, int n_rows, int n_cols, int max_extent)
+{
+	n_rows_ = n_rows;
+	n_cols_ = n_cols;
+	max_extent = max(1, max_extent);
+
+	log2_.assign(max_extent + 1, 0);
+
+	for (int n(2); n <= max_extent; n++){
+
+		log2_[n] = log2_[n / 2] + 1;
+
+	}
+
+	n_levels_ = log2_[max_extent] + 1;
+	size_t n_cells = size_t(n_rows_) * n_cols_;
+	tables_.resize(n_levels_ * n_levels_ * n_cells);
+	copy(keys.begin(), keys.begin() + n_cells, tables_.begin());
+
+	// Double the number of columns along the first row of levels, then the number of rows of each level. Rectangles
+	// running past the raster edge are truncated, so that all the cells of a table are set.
+	for (unsigned int ky(0); ky < n_levels_; ky++){
+
+		for (unsigned int kx(0); kx < n_levels_; kx++){
+
+			if ((ky == 0) and (kx == 0)){
+
+				continue;
+
+			}
+
+			uint32_t* table = tables_.data() + size_t(ky * n_levels_ + kx) * n_cells;
+
+			if (ky == 0){
+
+				const uint32_t* previous = GetTable(0, kx - 1);
+				int offset = 1 << (kx - 1);
+
+				for (int row(0); row < n_rows_; row++){
+
+					const uint32_t* left = previous + size_t(row) * n_cols_;
+					uint32_t* out = table + size_t(row) * n_cols_;
+
+					for (int col(0); col < n_cols_; col++){
+
+						out[col] = min(left[col], left[min(col + offset, n_cols_ - 1)]);
+
+					}
+				}
+
+			} else {
+
+				const uint32_t* previous = GetTable(ky - 1, kx);
+				int offset = 1 << (ky - 1);
+
+				for (int row(0); row < n_rows_; row++){
+
+					const uint32_t* top = previous + size_t(row) * n_cols_;
+					const uint32_t* bottom = previous + size_t(min(row + offset, n_rows_ - 1)) * n_cols_;
+					uint32_t* out = table + size_t(row) * n_cols_;
+
+					for (int col(0); col < n_cols_; col++){
+
+						out[col] = min(top[col], bottom[col]);
+
+					}
+				}
+			}
+		}
+	}
+}
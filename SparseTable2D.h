@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class is a two dimensional sparse table of a raster of keys, answering the minimum key within any rectangle
+ * with four lookups. For each pair of powers of two (2^ky rows, 2^kx columns) up to the largest rectangle side, the
+ * table holds the minimum of the rectangle of that size starting at each raster cell. A rectangle is covered by the
+ * four (possibly overlapping) rectangles of the largest powers of two fitting in its sides, so the cost of a query does
+ * not depend on its size. The memory is the size of the raster times the square of the number of powers of two.
+ *
+ */
+
+#ifndef SPARSETABLE2D_H
+#define SPARSETABLE2D_H
+
+#include <vector>
+#include <cstdint>
+
+class SparseTable2D {
+
+public:
+
+	/**
+	 * Builds the table of a raster (the memory of the previous table is reused).
+	 *
+	 * @param  keys The keys of the raster cells, in row-major order.
+	 * @param  n_rows The number of rows of the raster.
+	 * @param  n_cols The number of columns of the raster.
+	 * @param  max_extent The largest number of rows or columns of a query rectangle.
+	 */
+	void Build(const std::vector<uint32_t>& keys, int n_rows, int n_cols, int max_extent);
+
+	/**
+	 * Returns the minimum key within a rectangle, which must be inside the raster and no larger than max_extent.
+	 *
+	 * @param  row The first row of the rectangle.
+	 * @param  col The first column of the rectangle.
+	 * @param  n_rows The number of rows of the rectangle.
+	 * @param  n_cols The number of columns of the rectangle.
+	 */
+	uint32_t GetMinimum(int row, int col, int n_rows, int n_cols) const;
+
+	SparseTable2D(){n_rows_ = 0; n_cols_ = 0; n_levels_ = 0;}; // Constructor
+	~SparseTable2D(){}; // Destructor
+
+private:
+
+	int n_rows_;
+	int n_cols_;
+	unsigned int n_levels_; // Number of powers of two along each side
+
+	/**
+	 * Tables of each level (ky, kx), stored at offset (ky * n_levels_ + kx) * n_rows_ * n_cols_, in row-major order.
+	 *
+	 */
+	std::vector<uint32_t> tables_;
+
+	/**
+	 * Floor of the base 2 logarithm of each extent, up to max_extent.
+	 *
+	 */
+	std::vector<uint8_t> log2_;
+
+	const uint32_t* GetTable(unsigned int ky, unsigned int kx) const {return tables_.data() + size_t(ky * n_levels_ + kx) * n_rows_ * n_cols_;};
+
+};
+
+
+// Get the minimum key within a rectangle
+inline uint32_t SparseTable2D::GetMinimum(int row, int col, int n_rows, int n_cols) const
+{
+	unsigned int ky = log2_[n_rows];
+	unsigned int kx = log2_[n_cols];
+	const uint32_t* table = GetTable(ky, kx);
+	int row_1 = row + n_rows - (1 << ky);
+	int col_1 = col + n_cols - (1 << kx);
+
+	uint32_t a = table[size_t(row) * n_cols_ + col];
+	uint32_t b = table[size_t(row) * n_cols_ + col_1];
+	uint32_t c = table[size_t(row_1) * n_cols_ + col];
+	uint32_t d = table[size_t(row_1) * n_cols_ + col_1];
+
+	a = (b < a) ? b : a;
+	c = (d < c) ? d : c;
+
+	return (c < a) ? c : a;
+}
+
+#endif
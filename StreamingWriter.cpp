@@ -0,0 +1,152 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <deque>
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "StreamingWriter.h"
+#include "PointCollection.h"
+#include "TreeCollection.h"
+#include "FileIO.h"
+#include "BlockGzip.h"
+
+using namespace std;
+
+
+// Create the output files and start the writer thread
+bool StreamingWriter::Start()
+{
+	if (not (file_io_.OpenPointOutput(points_file_, precision_) and file_io_.OpenTreeOutput(trees_file_, precision_))){
+		
+		return false;
+		
+	}
+	
+	closed_ = false;
+	thread_ = thread(&StreamingWriter::Run, this);
+	
+	return true;
+}
+
+
+// Queue a finished tree
+void StreamingWriter::Push(unsigned int tree_idx, vector<unsigned int>& point_idx)
+{
+	unique_lock<mutex> lock(queue_mutex_);
+	not_full_.wait(lock, [&]{ return queue_.size() < capacity_; });
+	
+	queue_.push_back(FinishedTree());
+	queue_.back().tree_idx = tree_idx;
+	queue_.back().point_idx.swap(point_idx);
+	not_empty_.notify_one();
+}
+
+
+// Write the queued trees
+void StreamingWriter::Run()
+{
+	PointCollection tree_points;
+	FinishedTree tree;
+	
+	while (true){
+		
+		{
+			unique_lock<mutex> lock(queue_mutex_);
+			not_empty_.wait(lock, [&]{ return closed_ or (not queue_.empty()); });
+			
+			if (queue_.empty()){
+				
+				return;
+				
+			}
+			
+			tree.tree_idx = queue_.front().tree_idx;
+			tree.point_idx.swap(queue_.front().point_idx);
+			queue_.pop_front();
+			not_full_.notify_one();
+		}
+		
+		// Restore the height order of the points, so that the first point is the top of the tree
+		sort(tree.point_idx.begin(), tree.point_idx.end(), [this](unsigned int a, unsigned int b){ return point_collection_.GetHeightRank(a) < point_collection_.GetHeightRank(b); });
+		
+		bool unassigned = (tree.tree_idx == PointCollection::unassigned_tree);
+		array<unsigned int, 3> rgb_color = unassigned ? array<unsigned int, 3>{0, 0, 0} : colormap_[tree.tree_idx % colormap_.size()];
+		tree_points.points_.clear();
+		
+		for (unsigned int j(0); j < tree.point_idx.size(); j++){
+			
+			tree_points.points_.push_back(point_collection_.points_[tree.point_idx[j]]);
+			tree_points.points_.back().tree_idx = tree.tree_idx;
+			tree_points.points_.back().rgb_color = rgb_color;
+			FileIO::WritePointRow(points_file_, tree_points.points_.back());
+			
+		}
+		
+		if ((not unassigned) and (not tree_points.points_.empty()) and tree_collection_.AddTree(tree_points, min_n_points_, min_height_)){
+			
+			FileIO::WriteTreeRow(trees_file_, tree_collection_.trees_.back());
+			
+		}
+	}
+}
+
+
+// Wait for the queued trees and close the output files
+bool StreamingWriter::Finish()
+{
+	if (not thread_.joinable()){
+		
+		return false;
+		
+	}
+	
+	{
+		lock_guard<mutex> lock(queue_mutex_);
+		closed_ = true;
+		not_empty_.notify_one();
+	}
+	
+	thread_.join();
+	bool points_written = points_file_.Close();
+	bool trees_written = trees_file_.Close();
+	
+	return points_written and trees_written;
+}
+
+
+unsigned int StreamingWriter::GetNumberOfTrees()
+{
+	return tree_collection_.trees_.size();
+}
+
+
+const TreeCollection& StreamingWriter::GetTreeCollection()
+{
+	return tree_collection_;
+}
+
+
+// Constructor
+StreamingWriter::StreamingWriter(PointCollection& point_collection, FileIO& file_io, const vector<array<unsigned int, 3>>& colormap, unsigned int precision, unsigned int min_n_points, unsigned int min_height, unsigned int capacity) : point_collection_(point_collection), file_io_(file_io)
+{
+	colormap_ = colormap;
+	precision_ = precision;
+	min_n_points_ = min_n_points;
+	min_height_ = min_height;
+	capacity_ = max(1u, capacity);
+	closed_ = true;
+}
+
+
+// Destructor
+StreamingWriter::~StreamingWriter()
+{
+	if (thread_.joinable()){
+		
+		Finish();
+		
+	}
+}
@@ -0,0 +1,137 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class writes the segmented points and the tree attributes while the segmentation is running.
+ *
+ * The segmenter pushes each finished tree (its index and the indexes of its points) to a bounded queue. A writer
+ * thread colors and writes the points of the tree, computes its attributes and writes them, so that the output files
+ * are complete shortly after the last tree is found. When the queue is full, the segmenter waits for the writer.
+ * The points are written grouped by tree, in increasing tree index order.
+ *
+ */
+
+#ifndef STREAMINGWRITER_H
+#define STREAMINGWRITER_H
+
+#include <vector>
+#include <array>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "PointCollection.h"
+#include "TreeCollection.h"
+#include "FileIO.h"
+#include "BlockGzip.h"
+
+class StreamingWriter {
+
+public:
+
+	/**
+	 * Creates the output files and starts the writer thread.
+	 *
+	 * @return Returns false if the output files could not be created.
+	 */
+	bool Start();
+
+	/**
+	 * Queues a finished tree. Blocks while the queue is full.
+	 *
+	 * @param  tree_idx The index of the tree.
+	 * @param  point_idx The indexes of the Points of the tree in the segmented PointCollection (the contents are taken).
+	 */
+	void Push(unsigned int tree_idx, std::vector<unsigned int>& point_idx);
+
+	/**
+	 * Waits until all the queued trees are written and closes the output files.
+	 *
+	 * @return Returns false if an output file could not be written.
+	 */
+	bool Finish();
+
+	/**
+	 * Returns the number of trees written to the tree output file (trees with too few points or too low are skipped).
+	 *
+	 */
+	unsigned int GetNumberOfTrees();
+
+	/**
+	 * Returns the trees written to the tree output file (complete after Finish).
+	 *
+	 */
+	const TreeCollection& GetTreeCollection();
+
+	/**
+	 * Creates a streaming writer.
+	 *
+	 * @param  point_collection A reference to the PointCollection being segmented. Its Points must not move until Finish.
+	 * @param  file_io A reference to the FileIO of the input file, which gives the output file paths.
+	 * @param  colormap The colormap used to color the points by tree index.
+	 * @param  precision The decimal precision used for double values in the output files.
+	 * @param  min_n_points The minimum number of points of a tree.
+	 * @param  min_height The minimum height of a tree.
+	 * @param  capacity The maximum number of queued trees.
+	 */
+	StreamingWriter(PointCollection& point_collection, FileIO& file_io, const std::vector<std::array<unsigned int, 3>>& colormap, unsigned int precision, unsigned int min_n_points, unsigned int min_height, unsigned int capacity); // Constructor
+	~StreamingWriter(); // Destructor (finishes the writing)
+
+private:
+
+	/**
+	 * Finished tree waiting in the queue.
+	 *
+	 */
+	struct FinishedTree {
+
+		unsigned int tree_idx;
+		std::vector<unsigned int> point_idx;
+
+	};
+
+	/**
+	 * Writes the queued trees until Finish is called and the queue is empty (writer thread).
+	 *
+	 */
+	void Run();
+
+	PointCollection& point_collection_;
+	FileIO& file_io_;
+	std::vector<std::array<unsigned int, 3>> colormap_;
+	unsigned int precision_;
+	unsigned int min_n_points_;
+	unsigned int min_height_;
+	unsigned int capacity_;
+
+	OutputStream points_file_;
+	OutputStream trees_file_;
+	TreeCollection tree_collection_;
+
+	std::deque<FinishedTree> queue_;
+	std::mutex queue_mutex_;
+	std::condition_variable not_empty_;
+	std::condition_variable not_full_;
+	bool closed_;
+	std::thread thread_;
+
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <mutex>
+#include "TraceRecorder.h"
+
+using namespace std;
+
+
+atomic<bool> TraceRecorder::enabled_(false);
+unsigned int TraceRecorder::sampling_period_ = 1;
+chrono::steady_clock::time_point TraceRecorder::origin_;
+vector<unique_ptr<TraceRecorder::ThreadBuffer>> TraceRecorder::registry_;
+mutex TraceRecorder::registry_mutex_;
+
+
+// Enable the recording
+void TraceRecorder::Enable(unsigned int sampling_period)
+{
+	sampling_period_ = (sampling_period > 0) ? sampling_period : 1;
+	origin_ = chrono::steady_clock::now();
+	enabled_ = true;
+}
+
+
+// Register the buffer of the calling thread on first use
+TraceRecorder::ThreadBuffer& TraceRecorder::GetThreadBuffer()
+{
+	thread_local ThreadBuffer* thread_buffer = NULL;
+
+	if (thread_buffer == NULL){
+
+		lock_guard<mutex> lock(registry_mutex_);
+		registry_.push_back(unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+		thread_buffer = registry_.back().get();
+		thread_buffer->tid = registry_.size();
+		thread_buffer->n_iterations = 0;
+		thread_buffer->spans.reserve(4096);
+
+	}
+
+	return *thread_buffer;
+}
+
+
+// Count an iteration of the calling thread
+bool TraceRecorder::CountIteration()
+{
+	return (GetThreadBuffer().n_iterations++ % sampling_period_) == 0;
+}
+
+
+// Append a span to the buffer of the calling thread
+void TraceRecorder::AddSpan(const char* name, chrono::steady_clock::time_point start, bool is_iteration, const IterationArgs& args)
+{
+	chrono::steady_clock::time_point stop = chrono::steady_clock::now();
+	Span span;
+	span.name = name;
+	span.ts = chrono::duration<double, micro>(start - origin_).count();
+	span.dur = chrono::duration<double, micro>(stop - start).count();
+	span.is_iteration = is_iteration;
+	span.args = args;
+	GetThreadBuffer().spans.push_back(span);
+}
+
+
+// Record a processing stage
+void TraceRecorder::AddStage(const char* name, chrono::steady_clock::time_point start)
+{
+	if (enabled_){
+
+		IterationArgs args = {0.0, 0.0, 0.0, 0.0, 0, 0, 0};
+		AddSpan(name, start, false, args);
+
+	}
+}
+
+
+// Record a segmentation iteration
+void TraceRecorder::AddIteration(chrono::steady_clock::time_point start, const IterationArgs& args)
+{
+	AddSpan("iteration", start, true, args);
+}
+
+
+// Write the spans in the Chrome trace event format
+bool TraceRecorder::Write(const string& filepath)
+{
+	ofstream o_file(filepath);
+
+	if (not o_file){
+
+		cerr << "FAILURE: unable to open output file " << filepath << endl;
+		return false;
+
+	}
+
+	lock_guard<mutex> lock(registry_mutex_);
+
+	o_file << fixed << setprecision(3);
+	o_file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl;
+	o_file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"TreeSegmentation\"}}";
+
+	for (unsigned int j(0); j < registry_.size(); j++){
+
+		const ThreadBuffer& buffer = *registry_[j];
+		o_file << "," << endl << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer.tid << ", \"args\": {\"name\": \"" << ((buffer.tid == 1) ? "main" : "thread " + to_string(buffer.tid)) << "\"}}";
+
+		for (unsigned int k(0); k < buffer.spans.size(); k++){
+
+			const Span& span = buffer.spans[k];
+			o_file << "," << endl << "{\"name\": \"" << span.name << "\", \"cat\": \"" << (span.is_iteration ? "iteration" : "stage") << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer.tid;
+			o_file << ", \"ts\": " << span.ts << ", \"dur\": " << span.dur;
+
+			if (span.is_iteration){
+
+				const IterationArgs& args = span.args;
+				o_file << ", \"args\": {\"seed_x\": " << args.seed_x << ", \"seed_y\": " << args.seed_y << ", \"seed_z\": " << args.seed_z << ", \"radius\": " << args.radius;
+				o_file << ", \"sample\": " << args.n_sample << ", \"P\": " << args.n_P << ", \"N\": " << args.n_N << "}";
+
+			}
+
+			o_file << "}";
+
+		}
+	}
+
+	o_file << endl << "]}" << endl;
+
+	return bool(o_file);
+}
@@ -0,0 +1,160 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class records a timeline of a run and writes it in the Chrome trace event format (JSON), which can be
+ * opened with chrome://tracing or Perfetto.
+ *
+ * The timeline contains one span per processing stage and one span per sampled segmentation iteration, with the
+ * position and height of the seed, the buffer radius and the sizes of the sample and of the P and N groups. Each
+ * thread appends its spans to its own buffer, without locking. The buffers are registered once per thread and
+ * written at the end of the run, once all the threads have finished recording.
+ *
+ */
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+
+class TraceRecorder {
+
+public:
+
+	/**
+	 * Arguments of a segmentation iteration span.
+	 *
+	 */
+	struct IterationArgs {
+
+		double seed_x;
+		double seed_y;
+		double seed_z;
+		double radius;
+		unsigned int n_sample;
+		unsigned int n_P;
+		unsigned int n_N;
+
+	};
+
+	/**
+	 * Enables the recording.
+	 *
+	 * @param  sampling_period One segmentation iteration in sampling_period is recorded (1 = all iterations).
+	 */
+	static void Enable(unsigned int sampling_period);
+
+	static bool IsEnabled() { return enabled_; };
+
+	/**
+	 * Records a processing stage span.
+	 *
+	 * @param  name The name of the stage.
+	 * @param  start The start time of the stage. The span ends now.
+	 */
+	static void AddStage(const char* name, std::chrono::steady_clock::time_point start);
+
+	/**
+	 * Decides whether the current segmentation iteration of the calling thread is recorded.
+	 *
+	 * @return Returns true if the iteration is sampled, in which case AddIteration must be called at its end.
+	 */
+	static inline bool SampleIteration()
+	{
+		return enabled_ and CountIteration();
+	};
+
+	/**
+	 * Records a segmentation iteration span.
+	 *
+	 * @param  start The start time of the iteration. The span ends now.
+	 * @param  args The IterationArgs of the iteration.
+	 */
+	static void AddIteration(std::chrono::steady_clock::time_point start, const IterationArgs& args);
+
+	/**
+	 * Writes the recorded spans to a JSON file. No span may be recorded concurrently.
+	 *
+	 * @param  filepath The output file path.
+	 * @return Returns true if the file could be written.
+	 */
+	static bool Write(const std::string& filepath);
+
+private:
+
+	/**
+	 * Recorded span.
+	 *
+	 */
+	struct Span {
+
+		const char* name;
+		double ts; // Start time in microseconds since Enable
+		double dur; // Duration in microseconds
+		bool is_iteration;
+		IterationArgs args;
+
+	};
+
+	/**
+	 * Spans of a thread.
+	 *
+	 */
+	struct ThreadBuffer {
+
+		unsigned int tid;
+		std::vector<Span> spans;
+		unsigned long long n_iterations;
+
+	};
+
+	/**
+	 * Returns the buffer of the calling thread, registered on first use.
+	 *
+	 */
+	static ThreadBuffer& GetThreadBuffer();
+
+	/**
+	 * Counts an iteration of the calling thread.
+	 *
+	 * @return Returns true if the iteration is sampled.
+	 */
+	static bool CountIteration();
+
+	static void AddSpan(const char* name, std::chrono::steady_clock::time_point start, bool is_iteration, const IterationArgs& args);
+
+	static std::atomic<bool> enabled_;
+	static unsigned int sampling_period_;
+	static std::chrono::steady_clock::time_point origin_;
+
+	/**
+	 * Buffers of all the threads which recorded spans, kept after the threads exit.
+	 *
+	 */
+	static std::vector<std::unique_ptr<ThreadBuffer>> registry_;
+	static std::mutex registry_mutex_;
+
+};
+
+#endif
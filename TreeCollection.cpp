@@ -1,6 +1,7 @@
 #include <iostream>
 #include <vector>
 #include <array>
+#include <algorithm>
 #include "PointCollection.h"
 #include "TreeCollection.h"
 
@@ -9,73 +10,108 @@ using namespace std;
 TreeCollection::TreeCollection(PointCollection& point_collection, unsigned int min_n_points, unsigned int min_height)
 {
 	
-	TreeCollection::Tree tree;
+	if (point_collection.points_.empty()){
+		
+		return;
+		
+	}
+	
+	// Tree indexes may have gaps (e.g. after an incremental update), so count the points of each index up to the largest
+	// one (the unassigned points are counted after it, and are not part of any tree)
+	unsigned int max_tree_idx(0);
+	for (unsigned int j(0); j < point_collection.points_.size(); j++){
+		
+		if (point_collection.points_[j].tree_idx != PointCollection::unassigned_tree){
+			
+			max_tree_idx = max(max_tree_idx, point_collection.points_[j].tree_idx);
+			
+		}
+	}
+	
+	vector<unsigned int> offsets(max_tree_idx + 3, 0);
+	
+	for (unsigned int j(0); j < point_collection.points_.size(); j++){
+		
+		offsets[min(point_collection.points_[j].tree_idx, max_tree_idx + 1) + 1]++;
+		
+	}
+	
+	for (unsigned int k(0); k <= max_tree_idx + 1; k++){
+		
+		offsets[k+1] += offsets[k];
+		
+	}
+	
+	// Group the point indexes by tree in a single pass, keeping the order of the points within each tree
+	vector<unsigned int> indexes(point_collection.points_.size());
+	vector<unsigned int> position(offsets.begin(), offsets.end() - 1);
+	
+	for (unsigned int j(0); j < point_collection.points_.size(); j++){
+		
+		indexes[position[min(point_collection.points_[j].tree_idx, max_tree_idx + 1)]++] = j;
+		
+	}
+	
 	PointCollection temp_point_collection;
-	array<double, 3> barycenter;
-	unsigned int idx(0);
-	unsigned int k(0);
-	bool test(true);
 	
-	while(test){
+	for (unsigned int k(0); k <= max_tree_idx; k++){
 	
 		// Extract points belonging to the same tree
-		for (unsigned int j(0); j < point_collection.points_.size(); j++){
+		for (unsigned int j(offsets[k]); j < offsets[k+1]; j++){
 			
-			// Extract points belonging to the same tree
-			if (point_collection.points_[j].tree_idx == k){
-				
-				temp_point_collection.points_.push_back(point_collection.points_[j]);
-				
-			}
+			temp_point_collection.points_.push_back(point_collection.points_[indexes[j]]);
 			
 		}
 		
 		if (temp_point_collection.points_.size() != 0){
 			
-			test = true;
-			
-			// Compute tree attributes
-			tree.x_top = temp_point_collection.points_[0].x;
-			tree.y_top = temp_point_collection.points_[0].y;
-			tree.h_top = temp_point_collection.points_[0].z;
-			tree.n_points = temp_point_collection.points_.size();
-				
-			// Filter trees based on minimum number of points and height
-			if ((tree.n_points >= min_n_points) and (tree.h_top >= min_height)){
-				
-				tree.tree_idx = idx;
-				
-				// Compute the tree barycenter
-				barycenter = ComputeBarycenter(temp_point_collection);
-				tree.x_barycenter = barycenter[0];
-				tree.y_barycenter = barycenter[1];
-				tree.h_barycenter = barycenter[2];
-				tree.rel_h_barycenter = tree.h_barycenter/tree.h_top;
-				
-				trees_.push_back(tree);
-				idx++;
-				
-			}
-			
-
-		} else {
-			
-			test = false;
+			AddTree(temp_point_collection, min_n_points, min_height);
 			
 		}
-			
 		
 		temp_point_collection.points_.clear();
-		k++;
 	}
 	
 }
 
 // Compute the trees barycenter
-array<double, 3> TreeCollection::ComputeBarycenter(PointCollection point_collection){
+// Compute the attributes of a tree and add it to the collection if it passes the filters
+bool TreeCollection::AddTree(PointCollection& tree_points, unsigned int min_n_points, unsigned int min_height)
+{
+	TreeCollection::Tree tree;
+	
+	// Compute tree attributes (the points are sorted by height)
+	tree.x_top = tree_points.points_[0].x;
+	tree.y_top = tree_points.points_[0].y;
+	tree.h_top = tree_points.points_[0].z;
+	tree.n_points = tree_points.points_.size();
+		
+	// Filter trees based on minimum number of points and height
+	if ((tree.n_points < min_n_points) or (tree.h_top < min_height)){
+		
+		return false;
+		
+	}
+	
+	tree.tree_idx = trees_.size();
+	
+	// Compute the tree barycenter
+	array<double, 3> barycenter = ComputeBarycenter(tree_points);
+	tree.x_barycenter = barycenter[0];
+	tree.y_barycenter = barycenter[1];
+	tree.h_barycenter = barycenter[2];
+	tree.rel_h_barycenter = tree.h_barycenter/tree.h_top;
+	
+	trees_.push_back(tree);
+	
+	return true;
+}
+
+
+array<double, 3> TreeCollection::ComputeBarycenter(const PointCollection& point_collection){
 	
 	array<double, 3> barycenter;
-	double x_sum, y_sum, z_sum;
+	double x_sum(0.0), y_sum(0.0), z_sum(0.0);
 	
 	for (unsigned int j(0); j < point_collection.points_.size(); j++){
 		
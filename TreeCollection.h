@@ -32,9 +32,22 @@
 class TreeCollection {
 
 friend class FileIO;
+friend class SegmentationPipeline;
+friend class StreamingWriter;
 
 public:
 	
+	/**
+	 * Computes the attributes of a tree and appends it to the collection, unless it has too few points or is too low.
+	 *
+	 * @param  tree_points A PointCollection containing all the Points of the tree, sorted by height.
+	 * @param  min_n_points The minimum number of points of a tree.
+	 * @param  min_height The minimum height of a tree.
+	 * @return Returns true if the tree was added.
+	 */
+	bool AddTree(PointCollection& tree_points, unsigned int min_n_points, unsigned int min_height);
+	
+	TreeCollection(){}; // Constructor
 	TreeCollection(PointCollection& point_collection, unsigned int min_n_points, unsigned int min_height); // Constructor
 	~TreeCollection(){}; // Destructor
 	
@@ -64,7 +77,7 @@ private:
 	 * @param  point_collection A PointCollection representing a tree.
 	 * @return Return the x, y, z coordinates of the barycenter.
 	 */
-	std::array<double, 3> ComputeBarycenter(PointCollection point_collection);
+	std::array<double, 3> ComputeBarycenter(const PointCollection& point_collection);
 	
 	std::vector<Tree> trees_;
 	
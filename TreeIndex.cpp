@@ -0,0 +1,407 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "TreeIndex.h"
+#include "PointCollection.h"
+
+using namespace std;
+
+
+// Map a whole file in memory
+static void* MapFile(const string& filepath, size_t& size)
+{
+	#ifdef _WIN32
+
+		return NULL;
+
+	#else
+
+		int fd = open(filepath.c_str(), O_RDONLY);
+
+		if (fd < 0){
+
+			return NULL;
+
+		}
+
+		struct stat file_stat;
+
+		if ((fstat(fd, &file_stat) != 0) or (file_stat.st_size == 0)){
+
+			close(fd);
+			return NULL;
+
+		}
+
+		size = file_stat.st_size;
+		void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+
+		return (data == MAP_FAILED) ? NULL : data;
+
+	#endif
+}
+
+
+// Get the points file path of an index file
+string TreeIndex::GetPointsFilepath(const string& index_filepath)
+{
+	const string suffix = "_tree_index.bin";
+
+	if ((index_filepath.size() >= suffix.size()) and (index_filepath.compare(index_filepath.size() - suffix.size(), suffix.size(), suffix) == 0)){
+
+		return index_filepath.substr(0, index_filepath.size() - suffix.size()) + "_tree_points.bin";
+
+	}
+
+	return index_filepath + ".points";
+}
+
+
+// Order boxes in Sort-Tile-Recursive order
+vector<uint32_t> TreeIndex::SortTileRecursive(const vector<Node>& boxes, uint32_t node_capacity)
+{
+	vector<uint32_t> order(boxes.size());
+
+	for (uint32_t j(0); j < order.size(); j++){
+
+		order[j] = j;
+
+	}
+
+	// Sort by x center, then cut into about sqrt(n_nodes) slices of whole nodes, sorted by y center
+	size_t n_nodes = (boxes.size() + node_capacity - 1) / node_capacity;
+	size_t n_slices = (size_t) ceil(sqrt(double(n_nodes)));
+	size_t slice_size = n_slices * node_capacity;
+
+	sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){ return (boxes[a].x_min + boxes[a].x_max) < (boxes[b].x_min + boxes[b].x_max); });
+
+	for (size_t begin(0); begin < order.size(); begin += slice_size){
+
+		size_t end = min(order.size(), begin + slice_size);
+		sort(order.begin() + begin, order.begin() + end, [&](uint32_t a, uint32_t b){ return (boxes[a].y_min + boxes[a].y_max) < (boxes[b].y_min + boxes[b].y_max); });
+
+	}
+
+	return order;
+}
+
+
+// Write the points grouped by tree and the index of the trees
+bool TreeIndex::Write(const PointCollection& point_collection, const string& index_filepath)
+{
+	const vector<PointCollection::Point>& points = point_collection.points_;
+	const uint32_t node_capacity = 16;
+
+	// Group the points by tree, keeping their order within each tree
+	vector<uint32_t> order(points.size());
+
+	for (uint32_t j(0); j < order.size(); j++){
+
+		order[j] = j;
+
+	}
+
+	stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){ return points[a].tree_idx < points[b].tree_idx; });
+
+	// Points file and tree records
+	ofstream points_file(GetPointsFilepath(index_filepath), ios::binary);
+	vector<TreeRecord> trees;
+	vector<PointRecord> records;
+	records.reserve(65536);
+
+	for (uint32_t j(0); j < order.size(); j++){
+
+		const PointCollection::Point& point = points[order[j]];
+
+		if (trees.empty() or (trees.back().tree_idx != point.tree_idx)){
+
+			TreeRecord tree = {point.tree_idx, 0, j, point.x, point.y, point.x, point.y, point.z};
+			trees.push_back(tree);
+
+		}
+
+		TreeRecord& tree = trees.back();
+		tree.n_points++;
+		tree.x_min = min(tree.x_min, point.x);
+		tree.y_min = min(tree.y_min, point.y);
+		tree.x_max = max(tree.x_max, point.x);
+		tree.y_max = max(tree.y_max, point.y);
+		tree.z_max = max(tree.z_max, point.z);
+
+		records.push_back({point.x, point.y, point.z, point.tree_idx, point.classification});
+
+		if (records.size() == records.capacity()){
+
+			points_file.write((const char*) records.data(), records.size() * sizeof(PointRecord));
+			records.clear();
+
+		}
+	}
+
+	points_file.write((const char*) records.data(), records.size() * sizeof(PointRecord));
+
+	if (not points_file){
+
+		return false;
+
+	}
+
+	// Leaves of the R-tree over the tree bounding boxes
+	vector<Node> boxes(trees.size());
+
+	for (uint32_t k(0); k < trees.size(); k++){
+
+		boxes[k] = {trees[k].x_min, trees[k].y_min, trees[k].x_max, trees[k].y_max, k, 1, 1, 0};
+
+	}
+
+	vector<uint32_t> items = SortTileRecursive(boxes, node_capacity);
+	vector<Node> nodes, level;
+
+	for (uint32_t begin(0); begin < items.size(); begin += node_capacity){
+
+		uint32_t end = min((uint32_t) items.size(), begin + node_capacity);
+		Node node = {HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL, begin, end - begin, 1, 0};
+
+		for (uint32_t j(begin); j < end; j++){
+
+			node.x_min = min(node.x_min, boxes[items[j]].x_min);
+			node.y_min = min(node.y_min, boxes[items[j]].y_min);
+			node.x_max = max(node.x_max, boxes[items[j]].x_max);
+			node.y_max = max(node.y_max, boxes[items[j]].y_max);
+
+		}
+
+		level.push_back(node);
+
+	}
+
+	// Upper levels: the nodes of a level are stored in STR order, so that the children of each parent are contiguous
+	while (level.size() > 1){
+
+		vector<uint32_t> level_order = SortTileRecursive(level, node_capacity);
+		uint32_t base = nodes.size();
+		vector<Node> parents;
+
+		for (uint32_t j(0); j < level_order.size(); j++){
+
+			nodes.push_back(level[level_order[j]]);
+
+		}
+
+		for (uint32_t begin(0); begin < level_order.size(); begin += node_capacity){
+
+			uint32_t end = min((uint32_t) level_order.size(), begin + node_capacity);
+			Node node = {HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL, base + begin, end - begin, 0, 0};
+
+			for (uint32_t j(base + begin); j < base + end; j++){
+
+				node.x_min = min(node.x_min, nodes[j].x_min);
+				node.y_min = min(node.y_min, nodes[j].y_min);
+				node.x_max = max(node.x_max, nodes[j].x_max);
+				node.y_max = max(node.y_max, nodes[j].y_max);
+
+			}
+
+			parents.push_back(node);
+
+		}
+
+		level.swap(parents);
+
+	}
+
+	nodes.insert(nodes.end(), level.begin(), level.end());
+
+	// Index file
+	ofstream index_file(index_filepath, ios::binary);
+	Header header;
+	memcpy(header.magic, "TSTIDX01", 8);
+	header.n_trees = trees.size();
+	header.n_points = points.size();
+	header.n_nodes = nodes.size();
+	header.node_capacity = node_capacity;
+	header.root = nodes.empty() ? 0 : nodes.size() - 1;
+
+	index_file.write((const char*) &header, sizeof(header));
+	index_file.write((const char*) trees.data(), trees.size() * sizeof(TreeRecord));
+	index_file.write((const char*) nodes.data(), nodes.size() * sizeof(Node));
+	index_file.write((const char*) items.data(), items.size() * sizeof(uint32_t));
+
+	return bool(index_file);
+}
+
+
+// Map an index file and its points file
+bool TreeIndex::Open(const string& index_filepath)
+{
+	Close();
+
+	index_data_ = MapFile(index_filepath, index_size_);
+	points_data_ = MapFile(GetPointsFilepath(index_filepath), points_size_);
+
+	if ((index_data_ == NULL) or (index_size_ < sizeof(Header))){
+
+		Close();
+		return false;
+
+	}
+
+	// Check the signature and the sizes of both files
+	header_ = (const Header*) index_data_;
+	bool valid = (memcmp(header_->magic, "TSTIDX01", 8) == 0);
+	valid = valid and (index_size_ == sizeof(Header) + header_->n_trees * (sizeof(TreeRecord) + sizeof(uint32_t)) + header_->n_nodes * sizeof(Node));
+	valid = valid and (header_->n_points == 0 or ((points_data_ != NULL) and (points_size_ == header_->n_points * sizeof(PointRecord))));
+	valid = valid and ((header_->n_trees == 0) or (header_->root < header_->n_nodes));
+
+	if (not valid){
+
+		Close();
+		return false;
+
+	}
+
+	trees_ = (const TreeRecord*) ((const char*) index_data_ + sizeof(Header));
+	nodes_ = (const Node*) (trees_ + header_->n_trees);
+	items_ = (const uint32_t*) (nodes_ + header_->n_nodes);
+	points_ = (const PointRecord*) points_data_;
+
+	return true;
+}
+
+
+// Unmap the files
+void TreeIndex::Close()
+{
+	#ifndef _WIN32
+
+		if (index_data_ != NULL){
+
+			munmap(index_data_, index_size_);
+
+		}
+
+		if (points_data_ != NULL){
+
+			munmap(points_data_, points_size_);
+
+		}
+
+	#endif
+
+	header_ = NULL;
+	trees_ = NULL;
+	nodes_ = NULL;
+	items_ = NULL;
+	points_ = NULL;
+	index_data_ = NULL;
+	points_data_ = NULL;
+	index_size_ = 0;
+	points_size_ = 0;
+}
+
+
+// Find a tree by identifier (binary search in the tree table)
+const TreeIndex::TreeRecord* TreeIndex::FindTree(uint32_t tree_idx) const
+{
+	if (header_ == NULL){
+
+		return NULL;
+
+	}
+
+	const TreeRecord* end = trees_ + header_->n_trees;
+	const TreeRecord* tree = lower_bound(trees_, end, tree_idx, [](const TreeRecord& a, uint32_t b){ return a.tree_idx < b; });
+
+	return ((tree != end) and (tree->tree_idx == tree_idx)) ? tree : NULL;
+}
+
+
+// Get the points of a tree
+const TreeIndex::PointRecord* TreeIndex::GetPoints(const TreeRecord& tree) const
+{
+	return points_ + tree.offset;
+}
+
+
+// Find the trees intersecting a rectangle
+vector<const TreeIndex::TreeRecord*> TreeIndex::FindTrees(double x_min, double y_min, double x_max, double y_max) const
+{
+	vector<const TreeRecord*> trees;
+
+	if ((header_ == NULL) or (header_->n_trees == 0)){
+
+		return trees;
+
+	}
+
+	vector<uint32_t> stack(1, header_->root);
+
+	while (not stack.empty()){
+
+		const Node& node = nodes_[stack.back()];
+		stack.pop_back();
+
+		if ((node.x_max < x_min) or (node.x_min > x_max) or (node.y_max < y_min) or (node.y_min > y_max)){
+
+			continue;
+
+		}
+
+		for (uint32_t j(node.first); j < node.first + node.count; j++){
+
+			if (node.leaf){
+
+				const TreeRecord& tree = trees_[items_[j]];
+
+				if ((tree.x_max >= x_min) and (tree.x_min <= x_max) and (tree.y_max >= y_min) and (tree.y_min <= y_max)){
+
+					trees.push_back(&tree);
+
+				}
+
+			} else {
+
+				stack.push_back(j);
+
+			}
+		}
+	}
+
+	return trees;
+}
+
+
+// Get the number of trees
+uint64_t TreeIndex::GetNumberOfTrees() const
+{
+	return (header_ == NULL) ? 0 : header_->n_trees;
+}
+
+
+// Constructor
+TreeIndex::TreeIndex()
+{
+	index_data_ = NULL;
+	points_data_ = NULL;
+	Close();
+}
+
+
+// Destructor
+TreeIndex::~TreeIndex()
+{
+	Close();
+}
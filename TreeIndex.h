@@ -0,0 +1,183 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class writes and queries the tree-grouped output of a segmentation. The points file contains the segmented
+ * points as binary records grouped by tree (in increasing tree identifier order, each tree in height order). The index
+ * file contains a table of the trees sorted by identifier, with the offset and the number of points of each tree and
+ * the bounding box of its crown, followed by a packed R-tree (Sort-Tile-Recursive) over the crown bounding boxes.
+ * Both files are memory-mapped by the queries, so that a tree or the trees of a rectangle are found without reading
+ * the whole segmentation.
+ *
+ */
+
+#ifndef TREEINDEX_H
+#define TREEINDEX_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "PointCollection.h"
+
+class TreeIndex {
+
+public:
+
+	/**
+	 * Point record of the points file.
+	 *
+	 */
+	struct PointRecord {
+
+		double x;
+		double y;
+		double z;
+		uint32_t tree_idx;
+		uint32_t classification;
+
+	};
+
+	/**
+	 * Tree record of the index file.
+	 *
+	 */
+	struct TreeRecord {
+
+		uint32_t tree_idx;
+		uint32_t n_points;
+		uint64_t offset; // Index of the first point of the tree in the points file
+		double x_min; // Bounding box of the crown
+		double y_min;
+		double x_max;
+		double y_max;
+		double z_max;
+
+	};
+
+	/**
+	 * Writes the points of a segmented PointCollection grouped by tree and the index of the trees.
+	 *
+	 * @param  point_collection A reference to the segmented PointCollection.
+	 * @param  index_filepath The index file path. The points file path is derived from it (see GetPointsFilepath).
+	 * @return Returns true if the files could be written.
+	 */
+	static bool Write(const PointCollection& point_collection, const std::string& index_filepath);
+
+	/**
+	 * Returns the path of the points file of an index file ("_tree_index.bin" replaced by "_tree_points.bin").
+	 *
+	 */
+	static std::string GetPointsFilepath(const std::string& index_filepath);
+
+	/**
+	 * Memory-maps an index file and its points file.
+	 *
+	 * @param  index_filepath The index file path.
+	 * @return Returns false if the files could not be mapped or are not consistent.
+	 */
+	bool Open(const std::string& index_filepath);
+
+	/**
+	 * Unmaps the files.
+	 *
+	 */
+	void Close();
+
+	/**
+	 * Finds a tree by identifier.
+	 *
+	 * @return Returns NULL if there is no such tree.
+	 */
+	const TreeRecord* FindTree(uint32_t tree_idx) const;
+
+	/**
+	 * Returns the points of a tree (TreeRecord::n_points records).
+	 *
+	 */
+	const PointRecord* GetPoints(const TreeRecord& tree) const;
+
+	/**
+	 * Finds the trees whose crown bounding box intersects a rectangle, using the R-tree.
+	 *
+	 * @return Returns the trees in R-tree order.
+	 */
+	std::vector<const TreeRecord*> FindTrees(double x_min, double y_min, double x_max, double y_max) const;
+
+	/**
+	 * Returns the number of trees of the index.
+	 *
+	 */
+	uint64_t GetNumberOfTrees() const;
+
+	TreeIndex(); // Constructor
+	~TreeIndex(); // Destructor (unmaps the files)
+
+private:
+
+	/**
+	 * Header of the index file.
+	 *
+	 */
+	struct Header {
+
+		char magic[8];
+		uint64_t n_trees;
+		uint64_t n_points;
+		uint64_t n_nodes;
+		uint32_t node_capacity;
+		uint32_t root; // Index of the root node
+
+	};
+
+	/**
+	 * Node of the R-tree. The children of a node (nodes, or tree records for the leaves) are stored contiguously.
+	 *
+	 */
+	struct Node {
+
+		double x_min;
+		double y_min;
+		double x_max;
+		double y_max;
+		uint32_t first; // First child node, or first entry of the leaf items for a leaf
+		uint32_t count;
+		uint32_t leaf;
+		uint32_t padding;
+
+	};
+
+	/**
+	 * Orders boxes in Sort-Tile-Recursive order: vertical slices by x center, each sorted by y center.
+	 *
+	 */
+	static std::vector<uint32_t> SortTileRecursive(const std::vector<Node>& boxes, uint32_t node_capacity);
+
+	const Header* header_;
+	const TreeRecord* trees_;
+	const Node* nodes_;
+	const uint32_t* items_; // Tree record of each leaf entry
+	const PointRecord* points_;
+	void* index_data_;
+	size_t index_size_;
+	void* points_data_;
+	size_t points_size_;
+
+};
+
+#endif
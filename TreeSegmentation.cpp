@@ -34,131 +34,595 @@
 #include <array>
 #include <algorithm>
 #include <string>
+#include <thread>
 #include "TreeCollection.h"
 #include "FileIO.h"
 #include "PointCollection.h"
-#include "SegmenterSNC.h"
+#include "Segmenter.h"
 #include "CircularBuffer.h"
 #include "CircularBufferCollection.h"
+#include "SegmentationPipeline.h"
+#include "SegmentationServer.h"
+#include "BatchProcessor.h"
+#include "PerfCounters.h"
+#include "AllocationTracker.h"
+#include "TraceRecorder.h"
+#include "TreeIndex.h"
 
 using namespace std;
 
 
-int main(int argc, char *argv[]) {
+// Print the command line syntax
+void PrintUsage(const char* program_name)
+{
+	cerr << "Usage: " << program_name << " src_datasource_name" << endl;
+	cerr << "       " << program_name << " src_datasource_name|directory|pattern ... [--workers n] [--read-ahead n] [--split-size MB]" << endl;
+	cerr << "       " << program_name << " src_datasource_name [--cache] [--save-state] [--seed-threads n|auto] [--wavefront k] [--stream-output] [--gzip [--gzip-threads n]]" << endl;
+	cerr << "       " << program_name << " src_datasource_name [--segmenter snc|watershed] [--thin voxel_size] [--spatial-order] [--quantize units] [--verify-quantization]" << endl;
+	cerr << "       " << program_name << " src_datasource_name [--radius-piecewise h1,r1,h2,r2,...] [--radius-allometric a,b,r_min,r_max] [--local-maxima-piecewise h1,r1,h2,r2,...] [--local-maxima-allometric a,b,r_min,r_max] [--perf] [--alloc-stats] [--trace file.json [--trace-sampling n]]" << endl;
+	cerr << "       " << program_name << " src_datasource_name.tsp [--bbox x_min,y_min,x_max,y_max] [--polygon x1,y1,x2,y2,...]" << endl;
+	cerr << "       " << program_name << " --convert src_datasource_name ... [--chunk-size n]" << endl;
+	cerr << "       " << program_name << " src_datasource_name [--tree-index] [--octree] [--npy|--npz]" << endl;
+	cerr << "       " << program_name << " --query tree_index_file [--tree id] [--bbox x_min,y_min,x_max,y_max]" << endl;
+	cerr << "       " << program_name << " --update state_file changes_datasource_name" << endl;
+	cerr << "       " << program_name << " --daemon socket_path [--workers n]" << endl;
+	cerr << "       " << program_name << " --submit socket_path request" << endl;
+	cerr << endl;
+}
+
+
+// Print the points of a tree, or the trees intersecting a rectangle, from a tree index
+int RunQuery(const string& index_filepath, int tree_id, const vector<double>& bbox)
+{
+	TreeIndex tree_index;
 	
-	// Validate user input
-	string i_filepath;
+	if (not tree_index.Open(index_filepath)){
+		
+		cerr << "FAILURE: unable to open tree index " << index_filepath << endl;
+		return 1;
+		
+	}
 	
-	if (argc <= 1 or argc > 2){
+	cout << setprecision(2) << fixed;
+	
+	if (tree_id >= 0){
 		
-		cerr << "Usage: " << argv[0] << " src_datasource_name" << endl;
-		cerr << endl;
-		cerr << "FAILURE: wrong syntax or no data source provided" << endl;
-		exit(1);
+		const TreeIndex::TreeRecord* tree = tree_index.FindTree(tree_id);
+		
+		if (tree == NULL){
+			
+			cerr << "FAILURE: no tree " << tree_id << " in " << index_filepath << endl;
+			return 1;
+			
+		}
+		
+		const TreeIndex::PointRecord* points = tree_index.GetPoints(*tree);
+		cout << "X, Y, H, ID, CLASS" << endl;
+		
+		for (uint32_t j(0); j < tree->n_points; j++){
+			
+			cout << points[j].x << ", " << points[j].y << ", " << points[j].z << ", " << points[j].tree_idx << ", " << points[j].classification << "\n";
+			
+		}
 		
 	} else {
 		
-		// Check input file name extension (.csv)
-		i_filepath = argv[1];
-		if (not (i_filepath.rfind(".csv") == (i_filepath.size()-4))){
+		vector<const TreeIndex::TreeRecord*> trees = tree_index.FindTrees(bbox[0], bbox[1], bbox[2], bbox[3]);
+		sort(trees.begin(), trees.end(), [](const TreeIndex::TreeRecord* a, const TreeIndex::TreeRecord* b){ return a->tree_idx < b->tree_idx; });
+		cout << "ID, N_POINTS, X_MIN, Y_MIN, X_MAX, Y_MAX, H_TOP" << endl;
+		
+		for (unsigned int k(0); k < trees.size(); k++){
 			
-			cerr << "FAILURE: unsupported data source format" << endl;
-			exit(1);
+			cout << trees[k]->tree_idx << ", " << trees[k]->n_points << ", " << trees[k]->x_min << ", " << trees[k]->y_min << ", " << trees[k]->x_max << ", " << trees[k]->y_max << ", " << trees[k]->z_max << "\n";
 			
 		}
 	}
 	
+	cout << flush;
 	
-	// Set the display decimal precision
-	cout << setprecision(2) << fixed;
-    
-    
-	// Read the csv file
-	FileIO file_io(i_filepath);
-	PointCollection point_collection = file_io.ReadCsvPoints();
+	return 0;
+}
+
+
+// Parse a comma separated list of coordinates
+vector<double> ParseCoordinates(const string& s)
+{
+	vector<double> coordinates;
+	stringstream ss(s);
+	string value;
 	
+	while (getline(ss, value, ',')){
+		
+		coordinates.push_back(atof(value.c_str()));
+		
+	}
+	
+	return coordinates;
+}
 
-	// Set the 16 bit hsv colormap
-	vector<array<unsigned int, 3>> hsv_colormap;
-	
-	hsv_colormap.push_back({32767,      0,      0});
-	hsv_colormap.push_back({32767,  19660,      0});
-	hsv_colormap.push_back({26214,  32767,      0});
-	hsv_colormap.push_back({ 6553,  32767,      0});
-	hsv_colormap.push_back({    0,  32767,  13107});
-	hsv_colormap.push_back({    0,  32767,  32767});
-	hsv_colormap.push_back({    0,  13107,  32767});
-	hsv_colormap.push_back({ 6553,      0,  32767});
-	hsv_colormap.push_back({26214,      0,  32767});
-	hsv_colormap.push_back({32767,      0,  19660});
-	
-	
-	// Create a subset of PointCollection containing only points with high vegetation classification
-	vector<unsigned int> keep_classes = {5};
-	cout << "Extracting subset...";
-	PointCollection point_collection_subset = point_collection.FilterPointsByClass(keep_classes);
-	cout << "Done!" << endl;
 
+int main(int argc, char *argv[]) {
+	
+	// Validate user input
+	string socket_path, request, state_filepath, changes_filepath;
+	vector<string> sources;
+	bool daemon_mode(false), submit_mode(false), save_state(false), use_cache(false), convert_mode(false), tree_index(false), octree(false);
+	FileIO::ArrayOutput array_output(FileIO::NO_ARRAYS);
+	string query_filepath;
+	int query_tree_id(-1);
+	unsigned int n_workers = max(1u, thread::hardware_concurrency());
+	unsigned int read_ahead = 2 * n_workers;
+	size_t split_size = 64 << 20;
+	unsigned int segmentation_threads(1), wavefront_size(0);
+	unsigned int chunk_size(16384);
+	unsigned int quantization(0);
+	bool verify_quantization(false), collect_perf(false), collect_allocations(false), stream_output(false);
+	Segmenter::Type segmenter_type(Segmenter::SNC);
+	double thinning_voxel_size(0.0);
+	bool spatial_order(false);
+	unsigned int compression_threads(0);
+	string trace_filepath;
+	unsigned int trace_sampling(100);
+	vector<double> bbox, polygon, radius_piecewise, radius_allometric, local_maxima_piecewise, local_maxima_allometric;
+	
+	for (int j(1); j < argc; j++){
+		
+		string arg = argv[j];
+		
+		if ((arg == "--daemon") and (j+1 < argc)){
+			
+			daemon_mode = true;
+			socket_path = argv[++j];
+			
+		} else if ((arg == "--workers") and (j+1 < argc)){
+			
+			n_workers = max(1, atoi(argv[++j]));
+			read_ahead = 2 * n_workers;
+			
+		} else if ((arg == "--read-ahead") and (j+1 < argc)){
+			
+			read_ahead = max(1, atoi(argv[++j]));
+			
+		} else if ((arg == "--split-size") and (j+1 < argc)){
+			
+			split_size = (size_t) max(1, atoi(argv[++j])) << 20;
+			
+		} else if ((arg == "--seed-threads") and (j+1 < argc)){
+			
+			string value = argv[++j];
+			segmentation_threads = (value == "auto") ? 0 : max(0, atoi(value.c_str()));
+			
+		} else if ((arg == "--wavefront") and (j+1 < argc)){
+			
+			wavefront_size = max(1, atoi(argv[++j]));
+			
+		} else if ((arg == "--chunk-size") and (j+1 < argc)){
+			
+			chunk_size = max(1, atoi(argv[++j]));
+			
+		} else if ((arg == "--bbox") and (j+1 < argc)){
+			
+			bbox = ParseCoordinates(argv[++j]);
+			
+		} else if ((arg == "--polygon") and (j+1 < argc)){
+			
+			polygon = ParseCoordinates(argv[++j]);
+			
+		} else if ((arg == "--radius-piecewise") and (j+1 < argc)){
+			
+			radius_piecewise = ParseCoordinates(argv[++j]);
+			
+		} else if ((arg == "--radius-allometric") and (j+1 < argc)){
+			
+			radius_allometric = ParseCoordinates(argv[++j]);
+			
+		} else if ((arg == "--local-maxima-piecewise") and (j+1 < argc)){
+			
+			local_maxima_piecewise = ParseCoordinates(argv[++j]);
+			
+		} else if ((arg == "--local-maxima-allometric") and (j+1 < argc)){
+			
+			local_maxima_allometric = ParseCoordinates(argv[++j]);
+			
+		} else if ((arg == "--quantize") and (j+1 < argc)){
+			
+			quantization = max(0, atoi(argv[++j]));
+			
+		} else if (arg == "--verify-quantization"){
+			
+			verify_quantization = true;
+			
+		} else if ((arg == "--trace") and (j+1 < argc)){
+			
+			trace_filepath = argv[++j];
+			
+		} else if ((arg == "--trace-sampling") and (j+1 < argc)){
+			
+			trace_sampling = max(1, atoi(argv[++j]));
+			
+		} else if (arg == "--gzip"){
+			
+			compression_threads = max(1u, thread::hardware_concurrency());
+			
+		} else if ((arg == "--gzip-threads") and (j+1 < argc)){
+			
+			compression_threads = max(1, atoi(argv[++j]));
+			
+		} else if ((arg == "--segmenter") and (j+1 < argc)){
+			
+			if (not Segmenter::ParseType(argv[++j], segmenter_type)){
+				
+				PrintUsage(argv[0]);
+				cerr << "FAILURE: unknown segmenter " << argv[j] << endl;
+				exit(1);
+				
+			}
+			
+		} else if ((arg == "--thin") and (j+1 < argc)){
+			
+			thinning_voxel_size = max(0.0, atof(argv[++j]));
+			
+		} else if (arg == "--spatial-order"){
+			
+			spatial_order = true;
+			
+		} else if (arg == "--stream-output"){
+			
+			stream_output = true;
+			
+		} else if (arg == "--perf"){
+			
+			collect_perf = true;
+			
+		} else if (arg == "--alloc-stats"){
+			
+			collect_allocations = true;
+			
+		} else if (arg == "--convert"){
+			
+			convert_mode = true;
+			
+		} else if (arg == "--cache"){
+			
+			use_cache = true;
+			
+		} else if (arg == "--save-state"){
+			
+			save_state = true;
+			
+		} else if (arg == "--tree-index"){
+			
+			tree_index = true;
+			
+		} else if (arg == "--octree"){
+			
+			octree = true;
+			
+		} else if (arg == "--npy"){
+			
+			array_output = FileIO::NPY_ARRAYS;
+			
+		} else if (arg == "--npz"){
+			
+			array_output = FileIO::NPZ_ARRAYS;
+			
+		} else if ((arg == "--query") and (j+1 < argc)){
+			
+			query_filepath = argv[++j];
+			
+		} else if ((arg == "--tree") and (j+1 < argc)){
+			
+			query_tree_id = max(0, atoi(argv[++j]));
+			
+		} else if ((arg == "--update") and (j+2 < argc)){
+			
+			state_filepath = argv[++j];
+			changes_filepath = argv[++j];
+			
+		} else if ((arg == "--submit") and (j+2 < argc)){
+			
+			// The remaining arguments form the request line
+			submit_mode = true;
+			socket_path = argv[++j];
+			request = argv[++j];
+			while (j+1 < argc){
+				request += string(" ") + argv[++j];
+			}
+			
+		} else if (arg.compare(0, 2, "--") != 0){
+			
+			sources.push_back(arg);
+			
+		} else {
+			
+			PrintUsage(argv[0]);
+			cerr << "FAILURE: wrong syntax" << endl;
+			exit(1);
+			
+		}
+	}
+	
+	// Circular buffer radius and coordinate scaling factor
+	vector<unsigned int> radius_list = {2, 4, 9, 14};
+	unsigned int scaling_factor = PointCollection().GetScalingFactor();
+	SegmentationPipeline::Parameters parameters = SegmentationPipeline::DefaultParameters();
+	parameters.save_state = save_state;
+	parameters.use_cache = use_cache;
+	parameters.segmentation_threads = segmentation_threads;
+	parameters.wavefront_size = wavefront_size;
+	parameters.quantization = quantization;
+	parameters.verify_quantization = verify_quantization;
+	parameters.stream_output = stream_output;
+	parameters.segmenter = segmenter_type;
+	parameters.thinning_voxel_size = thinning_voxel_size;
+	parameters.spatial_order = spatial_order;
+	parameters.tree_index = tree_index;
+	parameters.octree = octree;
+	parameters.array_output = array_output;
+	parameters.compression_threads = compression_threads;
 	
-	// Sort the PointCollection by height
-	cout << "Sorting points by height...";
-	point_collection_subset.SortByZ();
-	cout << "Done!" << endl;
+	// Radius of the circular buffer of a seed as a function of its height
+	if (not radius_piecewise.empty()){
+		
+		parameters.radius_model.type = CircularBufferCollection::RadiusModel::PIECEWISE_LINEAR;
+		parameters.radius_model.heights.clear();
+		parameters.radius_model.radii.clear();
+		
+		for (unsigned int j(0); j + 1 < radius_piecewise.size(); j += 2){
+			
+			parameters.radius_model.heights.push_back(radius_piecewise[j]);
+			parameters.radius_model.radii.push_back(radius_piecewise[j+1]);
+			
+		}
+		
+	} else if (radius_allometric.size() == 4){
+		
+		parameters.radius_model.type = CircularBufferCollection::RadiusModel::ALLOMETRIC;
+		parameters.radius_model.a = radius_allometric[0];
+		parameters.radius_model.b = radius_allometric[1];
+		parameters.radius_model.min_radius = radius_allometric[2];
+		parameters.radius_model.max_radius = radius_allometric[3];
+		
+	}
 	
+	if ((radius_piecewise.size() % 2 != 0) or (radius_allometric.size() != 0 and radius_allometric.size() != 4) or (not CircularBufferCollection::IsValidRadiusModel(parameters.radius_model))){
+		
+		PrintUsage(argv[0]);
+		cerr << "FAILURE: wrong radius model" << endl;
+		exit(1);
+		
+	}
 	
-	// Recompute the Point indexes
-	point_collection_subset.ComputePointIndexes();
+	// Radius of the local maxima search as a function of the height of a point
+	if (not local_maxima_piecewise.empty()){
+		
+		parameters.variable_local_maxima = true;
+		parameters.local_maxima_model.type = CircularBufferCollection::RadiusModel::PIECEWISE_LINEAR;
+		parameters.local_maxima_model.heights.clear();
+		parameters.local_maxima_model.radii.clear();
+		
+		for (unsigned int j(0); j + 1 < local_maxima_piecewise.size(); j += 2){
+			
+			parameters.local_maxima_model.heights.push_back(local_maxima_piecewise[j]);
+			parameters.local_maxima_model.radii.push_back(local_maxima_piecewise[j+1]);
+			
+		}
+		
+	} else if (local_maxima_allometric.size() == 4){
+		
+		parameters.variable_local_maxima = true;
+		parameters.local_maxima_model.type = CircularBufferCollection::RadiusModel::ALLOMETRIC;
+		parameters.local_maxima_model.a = local_maxima_allometric[0];
+		parameters.local_maxima_model.b = local_maxima_allometric[1];
+		parameters.local_maxima_model.min_radius = local_maxima_allometric[2];
+		parameters.local_maxima_model.max_radius = local_maxima_allometric[3];
+		
+	}
 	
+	if ((local_maxima_piecewise.size() % 2 != 0) or (local_maxima_allometric.size() != 0 and local_maxima_allometric.size() != 4) or (not CircularBufferCollection::IsValidRadiusModel(parameters.local_maxima_model))){
+		
+		PrintUsage(argv[0]);
+		cerr << "FAILURE: wrong local maxima radius model" << endl;
+		exit(1);
+		
+	}
 	
-	// Compute the bounding box
-	cout << "Computing bounding box... ";
-	point_collection_subset.ComputeBoundingBox();
-	cout << "Done!" << endl;
+	// Region of interest of chunked point files
+	if ((bbox.size() != 0 and bbox.size() != 4) or (polygon.size() % 2 != 0) or (polygon.size() != 0 and polygon.size() < 6)){
+		
+		PrintUsage(argv[0]);
+		cerr << "FAILURE: wrong region of interest" << endl;
+		exit(1);
+		
+	}
 	
+	if (bbox.size() == 4){
+		
+		parameters.region_of_interest.has_bbox = true;
+		parameters.region_of_interest.x_min = bbox[0];
+		parameters.region_of_interest.y_min = bbox[1];
+		parameters.region_of_interest.x_max = bbox[2];
+		parameters.region_of_interest.y_max = bbox[3];
+		
+	}
 	
-	// Compute the associated grid
-	cout << "Gridding points...";
-	//point_collection_subset.ComputeGridCoordinates(scaling_factor);
-	point_collection_subset.ComputeGridCoordinates();
-	point_collection_subset.AssignGridCells();
-	cout << "Done!" << endl;
+	for (unsigned int j(0); j + 1 < polygon.size(); j += 2){
+		
+		parameters.region_of_interest.polygon.push_back({polygon[j], polygon[j+1]});
+		
+	}
 	
+	if (submit_mode){
+		
+		return SegmentationServer::Submit(socket_path, request);
+		
+	}
 	
-	// Create a circular buffer collection
-	cout << "Creating circular buffers...";
-	vector<unsigned int> radius_list = {2, 4, 9, 14};
-	CircularBufferCollection circular_buffer_collection(radius_list, point_collection.GetScalingFactor());
-	cout << "Done!" << endl;
+	if (not query_filepath.empty()){
+		
+		if ((query_tree_id < 0) and (bbox.size() != 4)){
+			
+			PrintUsage(argv[0]);
+			cerr << "FAILURE: a query needs a tree identifier or a bounding box" << endl;
+			exit(1);
+			
+		}
+		
+		return RunQuery(query_filepath, query_tree_id, bbox);
+		
+	}
 	
+	if (daemon_mode){
+		
+		SegmentationServer server(socket_path, n_workers, parameters, scaling_factor, radius_list);
+		return server.Run();
+		
+	}
 	
-	// Find all local maxima
-	cout << "Finding local maxima...";
-	CircularBuffer circular_buffer_0 = circular_buffer_collection.GetCircularBuffer(0);
-	point_collection_subset.FindLocalMaxima(circular_buffer_0);
-	cout << "Done!" << endl;
+	// Set the display decimal precision
+	cout << setprecision(2) << fixed;
 	
+	// Open the hardware performance counters before any worker thread is created
+	if (collect_perf){
+		
+		PerfCounters::Enable();
+		
+	}
 	
-	// Segment the point cloud
-	SegmenterSNC segmenter;
-	segmenter.SegmentPointCollection(point_collection_subset, circular_buffer_collection, true);
+	// Count the heap allocations of each stage
+	if (collect_allocations){
+		
+		AllocationTracker::Enable();
+		
+	}
 	
+	// Record a timeline of the run
+	if (not trace_filepath.empty()){
+		
+		TraceRecorder::Enable(trace_sampling);
+		
+	}
+	
+	if (not state_filepath.empty()){
+		
+		// Update a saved segmentation with re-surveyed points
+		SegmentationPipeline pipeline(scaling_factor, radius_list);
+		SegmentationPipeline::Metrics metrics = pipeline.UpdateFile(state_filepath, changes_filepath, parameters);
+		PerfCounters::Report(cout);
+		AllocationTracker::Report(cout);
+		
+		if (TraceRecorder::IsEnabled()){
+			
+			TraceRecorder::Write(trace_filepath);
+			
+		}
+		
+		if (not metrics.success){
+			
+			cerr << "FAILURE: " << metrics.message << endl;
+			exit(1);
+			
+		}
+		
+		return 0;
+		
+	}
+	
+	if (sources.empty()){
+		
+		PrintUsage(argv[0]);
+		cerr << "FAILURE: wrong syntax or no data source provided" << endl;
+		exit(1);
+		
+	}
+	
+	// Several files, a directory or a glob pattern are processed in batch mode
+	vector<string> filepaths = BatchProcessor::ExpandSources(sources);
+	
+	if (convert_mode){
+		
+		// Convert csv files to chunked point files
+		for (unsigned int j(0); j < filepaths.size(); j++){
+			
+			if (not ((filepaths[j].size() >= 4) and (filepaths[j].rfind(".csv") == (filepaths[j].size()-4)))){
+				
+				continue;
+				
+			}
+			
+			FileIO file_io(filepaths[j]);
+			PointCollection point_collection = file_io.ReadCsvPoints();
+			string o_filepath = filepaths[j].substr(0, filepaths[j].size()-4) + ".tsp";
+			
+			cout << "Writing chunked points to " << o_filepath << "...";
+			
+			if (not FileIO::WriteChunkedPoints(point_collection, o_filepath, chunk_size)){
+				
+				exit(1);
+				
+			}
+			
+			cout << "Done!" << endl;
+			
+		}
+		
+		return 0;
+		
+	}
+	
+	if ((filepaths.size() != 1) or (filepaths[0] != sources[0])){
+		
+		if (filepaths.empty()){
+			
+			cerr << "FAILURE: no data source found" << endl;
+			exit(1);
+			
+		}
+		
+		BatchProcessor batch_processor(n_workers, read_ahead, split_size, parameters, scaling_factor, radius_list);
+		int status = batch_processor.Run(filepaths);
+		PerfCounters::Report(cout);
+		AllocationTracker::Report(cout);
+		
+		if (TraceRecorder::IsEnabled()){
+			
+			TraceRecorder::Write(trace_filepath);
+			
+		}
+		
+		return status;
+		
+	}
 	
-	// Set RGB color values for each segmented point
-	point_collection_subset.SetRGBColors(hsv_colormap);
+	string i_filepath = filepaths[0];
 	
+	// Check input file name extension (.csv, .csv.gz or .tsp)
+	if (not (FileIO::IsCsvFile(i_filepath) or ((i_filepath.size() >= 4) and (i_filepath.rfind(".tsp") == (i_filepath.size()-4))))){
+		
+		cerr << "FAILURE: unsupported data source format" << endl;
+		exit(1);
+		
+	}
 	
-	// Extract individual tree attributes (x, y, h)
-	cout << "Computing tree attributes...";
-	TreeCollection tree_collection(point_collection_subset, 20, 3);
-	cout << "Done!" << endl;
 	
+	// Read, segment and write the data source
+	SegmentationPipeline pipeline(scaling_factor, radius_list);
+	SegmentationPipeline::Metrics metrics = pipeline.ProcessFile(i_filepath, parameters);
+	PerfCounters::Report(cout);
+	AllocationTracker::Report(cout);
 	
-	// Write the segmented points to .csv
-	file_io.WritePointsToCSV(point_collection_subset, 2);
-
+	if (TraceRecorder::IsEnabled()){
+		
+		TraceRecorder::Write(trace_filepath);
+		
+	}
 	
-	// Write the tree attribute to .csv
-	file_io.WriteTreesToCSV(tree_collection, 2);
+	if (not metrics.success){
+		
+		cerr << "FAILURE: " << metrics.message << endl;
+		exit(1);
+		
+	}
 	
 
 	return 0;
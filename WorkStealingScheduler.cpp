@@ -0,0 +1,179 @@
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include "WorkStealingScheduler.h"
+
+using namespace std;
+
+
+// Scheduler and worker index of the calling thread (NULL for threads which are not workers)
+static thread_local WorkStealingScheduler* current_scheduler = NULL;
+static thread_local unsigned int current_worker_idx = 0;
+
+
+unsigned int WorkStealingScheduler::GetWorkerCount()
+{
+	return workers_.size();
+}
+
+
+// Add a task to the queue of the calling worker, or round-robin if called from outside
+void WorkStealingScheduler::Submit(Task task)
+{
+	unsigned int queue_idx;
+
+	if (current_scheduler == this){
+
+		queue_idx = current_worker_idx;
+
+	} else {
+
+		queue_idx = next_queue_.fetch_add(1) % queues_.size();
+
+	}
+
+	n_pending_++;
+
+	{
+		lock_guard<mutex> lock(queues_[queue_idx]->mutex);
+		queues_[queue_idx]->tasks.push_back(move(task));
+	}
+
+	idle_condition_.notify_one();
+}
+
+
+// Execute one task from the own queue (back) or stolen from another queue (front)
+bool WorkStealingScheduler::RunOneTask(unsigned int worker_idx)
+{
+	Task task;
+	bool found(false);
+
+	{
+		WorkerQueue& queue = *queues_[worker_idx];
+		lock_guard<mutex> lock(queue.mutex);
+
+		if (not queue.tasks.empty()){
+
+			task = move(queue.tasks.back());
+			queue.tasks.pop_back();
+			found = true;
+
+		}
+	}
+
+	for (unsigned int k(1); (not found) and (k < queues_.size()); k++){
+
+		WorkerQueue& victim = *queues_[(worker_idx + k) % queues_.size()];
+		lock_guard<mutex> lock(victim.mutex);
+
+		if (not victim.tasks.empty()){
+
+			task = move(victim.tasks.front());
+			victim.tasks.pop_front();
+			found = true;
+
+		}
+	}
+
+	if (found){
+
+		task(worker_idx);
+
+		if (--n_pending_ == 0){
+
+			lock_guard<mutex> lock(idle_mutex_);
+			idle_condition_.notify_all(); // Wake up Wait()
+
+		}
+	}
+
+	return found;
+}
+
+
+// Execute tasks until the scheduler is stopped
+void WorkStealingScheduler::WorkerLoop(unsigned int worker_idx)
+{
+	current_scheduler = this;
+	current_worker_idx = worker_idx;
+
+	while (not stop_){
+
+		if (not RunOneTask(worker_idx)){
+
+			// Sleep until a task is submitted (the timeout covers notifications missed while stealing)
+			unique_lock<mutex> lock(idle_mutex_);
+			idle_condition_.wait_for(lock, chrono::milliseconds(2));
+
+		}
+	}
+}
+
+
+// Execute pending tasks until the sub-tasks counted by counter are done
+void WorkStealingScheduler::HelpUntilDone(atomic<unsigned int>& counter, unsigned int worker_idx)
+{
+	while (counter > 0){
+
+		if (not RunOneTask(worker_idx)){
+
+			this_thread::yield(); // The remaining sub-tasks are running on other workers
+
+		}
+	}
+}
+
+
+// Wait until all the submitted tasks are done
+void WorkStealingScheduler::Wait()
+{
+	unique_lock<mutex> lock(idle_mutex_);
+	idle_condition_.wait(lock, [this]{ return n_pending_ == 0; });
+}
+
+
+// Constructor
+WorkStealingScheduler::WorkStealingScheduler(unsigned int n_workers) : n_pending_(0), next_queue_(0), stop_(false)
+{
+	if (n_workers == 0){
+
+		n_workers = 1;
+
+	}
+
+	for (unsigned int j(0); j < n_workers; j++){
+
+		queues_.push_back(unique_ptr<WorkerQueue>(new WorkerQueue()));
+
+	}
+
+	for (unsigned int j(0); j < n_workers; j++){
+
+		workers_.push_back(thread(&WorkStealingScheduler::WorkerLoop, this, j));
+
+	}
+
+}
+
+
+// Destructor
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+	Wait();
+	stop_ = true;
+	idle_condition_.notify_all();
+
+	for (unsigned int j(0); j < workers_.size(); j++){
+
+		workers_[j].join();
+
+	}
+
+}
@@ -0,0 +1,121 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * This class distributes tasks over a fixed set of worker threads. Each worker owns a double-ended queue:
+ * it pushes and pops its own tasks at the back and, when it runs out of work, steals from the front of the
+ * queues of the other workers. Tasks submitted from a worker (e.g. the sub-tasks of a large job) go to the
+ * queue of that worker, tasks submitted from outside are spread round-robin.
+ *
+ */
+
+#ifndef WORKSTEALINGSCHEDULER_H
+#define WORKSTEALINGSCHEDULER_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+class WorkStealingScheduler {
+
+public:
+
+	/**
+	 * A task receives the index of the worker executing it.
+	 *
+	 */
+	typedef std::function<void(unsigned int)> Task;
+
+	/**
+	 * Adds a task to the scheduler.
+	 *
+	 * @param  task The task to execute.
+	 */
+	void Submit(Task task);
+
+	/**
+	 * Blocks until every submitted task has been executed. Must not be called from a worker.
+	 *
+	 */
+	void Wait();
+
+	/**
+	 * Executes pending tasks on the calling worker until the specified counter drops to zero.
+	 * Used by a task waiting for the sub-tasks it submitted, without blocking a worker.
+	 *
+	 * @param  counter A reference to the number of unfinished sub-tasks.
+	 * @param  worker_idx The index of the calling worker.
+	 */
+	void HelpUntilDone(std::atomic<unsigned int>& counter, unsigned int worker_idx);
+
+	unsigned int GetWorkerCount();
+
+	/**
+	 * Creates a scheduler and starts its workers.
+	 *
+	 * @param  n_workers The number of worker threads.
+	 */
+	WorkStealingScheduler(unsigned int n_workers); // Constructor
+	~WorkStealingScheduler(); // Destructor
+
+private:
+
+	/**
+	 * Task queue owned by a worker.
+	 *
+	 */
+	struct WorkerQueue {
+
+		std::deque<Task> tasks;
+		std::mutex mutex;
+
+	};
+
+	/**
+	 * Pops a task from the queue of the worker, or steals one from another worker, and executes it.
+	 *
+	 * @param  worker_idx The index of the calling worker.
+	 * @return Returns true if a task was executed.
+	 */
+	bool RunOneTask(unsigned int worker_idx);
+
+	void WorkerLoop(unsigned int worker_idx);
+
+	std::vector<std::unique_ptr<WorkerQueue>> queues_;
+	std::vector<std::thread> workers_;
+
+	/**
+	 * Number of submitted tasks which have not finished yet.
+	 *
+	 */
+	std::atomic<unsigned int> n_pending_;
+	std::atomic<unsigned int> next_queue_;
+	std::atomic<bool> stop_;
+
+	std::mutex idle_mutex_;
+	std::condition_variable idle_condition_;
+
+};
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * @file
+ * @author  Matthew Parkan <matthew.parkan@gmail.com>
+ * @version 1.0
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details at
+ * http://www.gnu.org/copyleft/gpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Compares the neighbourhood searches of the preparation and of the segmentation (FindLocalMaxima and one
+ * ExtractPointsInBuffer per seed candidate) with the points stored in height order and in the spatial order of
+ * their grid cells. The elapsed time of each stage is printed, and the hardware performance counters (including
+ * the last level cache misses) when they are available.
+ *
+ * Build from the repository root:
+ *
+ * g++ -std=c++17 -O2 -pthread -I. benchmarks/SpatialOrderBenchmark.cpp PointCollection.cpp CircularBuffer.cpp
+ *     CircularBufferCollection.cpp SparseGrid.cpp FileIO.cpp BlockGzip.cpp IngestStatistics.cpp PerfCounters.cpp
+ *     TreeIndex.cpp TreeCollection.cpp TraceRecorder.cpp AllocationTracker.cpp AsyncReader.cpp NpyWriter.cpp
+ *     SparseTable2D.cpp -o SpatialOrderBenchmark -lz
+ *
+ * Usage: SpatialOrderBenchmark "src_datasource_name.csv" [seed_radius] [seed_period]
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include "PointCollection.h"
+#include "CircularBuffer.h"
+#include "CircularBufferCollection.h"
+#include "FileIO.h"
+#include "PerfCounters.h"
+
+using namespace std;
+
+
+// Elapsed time in seconds
+static double ElapsedSeconds(chrono::steady_clock::time_point t0)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+
+class SpatialOrderBenchmark {
+
+public:
+
+	/**
+	 * Reads, filters, sorts by height and grids the points of a csv file.
+	 *
+	 * @return Returns false if no point is left after filtering.
+	 */
+	static bool Prepare(const std::string& i_filepath, PointCollection& point_collection_subset);
+
+	/**
+	 * Runs the neighbourhood searches on a copy of the prepared points, in the specified storage order.
+	 *
+	 */
+	static void Run(PointCollection point_collection, CircularBufferCollection& circular_buffer_collection, unsigned int seed_period, bool spatial_order);
+
+};
+
+
+// Prepare the points of a csv file
+bool SpatialOrderBenchmark::Prepare(const string& i_filepath, PointCollection& point_collection_subset)
+{
+	vector<unsigned int> keep_classes = {5}; // High vegetation
+	FileIO file_io(i_filepath);
+	PointCollection point_collection = file_io.ReadCsvPoints();
+	point_collection_subset = point_collection.FilterPointsByClass(keep_classes);
+
+	if (point_collection_subset.points_.empty()){
+
+		return false;
+
+	}
+
+	point_collection_subset.SortByZ();
+	point_collection_subset.ComputePointIndexes();
+	point_collection_subset.ComputeBoundingBox();
+	point_collection_subset.ComputeGridCoordinates();
+	point_collection_subset.AssignGridCells();
+	cout << "Points: " << point_collection_subset.points_.size() << " (" << point_collection_subset.n_rows_ << " rows x " << point_collection_subset.n_cols_ << " columns)" << endl;
+
+	return true;
+}
+
+
+// Run the neighbourhood searches in the specified storage order
+void SpatialOrderBenchmark::Run(PointCollection point_collection, CircularBufferCollection& circular_buffer_collection, unsigned int seed_period, bool spatial_order)
+{
+	string order = spatial_order ? "spatial" : "height";
+
+	if (spatial_order){
+
+		point_collection.SortBySpatialOrder();
+
+	}
+
+	// Local maxima search (visits all the points in height order)
+	PerfCounters::Counts perf_start;
+	PerfCounters::StartStage(perf_start);
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	point_collection.FindLocalMaxima(circular_buffer_collection.GetCircularBuffer(0));
+	PerfCounters::StopStage("maxima/" + order, perf_start);
+	cout << "Local maxima, " << order << " order: " << ElapsedSeconds(t0) << " s" << endl;
+
+	// Seed buffer extraction around one point in seed_period, in height order, as in the segmentation
+	PointCollection sample;
+	size_t n_extracted(0);
+	PerfCounters::StartStage(perf_start);
+	t0 = chrono::steady_clock::now();
+
+	for (unsigned int rank(0); rank < point_collection.points_.size(); rank += seed_period){
+
+		const PointCollection::Point& seed = point_collection.points_[point_collection.GetHeightOrderIndex(rank)];
+		int col_0 = seed.col;
+		int row_0 = seed.row;
+		point_collection.ExtractPointsInBuffer(circular_buffer_collection.GetSeedBuffer(seed.z), sample, col_0, row_0);
+		n_extracted += sample.points_.size();
+		sample.points_.clear();
+
+	}
+
+	PerfCounters::StopStage("buffers/" + order, perf_start);
+	cout << "Seed buffers, " << order << " order: " << ElapsedSeconds(t0) << " s (" << n_extracted << " points extracted)" << endl;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2){
+
+		cerr << "Usage: " << argv[0] << " src_datasource_name.csv [seed_radius] [seed_period]" << endl;
+		return 1;
+
+	}
+
+	vector<unsigned int> radius_list = {(argc > 2) ? (unsigned int) atoi(argv[2]) : 2u, 4u, 9u, 14u};
+	unsigned int seed_period = (argc > 3) ? max(1, atoi(argv[3])) : 16;
+	PointCollection point_collection_subset;
+
+	if (not SpatialOrderBenchmark::Prepare(argv[1], point_collection_subset)){
+
+		cerr << "FAILURE: no point with the requested classification" << endl;
+		return 1;
+
+	}
+
+	CircularBufferCollection circular_buffer_collection(radius_list, 1);
+	PerfCounters::Enable();
+
+	SpatialOrderBenchmark::Run(point_collection_subset, circular_buffer_collection, seed_period, false);
+	SpatialOrderBenchmark::Run(point_collection_subset, circular_buffer_collection, seed_period, true);
+
+	PerfCounters::Report(cout);
+
+	return 0;
+}